@@ -0,0 +1,402 @@
+namespace Pak
+{
+namespace Priv
+{
+
+static const unsigned KHashBits = 16;
+static const unsigned KMinMatch = 4;
+static const unsigned KLastLiterals = 5; // the block ends with at least this many literals
+static const unsigned KMatchLimit = 12;  // and no match starts in its last KMatchLimit bytes
+
+static inline uint32_t
+Read32(const uint8_t* Data)
+{
+    uint32_t Value;
+    memcpy(&Value, Data, 4);
+    return Value;
+}
+
+// Writes a literal or match length continuation (after the 15 in the token).
+static uint8_t*
+WriteLength(uint8_t* Out, const uint8_t* OutEnd, size_t Length)
+{
+    for (; Length >= 255; Length -= 255)
+    {
+        if (Out == OutEnd)
+            return nullptr;
+        *Out++ = 255;
+    }
+    if (Out == OutEnd)
+        return nullptr;
+    *Out++ = (uint8_t)Length;
+    return Out;
+}
+
+static uint8_t*
+WriteSequence(uint8_t* Out, const uint8_t* OutEnd, const uint8_t* Literals, size_t LiteralCount, unsigned Offset,
+              size_t MatchLength)
+{
+    if (Out == OutEnd)
+        return nullptr;
+    uint8_t* Token = Out++;
+    *Token = (uint8_t)(std::min(LiteralCount, (size_t)15) << 4);
+    if (LiteralCount >= 15 && !(Out = WriteLength(Out, OutEnd, LiteralCount - 15)))
+        return nullptr;
+    if ((size_t)(OutEnd - Out) < LiteralCount)
+        return nullptr;
+    memcpy(Out, Literals, LiteralCount);
+    Out += LiteralCount;
+
+    if (MatchLength == 0) // the last sequence has literals only
+        return Out;
+
+    if (OutEnd - Out < 2)
+        return nullptr;
+    *Out++ = (uint8_t)Offset;
+    *Out++ = (uint8_t)(Offset >> 8);
+    MatchLength -= KMinMatch;
+    *Token |= (uint8_t)std::min(MatchLength, (size_t)15);
+    if (MatchLength >= 15 && !(Out = WriteLength(Out, OutEnd, MatchLength - 15)))
+        return nullptr;
+    return Out;
+}
+
+// A file being packed by Build().
+struct TSource
+{
+    const char* Name;
+    uint64_t Hash;
+    Lib::TMappedFile File;
+    std::vector<uint8_t> Compressed; // empty if stored as is
+};
+
+static bool
+IsSourceBefore(const TSource& A, const TSource& B)
+{
+    return A.Hash < B.Hash;
+}
+
+static bool
+IsHashBelow(const TEntry& Entry, uint64_t Hash)
+{
+    return Entry.Hash < Hash;
+}
+
+// Lib::MapFile() can't map empty files.
+static bool
+IsEmptyFile(const char* FileName)
+{
+    FILE* File = fopen(FileName, "rb");
+    if (!File)
+        return false;
+    const bool Empty = fgetc(File) == EOF;
+    fclose(File);
+    return Empty;
+}
+
+} // namespace Priv
+
+// LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), greedy matching on a
+// hash of the next four bytes. Returns the compressed size, or 0 if it doesn't fit in Capacity.
+static size_t
+CompressLz4(const void* Source, size_t Size, void* Destination, size_t Capacity)
+{
+    const uint8_t* const Start = (const uint8_t*)Source;
+    const uint8_t* const End = Start + Size;
+    uint8_t* Out = (uint8_t*)Destination;
+    const uint8_t* const OutEnd = Out + Capacity;
+    const uint8_t* Anchor = Start;
+
+    if (Size > Priv::KMatchLimit)
+    {
+        std::vector<uint32_t> Table((size_t)1 << Priv::KHashBits, 0); // position + 1
+        const uint8_t* const MatchStartEnd = End - Priv::KMatchLimit;
+        const uint8_t* const MatchEnd = End - Priv::KLastLiterals;
+
+        for (const uint8_t* In = Start; In < MatchStartEnd;)
+        {
+            const uint32_t Sequence = Priv::Read32(In);
+            const uint32_t Hash = (Sequence * 2654435761u) >> (32 - Priv::KHashBits);
+            const uint32_t Candidate = Table[Hash];
+            Table[Hash] = (uint32_t)(In - Start) + 1;
+
+            const uint8_t* Match = Start + Candidate - 1;
+            if (Candidate == 0 || In - Match > 65535 || Priv::Read32(Match) != Sequence)
+            {
+                In++;
+                continue;
+            }
+
+            size_t Length = Priv::KMinMatch;
+            while (In + Length < MatchEnd && Match[Length] == In[Length])
+                Length++;
+
+            Out = Priv::WriteSequence(Out, OutEnd, Anchor, In - Anchor, (unsigned)(In - Match), Length);
+            if (!Out)
+                return 0;
+            In += Length;
+            Anchor = In;
+        }
+    }
+
+    Out = Priv::WriteSequence(Out, OutEnd, Anchor, End - Anchor, 0, 0);
+    return Out ? Out - (uint8_t*)Destination : 0;
+}
+
+// Decompresses exactly Size bytes; false if the block is malformed or has a different size.
+static bool
+DecompressLz4(const void* Source, size_t SourceSize, void* Destination, size_t Size)
+{
+    const uint8_t* In = (const uint8_t*)Source;
+    const uint8_t* const InEnd = In + SourceSize;
+    uint8_t* const Start = (uint8_t*)Destination;
+    uint8_t* Out = Start;
+    uint8_t* const OutEnd = Out + Size;
+
+    while (In < InEnd)
+    {
+        const unsigned Token = *In++;
+
+        size_t LiteralCount = Token >> 4;
+        if (LiteralCount == 15)
+        {
+            unsigned Byte;
+            do
+            {
+                if (In == InEnd)
+                    return false;
+                Byte = *In++;
+                LiteralCount += Byte;
+            } while (Byte == 255);
+        }
+        if (LiteralCount > (size_t)(InEnd - In) || LiteralCount > (size_t)(OutEnd - Out))
+            return false;
+        // Short literal runs are copied as 16 bytes where both buffers have room (the extra bytes get
+        // overwritten), which avoids a variable-size memcpy per sequence.
+        if (LiteralCount <= 16 && InEnd - In >= 16 && OutEnd - Out >= 16)
+            memcpy(Out, In, 16);
+        else
+            memcpy(Out, In, LiteralCount);
+        In += LiteralCount;
+        Out += LiteralCount;
+
+        if (In == InEnd)
+            break;
+
+        if (InEnd - In < 2)
+            return false;
+        const size_t Offset = In[0] | (In[1] << 8);
+        In += 2;
+        if (Offset == 0 || Offset > (size_t)(Out - Start))
+            return false;
+
+        size_t MatchLength = Token & 15;
+        if (MatchLength == 15)
+        {
+            unsigned Byte;
+            do
+            {
+                if (In == InEnd)
+                    return false;
+                Byte = *In++;
+                MatchLength += Byte;
+            } while (Byte == 255);
+        }
+        MatchLength += Priv::KMinMatch;
+        if (MatchLength > (size_t)(OutEnd - Out))
+            return false;
+
+        // Matches may overlap what they produce (runs), so they are copied front to back; in steps of 8
+        // bytes when the offset allows it and the output has room for the overrun.
+        const uint8_t* Match = Out - Offset;
+        if (Offset >= 8 && (size_t)(OutEnd - Out) >= MatchLength + 8)
+        {
+            uint8_t* const MatchEnd = Out + MatchLength;
+            for (; Out < MatchEnd; Out += 8, Match += 8)
+                memcpy(Out, Match, 8);
+            Out = MatchEnd;
+        }
+        else if (Offset >= MatchLength)
+        {
+            memcpy(Out, Match, MatchLength);
+            Out += MatchLength;
+        }
+        else
+        {
+            for (size_t Index = 0; Index < MatchLength; ++Index)
+                *Out++ = *Match++;
+        }
+    }
+    return Out == OutEnd;
+}
+
+// FNV-1a.
+static uint64_t
+HashName(const char* Name)
+{
+    uint64_t Hash = 0xcbf29ce484222325ull;
+    for (; *Name; ++Name)
+        Hash = (Hash ^ (uint8_t)*Name) * 0x100000001b3ull;
+    return Hash;
+}
+
+static bool
+Open(const char* FileName, TArchive& OutArchive)
+{
+    OutArchive = {};
+    Lib::TMappedFile File = Lib::MapFile(FileName);
+    if (!File.Data)
+        return false;
+
+    THeader Header;
+    bool Valid = File.Size >= sizeof(Header);
+    if (Valid)
+    {
+        memcpy(&Header, File.Data, sizeof(Header));
+        const uint64_t TableEnd = sizeof(Header) + (uint64_t)Header.EntryCount * sizeof(TEntry) + Header.NamesSize;
+        Valid = Header.Magic == KMagic && Header.Version == KVersion && TableEnd <= File.Size && Header.NamesSize > 0 &&
+                File.Data[TableEnd - 1] == '\0';
+    }
+
+    const TEntry* Entries = (const TEntry*)(File.Data + sizeof(Header));
+    for (unsigned Index = 0; Valid && Index < Header.EntryCount; ++Index)
+    {
+        const TEntry& Entry = Entries[Index];
+        Valid = Entry.Offset % KBlobAlignment == 0 && Entry.Offset <= File.Size && Entry.Size <= File.Size - Entry.Offset &&
+                Entry.NameOffset < Header.NamesSize && (Entry.Flags & KEntryLz4 || Entry.Size == Entry.OriginalSize) &&
+                (Index == 0 || Entries[Index - 1].Hash <= Entry.Hash);
+    }
+
+    if (!Valid)
+    {
+        Lib::UnmapFile(File);
+        return false;
+    }
+
+    OutArchive.File = File;
+    OutArchive.Entries = Entries;
+    OutArchive.Names = (const char*)(Entries + Header.EntryCount);
+    OutArchive.EntryCount = Header.EntryCount;
+    return true;
+}
+
+static void
+Close(TArchive& Archive)
+{
+    Lib::UnmapFile(Archive.File);
+    Archive = {};
+}
+
+// Binary search on the hash, then the name settles collisions.
+static const TEntry*
+Find(const TArchive& Archive, const char* Name)
+{
+    const uint64_t Hash = HashName(Name);
+    const TEntry* Entry = std::lower_bound(Archive.Entries, Archive.Entries + Archive.EntryCount, Hash,
+                                           Priv::IsHashBelow);
+    for (; Entry != Archive.Entries + Archive.EntryCount && Entry->Hash == Hash; ++Entry)
+    {
+        if (strcmp(Archive.Names + Entry->NameOffset, Name) == 0)
+            return Entry;
+    }
+    return nullptr;
+}
+
+static const uint8_t*
+GetBlob(const TArchive& Archive, const TEntry& Entry)
+{
+    return Archive.File.Data + Entry.Offset;
+}
+
+static bool
+Decompress(const TArchive& Archive, const TEntry& Entry, void* Out)
+{
+    if (!(Entry.Flags & KEntryLz4))
+    {
+        memcpy(Out, GetBlob(Archive, Entry), Entry.Size);
+        return true;
+    }
+    return DecompressLz4(GetBlob(Archive, Entry), Entry.Size, Out, Entry.OriginalSize);
+}
+
+static bool
+Build(const char* FileName, const char* const* Names, unsigned Count, bool Compress)
+{
+    std::vector<Priv::TSource> Sources(Count);
+    std::vector<TEntry> Entries(Count);
+    std::vector<char> NameTable;
+
+    bool Succeeded = true;
+    for (unsigned Index = 0; Index < Count; ++Index)
+    {
+        Priv::TSource& Source = Sources[Index];
+        Source.Name = Names[Index];
+        Source.Hash = HashName(Names[Index]);
+        Source.File = Lib::MapFile(Names[Index]);
+        Succeeded = Succeeded && (Source.File.Data || Priv::IsEmptyFile(Names[Index]));
+
+        if (Compress && Source.File.Data)
+        {
+            Source.Compressed.resize(Source.File.Size);
+            const size_t Size = CompressLz4(Source.File.Data, Source.File.Size, Source.Compressed.data(),
+                                            Source.File.Size - Source.File.Size / 8);
+            Source.Compressed.resize(Size);
+        }
+    }
+
+    std::sort(Sources.begin(), Sources.end(), Priv::IsSourceBefore);
+
+    for (unsigned Index = 0; Index < Count; ++Index)
+    {
+        const Priv::TSource& Source = Sources[Index];
+        TEntry& Entry = Entries[Index];
+        Entry.Hash = Source.Hash;
+        Entry.NameOffset = (uint32_t)NameTable.size();
+        Entry.OriginalSize = Source.File.Size;
+        Entry.Size = Source.Compressed.empty() ? Source.File.Size : Source.Compressed.size();
+        Entry.Flags = Source.Compressed.empty() ? 0u : (uint32_t)KEntryLz4;
+        NameTable.insert(NameTable.end(), Source.Name, Source.Name + strlen(Source.Name) + 1);
+    }
+    if (NameTable.empty())
+        NameTable.push_back('\0');
+
+    const THeader Header = { KMagic, KVersion, Count, (uint32_t)NameTable.size() };
+    uint64_t Offset = sizeof(Header) + Count * sizeof(TEntry) + NameTable.size();
+    for (TEntry& Entry : Entries)
+    {
+        Entry.Offset = (Offset + KBlobAlignment - 1) & ~(uint64_t)(KBlobAlignment - 1);
+        Offset = Entry.Offset + Entry.Size;
+    }
+
+    FILE* File = Succeeded ? fopen(FileName, "wb") : nullptr;
+    if (File)
+    {
+        static const uint8_t Padding[KBlobAlignment] = {};
+        fwrite(&Header, sizeof(Header), 1, File);
+        fwrite(Entries.data(), sizeof(TEntry), Entries.size(), File);
+        fwrite(NameTable.data(), 1, NameTable.size(), File);
+
+        Offset = sizeof(Header) + Count * sizeof(TEntry) + NameTable.size();
+        for (unsigned Index = 0; Index < Count; ++Index)
+        {
+            const Priv::TSource& Source = Sources[Index];
+            fwrite(Padding, 1, (size_t)(Entries[Index].Offset - Offset), File);
+            fwrite(Source.Compressed.empty() ? Source.File.Data : Source.Compressed.data(), 1,
+                   (size_t)Entries[Index].Size, File);
+            Offset = Entries[Index].Offset + Entries[Index].Size;
+        }
+        Succeeded = ferror(File) == 0;
+        Succeeded = fclose(File) == 0 && Succeeded;
+    }
+    else
+    {
+        Succeeded = false;
+    }
+
+    for (Priv::TSource& Source : Sources)
+        Lib::UnmapFile(Source.File);
+    return Succeeded;
+}
+
+} // namespace Pak
+// vim: set ts=4 sw=4 expandtab:
@@ -0,0 +1,2281 @@
+#include "Demo.cpp"
+
+namespace Bench
+{
+
+struct TOptions
+{
+    unsigned FrameCount;
+    unsigned Iterations;
+    Dx::TFrameSettings FrameSettings;
+};
+
+struct TBenchmark
+{
+    const char* Name;
+    void (*Run)(const TOptions& Options);
+};
+
+static bool GFailed;
+
+// Prints a failed expectation; main() then returns a nonzero exit code.
+static void
+Check(bool Condition, const char* Description)
+{
+    if (!Condition)
+    {
+        printf("    FAILED: %s\n", Description);
+        GFailed = true;
+    }
+}
+
+// Prints min/avg/p50/p99 of a set of samples given in seconds.
+static void
+Report(const char* Name, std::vector<double>& Samples)
+{
+    if (Samples.empty())
+        return;
+
+    std::sort(Samples.begin(), Samples.end());
+
+    double Sum = 0.0;
+    for (double Sample : Samples)
+        Sum += Sample;
+
+    const size_t Count = Samples.size();
+    printf("%-28s %8u  min %9.4f  avg %9.4f  p50 %9.4f  p99 %9.4f  ms\n", Name, (unsigned)Count,
+           Samples[0] * 1000.0, Sum / Count * 1000.0, Samples[Count / 2] * 1000.0,
+           Samples[(Count * 99) / 100] * 1000.0);
+}
+
+// 0, 1, 3, 7, ... workers up to one per hardware thread (and at least 1, to show the overhead).
+static std::vector<unsigned>
+GetWorkerCounts()
+{
+    std::vector<unsigned> WorkerCounts = { 0, 1 };
+    for (unsigned WorkerCount = 3; WorkerCount < Jobs::GetDefaultWorkerCount(); WorkerCount = WorkerCount * 2 + 1)
+        WorkerCounts.push_back(WorkerCount);
+    if (Jobs::GetDefaultWorkerCount() > 1)
+        WorkerCounts.push_back(Jobs::GetDefaultWorkerCount());
+    return WorkerCounts;
+}
+
+// Sweeps the mouse over the demo window and clicks every second, so ImGui has some work to do.
+static std::vector<Plat::TScriptEvent>
+MakeMouseSweepScript(unsigned FrameCount)
+{
+    std::vector<Plat::TScriptEvent> Events;
+    for (unsigned Frame = 0; Frame < FrameCount; ++Frame)
+    {
+        const float Angle = Frame * 0.05f;
+        Events.push_back({ Frame, Plat::KScriptMouseMove, 0, 800.0f + 300.0f * cosf(Angle), 300.0f + 250.0f * sinf(Angle) });
+        if (Frame % 60 == 30)
+            Events.push_back({ Frame, Plat::KScriptMouseDown, 0 });
+        else if (Frame % 60 == 32)
+            Events.push_back({ Frame, Plat::KScriptMouseUp, 0 });
+    }
+    return Events;
+}
+
+static void
+FrameLoop(const TOptions& Options)
+{
+    const char* WindowName = "Demo1";
+    std::vector<Plat::TScriptEvent> Events = MakeMouseSweepScript(Options.FrameCount);
+
+    Plat::THeadlessScript Script = {};
+    Script.FrameCount = Options.FrameCount;
+    Script.TimeStep = 1.0 / 60.0;
+    Script.Events = Events.data();
+    Script.EventCount = (unsigned)Events.size();
+    Plat::SetHeadlessScript(Script);
+
+    const double StartupTime = Lib::GetTime();
+    const Plat::TWindow Window = InitializeFramework(WindowName, 1920, 1080, Options.FrameSettings);
+    std::vector<double> Startup(1, Lib::GetTime() - StartupTime);
+
+    std::vector<double> Frames;
+    Frames.reserve(Options.FrameCount);
+    uint64_t SandByteCount = 0;
+    while (ProcessFrameEvents())
+    {
+        const double FrameTime = Lib::GetTime();
+        RunFrame(Window, WindowName);
+        Frames.push_back(Lib::GetTime() - FrameTime);
+        SandByteCount += Sand::GetUploadStats().ByteCount;
+    }
+
+    ShutdownFramework();
+
+    Report("frame.startup", Startup);
+    Report("frame.cpu", Frames);
+    printf("    sand canvas: %.1f KB uploaded per frame, %.1f KB for a full copy (%.1f KB as RGBA8)\n",
+           SandByteCount / 1024.0 / std::max(Frames.size(), (size_t)1), 1920.0 * 1080.0 / 1024.0,
+           1920.0 * 1080.0 * 4.0 / 1024.0);
+}
+
+// Debug-UI style workload: a grid of windows full of widgets, child regions and columns, which
+// produces many draw lists and clip rect changes per frame.
+static void
+BuildHeavyUi(unsigned WindowCount)
+{
+    const unsigned Columns = 6;
+    for (unsigned Index = 0; Index < WindowCount; ++Index)
+    {
+        char Name[32];
+        snprintf(Name, sizeof(Name), "Window %u", Index);
+
+        ImGui::SetNextWindowPos(ImVec2(10.0f + (Index % Columns) * 315.0f, 10.0f + (Index / Columns) * 265.0f));
+        ImGui::SetNextWindowSize(ImVec2(305.0f, 255.0f));
+        ImGui::Begin(Name);
+        for (unsigned Row = 0; Row < 4; ++Row)
+        {
+            ImGui::Text("Row %u: value %.3f", Row, Row * 0.25f);
+            ImGui::SameLine();
+            ImGui::SmallButton("Edit");
+        }
+        ImGui::Columns(3, "Columns");
+        for (unsigned Cell = 0; Cell < 9; ++Cell)
+        {
+            ImGui::Text("Cell %u", Cell);
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+        ImGui::BeginChild("Child", ImVec2(0.0f, 80.0f), true);
+        for (unsigned Row = 0; Row < 8; ++Row)
+            ImGui::BulletText("Child item %u", Row);
+        ImGui::EndChild();
+        ImGui::End();
+    }
+}
+
+// Same sequence as RunFrame(), with a caller-provided UI instead of UpdateAndRender().
+static void
+RunUiFrame(Plat::TWindow Window, unsigned WindowCount, double& OutGuiRenderTime)
+{
+    double Time;
+    float DeltaTime;
+    Lib::UpdateFrameStats(Window, "demo_bench", Time, DeltaTime);
+    Gui::Update(DeltaTime);
+
+    BeginFrame();
+    ImGui::NewFrame();
+    BuildHeavyUi(WindowCount);
+    ImGui::Render();
+
+    const double GuiRenderTime = Lib::GetTime();
+    Gui::Render();
+    OutGuiRenderTime = Lib::GetTime() - GuiRenderTime;
+
+    EndFrame();
+    Dx::PresentFrame();
+}
+
+static void
+Submission(const TOptions& Options)
+{
+    Plat::THeadlessScript Script = {};
+    Script.FrameCount = Options.FrameCount;
+    Plat::SetHeadlessScript(Script);
+
+    const Plat::TWindow Window = InitializeFramework("demo_bench", 1920, 1080, Options.FrameSettings);
+
+    std::vector<double> GuiRender;
+    std::vector<double> Replay;
+    uint64_t Counts[Cmd::KCmdCount] = {};
+    uint64_t FilteredCounts[Cmd::KCmdCount] = {};
+    uint64_t StreamBytes = 0;
+    unsigned FrameCount = 0;
+    Cmd::TCommandList Target = {};
+
+    while (ProcessFrameEvents())
+    {
+        double GuiRenderTime;
+        RunUiFrame(Window, 24, GuiRenderTime);
+        GuiRender.push_back(GuiRenderTime);
+
+        // Dx::GCmdList still holds the frame that was just submitted.
+        for (unsigned Index = 0; Index < Cmd::KCmdCount; ++Index)
+        {
+            Counts[Index] += Dx::GCmdList.Counts[Index];
+            FilteredCounts[Index] += Dx::GCmdList.FilteredCounts[Index];
+        }
+        StreamBytes += Dx::GCmdList.Stream.size();
+        FrameCount++;
+
+        Cmd::Reset(Target);
+        const double ReplayTime = Lib::GetTime();
+        Cmd::Replay(Dx::GCmdList, Target);
+        Replay.push_back(Lib::GetTime() - ReplayTime);
+    }
+
+    ShutdownFramework();
+
+    Report("submission.gui_render", GuiRender);
+    Report("submission.replay", Replay);
+    if (FrameCount == 0)
+        return;
+
+    uint64_t TotalCalls = 0;
+    uint64_t TotalFiltered = 0;
+    printf("    %-36s %10s %10s  (per frame)\n", "command", "issued", "filtered");
+    for (unsigned Index = 0; Index < Cmd::KCmdCount; ++Index)
+    {
+        TotalCalls += Counts[Index];
+        TotalFiltered += FilteredCounts[Index];
+        if (Counts[Index] || FilteredCounts[Index])
+            printf("    %-36s %10.1f %10.1f\n", Cmd::GetCommandName((Cmd::ECommand)Index),
+                   (double)Counts[Index] / FrameCount, (double)FilteredCounts[Index] / FrameCount);
+    }
+    printf("    %-36s %10.1f %10.1f\n", "total", (double)TotalCalls / FrameCount, (double)TotalFiltered / FrameCount);
+    printf("    %-36s %10.1f\n", "stream bytes", (double)StreamBytes / FrameCount);
+}
+
+// Runs the Gui::MergeDrawCommands pass on captured draw data of the heavy UI and compares it with
+// the per-list index copy it replaces (one draw call per ImDrawCmd).
+static void
+DrawMerging(const TOptions& Options)
+{
+    Plat::THeadlessScript Script = {};
+    Script.FrameCount = 3;
+    Plat::SetHeadlessScript(Script);
+
+    const Plat::TWindow Window = InitializeFramework("demo_bench", 1920, 1080, Options.FrameSettings);
+    while (ProcessFrameEvents())
+    {
+        double GuiRenderTime;
+        RunUiFrame(Window, 24, GuiRenderTime);
+    }
+
+    const ImDrawData* DrawData = ImGui::GetDrawData();
+    std::vector<ImDrawList*> Lists;
+    for (int N = 0; N < DrawData->CmdListsCount; ++N)
+        Lists.push_back(DrawData->CmdLists[N]->CloneOutput());
+
+    ImDrawData Captured = *DrawData;
+    Captured.CmdLists = Lists.data();
+
+    const unsigned IndexSize = Captured.TotalVtxCount > 0xffff ? 4 : 2;
+    std::vector<uint8_t> Indices(Captured.TotalIdxCount * IndexSize);
+    std::vector<Gui::TDraw> Draws;
+    std::vector<double> CopyTimes;
+    std::vector<double> MergeTimes;
+    unsigned CmdCount = 0;
+
+    for (unsigned Iteration = 0; Iteration < Options.Iterations; ++Iteration)
+    {
+        double Time = Lib::GetTime();
+        CmdCount = 0;
+        ImDrawIdx* IndexPtr = (ImDrawIdx*)Indices.data();
+        for (ImDrawList* DrawList : Lists)
+        {
+            memcpy(IndexPtr, DrawList->IdxBuffer.Data, DrawList->IdxBuffer.size() * sizeof(ImDrawIdx));
+            IndexPtr += DrawList->IdxBuffer.size();
+            CmdCount += DrawList->CmdBuffer.size();
+        }
+        CopyTimes.push_back(Lib::GetTime() - Time);
+
+        Time = Lib::GetTime();
+        Gui::MergeDrawCommands(&Captured, Indices.data(), IndexSize, Draws);
+        MergeTimes.push_back(Lib::GetTime() - Time);
+    }
+
+    for (ImDrawList* DrawList : Lists)
+        IM_DELETE(DrawList);
+    ShutdownFramework();
+
+    Report("merge.copy_only", CopyTimes);
+    Report("merge.merge", MergeTimes);
+    printf("    %u lists, %u vertices, %u indices: %u draws -> %u draws\n", (unsigned)Lists.size(),
+           Captured.TotalVtxCount, Captured.TotalIdxCount, CmdCount, (unsigned)Draws.size());
+}
+
+// Fence of the simulated GPU for the upload ring: the GPU runs a fixed number of frames behind the CPU
+// and only catches up further when the allocator waits on it. Dx::TSimulatedGpu is the timeline of the
+// null backend instead.
+struct TSimulatedFence
+{
+    uint64_t SubmittedCount;
+    uint64_t CompletedCount;
+};
+
+static uint64_t
+GetSimulatedCompletedValue(void* Context)
+{
+    return ((TSimulatedFence*)Context)->CompletedCount;
+}
+
+static void
+WaitForSimulatedValue(void* Context, uint64_t Value)
+{
+    TSimulatedFence* Gpu = (TSimulatedFence*)Context;
+    assert(Value <= Gpu->SubmittedCount);
+    Gpu->CompletedCount = std::max(Gpu->CompletedCount, Value);
+}
+
+// Draws a grid of images that reference 256 textures through their bindless indices. Descriptors are
+// written once at registration; with per-draw copies (CopyDescriptorsToGpu) every visible texture
+// would be copied into the per-frame range each frame.
+static void
+BindlessTextures(const TOptions& Options)
+{
+    const unsigned TextureCount = 256;
+
+    Plat::THeadlessScript Script = {};
+    Script.FrameCount = Options.FrameCount;
+    Plat::SetHeadlessScript(Script);
+
+    const Plat::TWindow Window = InitializeFramework("demo_bench", 1920, 1080, Options.FrameSettings);
+
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> Descriptors(TextureCount);
+    std::vector<uint32_t> Indices(TextureCount);
+    const Dx::TDescriptorCopyStats StartStats = Dx::GetDescriptorCopyStats();
+    for (unsigned Index = 0; Index < TextureCount; ++Index)
+    {
+        Dx::AllocateDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1, Descriptors[Index]);
+        Indices[Index] = Dx::AllocateBindlessDescriptor(Descriptors[Index]);
+    }
+    const Dx::TDescriptorCopyStats InitStats = Dx::GetDescriptorCopyStats();
+
+    std::vector<double> GuiRender;
+    uint64_t ConstantCount = 0;
+    unsigned FrameCount = 0;
+    while (ProcessFrameEvents())
+    {
+        double Time;
+        float DeltaTime;
+        Lib::UpdateFrameStats(Window, "demo_bench", Time, DeltaTime);
+        Gui::Update(DeltaTime);
+
+        BeginFrame();
+        ImGui::NewFrame();
+        ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+        ImGui::SetNextWindowSize(ImVec2(1920.0f, 1080.0f));
+        ImGui::Begin("Textures");
+        for (unsigned Index = 0; Index < TextureCount; ++Index)
+        {
+            ImGui::Image((ImTextureID)(intptr_t)Indices[Index], ImVec2(48.0f, 48.0f));
+            if ((Index % 32) != 31)
+                ImGui::SameLine();
+        }
+        ImGui::End();
+        ImGui::Render();
+
+        const double GuiRenderTime = Lib::GetTime();
+        Gui::Render();
+        GuiRender.push_back(Lib::GetTime() - GuiRenderTime);
+        ConstantCount += Dx::GCmdList.Counts[Cmd::KCmdSetGraphicsRoot32BitConstant];
+        FrameCount++;
+
+        EndFrame();
+        Dx::PresentFrame();
+    }
+    const Dx::TDescriptorCopyStats EndStats = Dx::GetDescriptorCopyStats();
+
+    for (unsigned Index = 0; Index < TextureCount; ++Index)
+    {
+        Dx::FreeBindlessDescriptor(Indices[Index]);
+        Dx::FreeDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, Descriptors[Index], 1);
+    }
+    ShutdownFramework();
+
+    Report("bindless.gui_render", GuiRender);
+    if (FrameCount == 0)
+        return;
+
+    printf("    %u textures: %llu bindless copies at registration, %.1f copies and %.1f index constants per frame\n",
+           TextureCount, (unsigned long long)(InitStats.BindlessCount - StartStats.BindlessCount),
+           (double)(EndStats.BindlessCount + EndStats.DynamicCount - InitStats.BindlessCount - InitStats.DynamicCount) /
+           FrameCount, (double)ConstantCount / FrameCount);
+}
+
+// Drives a Mem::TRingAllocator with per-frame upload sizes that vary from a few KB to several MB
+// (two spike frames every 64 frames), as happens with UI or streaming. The fixed 8 MB per-frame heaps
+// it replaces would fail on the spikes; the ring absorbs them, and waits on the GPU when the second
+// spike doesn't fit next to the frames in flight.
+// Every allocation is checked, outside of the timed region, against the ranges of the frames the
+// simulated GPU had not completed when it was made.
+static void
+UploadRing(const TOptions& Options)
+{
+    struct TRange
+    {
+        uint64_t Offset;
+        uint64_t Size;
+        // Pending: the fence of the frame that allocated it. Allocated: the completed value when handed out.
+        uint64_t Fence;
+    };
+
+    const uint64_t Capacity = 16*1024*1024;
+    const unsigned Latency = 2;
+
+    TSimulatedFence Gpu = {};
+    Mem::TRingAllocator Ring;
+    Mem::TRingFence Fence = { GetSimulatedCompletedValue, WaitForSimulatedValue, &Gpu };
+    Mem::InitializeRing(Ring, Capacity, Fence);
+
+    std::vector<TRange> Pending, Allocated;
+    std::vector<double> FrameTimes;
+    uint64_t AllocationCount = 0;
+    unsigned OutOfBounds = 0, Overlaps = 0;
+    uint32_t Random = 0x9e3779b9;
+
+    for (unsigned Frame = 0; Frame < Options.FrameCount * 4; ++Frame)
+    {
+        const bool Spike = (Frame % 64) >= 62;
+        const unsigned AllocationsThisFrame = Spike ? 64 : 200;
+        Allocated.clear();
+
+        const double Time = Lib::GetTime();
+        for (unsigned Index = 0; Index < AllocationsThisFrame; ++Index)
+        {
+            Random = Random * 1664525 + 1013904223;
+            const uint64_t Size = Spike ? 64*1024 + (Random >> 12) % (192*1024) : 64 + (Random >> 16) % 4096;
+
+            uint64_t Offset;
+            if (Mem::AllocateRing(Ring, Size, 256, Offset))
+            {
+                Allocated.push_back({ Offset, Size, Gpu.CompletedCount });
+                AllocationCount++;
+            }
+            OutOfBounds += Ring.Head - Ring.Tail > Capacity;
+        }
+        const uint64_t FrameFence = ++Gpu.SubmittedCount;
+        Mem::EndRingFrame(Ring, FrameFence);
+        FrameTimes.push_back(Lib::GetTime() - Time);
+
+        // A new range must not overlap the ranges of this frame or of the frames still pending on the
+        // GPU when it was handed out.
+        for (size_t Index = 0; Index < Allocated.size(); ++Index)
+        {
+            const TRange& Range = Allocated[Index];
+            OutOfBounds += Range.Offset + Range.Size > Capacity;
+            for (const TRange& Other : Pending)
+            {
+                Overlaps += Other.Fence > Range.Fence && Range.Offset < Other.Offset + Other.Size &&
+                            Other.Offset < Range.Offset + Range.Size;
+            }
+            for (size_t Previous = 0; Previous < Index; ++Previous)
+            {
+                const TRange& Other = Allocated[Previous];
+                Overlaps += Range.Offset < Other.Offset + Other.Size && Other.Offset < Range.Offset + Range.Size;
+            }
+        }
+        for (const TRange& Range : Allocated)
+            Pending.push_back({ Range.Offset, Range.Size, FrameFence });
+
+        if (Gpu.SubmittedCount > Latency)
+            Gpu.CompletedCount = std::max(Gpu.CompletedCount, Gpu.SubmittedCount - Latency);
+
+        size_t Kept = 0;
+        for (const TRange& Range : Pending)
+        {
+            if (Range.Fence > Gpu.CompletedCount)
+                Pending[Kept++] = Range;
+        }
+        Pending.resize(Kept);
+    }
+
+    Report("upload.frame", FrameTimes);
+
+    const Mem::TRingStats& Stats = Ring.Stats;
+    printf("    %llu allocations, peak frame %.2f MB, high-water %.2f of %.2f MB\n",
+           (unsigned long long)AllocationCount, Stats.PeakFrameBytes / (1024.0 * 1024.0),
+           Stats.HighWaterMark / (1024.0 * 1024.0), Capacity / (1024.0 * 1024.0));
+    printf("    %u waits, %u wraps, %u failed\n", Stats.WaitCount, Stats.WrapCount, Stats.FailedCount);
+    Check(OutOfBounds == 0, "the upload ring handed out memory outside of its capacity");
+    Check(Overlaps == 0, "the upload ring handed out memory the GPU had not retired");
+}
+
+// Churns a Mem::TPagedAllocator the way runtime texture streaming churns descriptors: each frame
+// creates and destroys a few resources of 1-16 descriptors, frees are deferred by the frame latency.
+// Every handed-out range is checked against an occupancy map outside of the timed region, and the
+// pending count against the deferred frees; either mismatch fails the benchmark.
+static void
+DescriptorChurn(const TOptions& Options)
+{
+    struct TLive
+    {
+        uint32_t Index;
+        unsigned Count;
+        uint64_t Frame; // fence value of the free
+    };
+
+    const unsigned PageSize = 1024;
+    const unsigned Latency = 2;
+    const unsigned TargetLiveCount = 4000;
+
+    Mem::TPagedAllocator Allocator;
+    Mem::InitializePaged(Allocator, PageSize, 0);
+
+    std::vector<TLive> Live;
+    std::vector<TLive> Freed;
+    std::vector<uint8_t> Occupied;
+    std::vector<double> FrameTimes;
+    uint32_t Random = 0x2545f491;
+    unsigned Overlaps = 0, PendingMismatches = 0;
+
+    for (unsigned Frame = 0; Frame < Options.FrameCount * 4; ++Frame)
+    {
+        TLive Allocated[64];
+        unsigned AllocatedCount = 0;
+        const uint64_t CompletedFrame = Frame > Latency ? Frame - Latency : 0;
+
+        // Ranges stay marked in the occupancy map until their fence completes, so handing out a
+        // pending range too early shows up as an overlap.
+        Occupied.resize(Allocator.Stats.PageCount * PageSize);
+        size_t Retired = 0;
+        while (Retired < Freed.size() && Freed[Retired].Frame <= CompletedFrame)
+        {
+            memset(&Occupied[Freed[Retired].Index], 0, Freed[Retired].Count);
+            Retired++;
+        }
+        Freed.erase(Freed.begin(), Freed.begin() + Retired);
+
+        const double Time = Lib::GetTime();
+        Mem::RetirePaged(Allocator, CompletedFrame);
+        for (unsigned Op = 0; Op < 64; ++Op)
+        {
+            Random = Random * 1664525 + 1013904223;
+            const bool Allocate = Live.size() + AllocatedCount < TargetLiveCount / 2 ||
+                                  (Random >> 8) % TargetLiveCount >= Live.size() + AllocatedCount;
+            if (Allocate)
+            {
+                TLive Range;
+                Range.Count = 1 + (Random >> 20) % 16;
+                if (Mem::AllocatePaged(Allocator, Range.Count, Range.Index))
+                    Allocated[AllocatedCount++] = Range;
+            }
+            else if (!Live.empty())
+            {
+                const size_t Victim = (Random >> 4) % Live.size();
+                Live[Victim].Frame = Frame + 1;
+                Mem::DeferFreePaged(Allocator, Live[Victim].Index, Live[Victim].Count, Live[Victim].Frame);
+                Freed.push_back(Live[Victim]);
+                Live[Victim] = Live.back();
+                Live.pop_back();
+            }
+        }
+        FrameTimes.push_back(Lib::GetTime() - Time);
+
+        // The allocator holds exactly the freed descriptors whose fence hasn't completed.
+        unsigned PendingCount = 0;
+        for (const TLive& Range : Freed)
+            PendingCount += Range.Count;
+        PendingMismatches += PendingCount != Allocator.Stats.PendingCount;
+
+        Occupied.resize(Allocator.Stats.PageCount * PageSize);
+        for (unsigned Index = 0; Index < AllocatedCount; ++Index)
+        {
+            const TLive& Range = Allocated[Index];
+            if ((Range.Index % PageSize) + Range.Count > PageSize)
+                Overlaps++;
+            for (unsigned Slot = 0; Slot < Range.Count; ++Slot)
+                Overlaps += Occupied[Range.Index + Slot]++ != 0;
+            Live.push_back(Range);
+        }
+    }
+
+    Report("descriptors.frame", FrameTimes);
+
+    const Mem::TPagedStats& Stats = Allocator.Stats;
+    const unsigned Capacity = Stats.PageCount * PageSize;
+    printf("    %u allocations, %u live descriptors in %u pages (%.1f%% utilization)\n", Stats.AllocationCount,
+           Stats.LiveCount, Stats.PageCount, 100.0 * Stats.LiveCount / Capacity);
+    printf("    %.1f%% rounding waste, %u free, %u pending, %u failed, %u overlaps\n",
+           100.0 * (Stats.ReservedCount - Stats.LiveCount) / Stats.ReservedCount, Stats.FreeCount,
+           Stats.PendingCount, Stats.FailedCount, Overlaps);
+    Check(Overlaps == 0, "the paged allocator handed out a range in use, pending or across pages");
+    Check(Stats.FailedCount == 0, "the paged allocator failed an allocation");
+    Check(PendingMismatches == 0, "the paged allocator's pending count differs from the deferred frees");
+}
+
+// Runs the frame loop against a simulated GPU for every frames-in-flight setting, with and without
+// low latency mode. The simulated CPU (5 ms) and GPU (8 ms) frame times vary by up to +-40%. Reports
+// the time from input sampling to the present of the frame (the end of the frame on the GPU; the
+// simulation presents without vsync), and frames per second. Low latency mode trades throughput for
+// latency: from 3 frames in flight on its latency must be below that of the normal mode.
+static void
+FrameLatency(const TOptions& Options)
+{
+    const double CpuFrameTime = 0.005;
+    const double GpuFrameTime = 0.008;
+
+    for (unsigned FramesInFlight = 1; FramesInFlight <= Dx::KMaxFramesInFlight; ++FramesInFlight)
+    {
+        double AverageLatencies[2] = {};
+        for (unsigned LowLatency = 0; LowLatency < 2; ++LowLatency)
+        {
+            Plat::THeadlessScript Script = {};
+            Script.FrameCount = Options.FrameCount;
+            Plat::SetHeadlessScript(Script);
+
+            Dx::TSimulatedGpu Gpu = {};
+            Dx::SetSimulatedGpu(&Gpu);
+
+            const Dx::TFrameSettings FrameSettings = { FramesInFlight, LowLatency != 0 };
+            const Plat::TWindow Window = InitializeFramework("demo_bench", 1920, 1080, FrameSettings);
+
+            std::vector<double> Latencies;
+            const double StartTime = Gpu.Clock;
+            const double StartWaitTime = Gpu.WaitTime;
+            uint32_t Random = 0x6b43a9b5;
+            while (ProcessFrameEvents())
+            {
+                const double InputTime = Gpu.Clock;
+
+                Random = Random * 1664525 + 1013904223;
+                Gpu.Clock += CpuFrameTime * (0.6 + 0.8 * ((Random >> 8) & 0xffff) / 65535.0);
+                Random = Random * 1664525 + 1013904223;
+                Gpu.FrameTime = GpuFrameTime * (0.6 + 0.8 * ((Random >> 8) & 0xffff) / 65535.0);
+
+                RunFrame(Window, "demo_bench");
+                Latencies.push_back(Gpu.LastEndTime - InputTime);
+            }
+            const double Duration = Gpu.Clock - StartTime;
+            const double WaitTime = Gpu.WaitTime - StartWaitTime;
+
+            ShutdownFramework();
+            Dx::SetSimulatedGpu(nullptr);
+
+            char Name[64];
+            snprintf(Name, sizeof(Name), "latency.frames%u%s", FramesInFlight, LowLatency ? ".low" : "");
+            Report(Name, Latencies);
+            if (Duration > 0.0)
+                printf("    %.1f fps, CPU waited %.1f%% of the time\n", Latencies.size() / Duration,
+                       100.0 * WaitTime / Duration);
+
+            for (double Latency : Latencies)
+                AverageLatencies[LowLatency] += Latency / Latencies.size();
+        }
+        if (FramesInFlight >= 3)
+            Check(AverageLatencies[1] < AverageLatencies[0], "low latency mode didn't lower the latency");
+    }
+}
+
+// Cost of a zone (begin + end) and of collecting a frame of them, then the per-zone table of a frame
+// loop run.
+static void
+Profiler(const TOptions& Options)
+{
+    const unsigned ZonesPerFrame = 1000;
+    const unsigned OuterZone = Prof::RegisterZone("bench.outer");
+    const unsigned InnerZone = Prof::RegisterZone("bench.inner");
+
+    std::vector<double> ZoneTimes;
+    std::vector<double> CollectTimes;
+    for (unsigned Iteration = 0; Iteration < Options.Iterations; ++Iteration)
+    {
+        const double Time = Lib::GetTime();
+        for (unsigned Index = 0; Index < ZonesPerFrame / 2; ++Index)
+        {
+            Prof::BeginZone(OuterZone);
+            Prof::BeginZone(InnerZone);
+            Prof::EndZone(InnerZone);
+            Prof::EndZone(OuterZone);
+        }
+        const double CollectTime = Lib::GetTime();
+        Prof::EndFrame();
+        CollectTimes.push_back(Lib::GetTime() - CollectTime);
+        ZoneTimes.push_back(CollectTime - Time);
+    }
+
+    Report("profiler.zones", ZoneTimes);
+    Report("profiler.collect", CollectTimes);
+    std::sort(ZoneTimes.begin(), ZoneTimes.end());
+    printf("    %.1f ns per zone (p50, %u zones per frame)\n", ZoneTimes[ZoneTimes.size() / 2] * 1e9 / ZonesPerFrame,
+           ZonesPerFrame);
+
+    FrameLoop(Options);
+
+    printf("    %-24s %9s %9s %9s %9s  ms\n", "zone", "last", "min", "avg", "p99");
+    for (unsigned ZoneId = 0; ZoneId < Prof::GetZoneCount(); ++ZoneId)
+    {
+        Prof::TZoneStats Stats;
+        if (Prof::GetZoneStats(ZoneId, Stats))
+            printf("    %-24s %9.4f %9.4f %9.4f %9.4f\n", Stats.Name, Stats.Last * 1000.0, Stats.Min * 1000.0,
+                   Stats.Avg * 1000.0, Stats.P99 * 1000.0);
+    }
+}
+
+// Drives Gui::Render() with a UI of RectCounts[Frame] overlay rects per frame (4 vertices and 6
+// indices each) and reports the geometry bytes taken from the upload ring per frame: the UI grows to
+// 20000 rects, holds, flickers between 20000 and 2000 rects, then drops to 1000 rects. The ring must
+// give the geometry exactly the bytes it uses in every phase.
+static void
+GuiGrowth(const TOptions& Options)
+{
+    std::vector<unsigned> RectCounts;
+    for (unsigned Frame = 0; Frame < 400; ++Frame)
+        RectCounts.push_back(50 * (Frame + 1));
+    const size_t HoldStart = RectCounts.size();
+    RectCounts.resize(HoldStart + 200, 20000);
+    const size_t FlickerStart = RectCounts.size();
+    for (unsigned Frame = 0; Frame < 200; ++Frame)
+        RectCounts.push_back(Frame & 1 ? 20000 : 2000);
+    const size_t DropStart = RectCounts.size();
+    RectCounts.resize(DropStart + 300, 1000);
+
+    Plat::THeadlessScript Script = {};
+    Script.FrameCount = (unsigned)RectCounts.size();
+    Plat::SetHeadlessScript(Script);
+
+    const Plat::TWindow Window = InitializeFramework("demo_bench", 1920, 1080, Options.FrameSettings);
+
+    unsigned ExactSizeReallocations = 0;
+    unsigned ExactSizes[Dx::KMaxFramesInFlight][2] = {};
+    unsigned RingSizeMismatches = 0;
+    uint64_t RingBytes[4] = {};
+    unsigned PeakRingBytes = 0;
+    std::vector<double> FrameTimes;
+
+    for (size_t Frame = 0; ProcessFrameEvents(); ++Frame)
+    {
+        const double Time = Lib::GetTime();
+
+        double FrameTime;
+        float DeltaTime;
+        Lib::UpdateFrameStats(Window, "demo_bench", FrameTime, DeltaTime);
+        Gui::Update(DeltaTime);
+
+        BeginFrame();
+        ImGui::NewFrame();
+        // Draw lists use 16-bit indices, so the rects are spread over windows of at most 10000.
+        for (unsigned First = 0; First < RectCounts[Frame]; First += 10000)
+        {
+            char Name[32];
+            snprintf(Name, sizeof(Name), "Growth %u", First / 10000);
+            ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+            ImGui::SetNextWindowSize(ImVec2(1900.0f, 1000.0f));
+            ImGui::Begin(Name);
+            ImDrawList* DrawList = ImGui::GetWindowDrawList();
+            for (unsigned Rect = 0; Rect < std::min(RectCounts[Frame] - First, 10000u); ++Rect)
+            {
+                const ImVec2 Min((float)(Rect % 200) * 9.0f, (float)(Rect / 200) * 9.0f);
+                DrawList->AddRectFilled(Min, ImVec2(Min.x + 8.0f, Min.y + 8.0f), IM_COL32(255, 128, 0, 255));
+            }
+            ImGui::End();
+        }
+        ImGui::Render();
+        Gui::Render();
+        EndFrame();
+        Dx::PresentFrame();
+
+        FrameTimes.push_back(Lib::GetTime() - Time);
+
+        // What the per-frame committed buffers sized to the exact need would have done.
+        const ImDrawData* DrawData = ImGui::GetDrawData();
+        const unsigned IndexSize = DrawData->TotalVtxCount > 0xffff ? 4 : 2;
+        const unsigned Sizes[2] = { DrawData->TotalVtxCount * (unsigned)sizeof(ImDrawVert),
+                                    DrawData->TotalIdxCount * IndexSize };
+        unsigned* Exact = ExactSizes[Frame % Options.FrameSettings.FramesInFlight];
+        for (unsigned Index = 0; Index < 2; ++Index)
+        {
+            if (Sizes[Index] > Exact[Index])
+            {
+                Exact[Index] = Sizes[Index];
+                ExactSizeReallocations++;
+            }
+        }
+
+        const Gui::TGeometryStats& Stats = Gui::GetGeometryStats();
+        RingSizeMismatches += Stats.VertexSize != Sizes[0] || Stats.IndexSize != Sizes[1];
+        RingBytes[(Frame >= HoldStart) + (Frame >= FlickerStart) + (Frame >= DropStart)] +=
+            Stats.VertexSize + Stats.IndexSize;
+        PeakRingBytes = std::max(PeakRingBytes, Stats.VertexSize + Stats.IndexSize);
+    }
+
+    ShutdownFramework();
+
+    const size_t PhaseFrames[4] = { HoldStart, FlickerStart - HoldStart, DropStart - FlickerStart,
+                                    RectCounts.size() - DropStart };
+    Report("guigrowth.frame", FrameTimes);
+    printf("    upload ring KB of geometry per frame: grow %.1f, hold %.1f, flicker %.1f, drop %.1f; peak %.1f\n",
+           RingBytes[0] / 1024.0 / PhaseFrames[0], RingBytes[1] / 1024.0 / PhaseFrames[1],
+           RingBytes[2] / 1024.0 / PhaseFrames[2], RingBytes[3] / 1024.0 / PhaseFrames[3], PeakRingBytes / 1024.0);
+    printf("    exact-size committed buffers: %u reallocations\n", ExactSizeReallocations);
+
+    Check(RingSizeMismatches == 0, "the geometry took more or less than its size from the upload ring");
+}
+
+// Copies 160000 vertices (3.2 MB) spread over 96 draw lists of varying size into one buffer: the
+// old serial memcpy loop, then Gui::CopyVertices() with streaming stores and 0..N worker threads.
+static void
+VertexCopy(const TOptions& Options)
+{
+    std::vector<ImDrawList*> DrawLists;
+    unsigned VertexCount = 0;
+    uint32_t Random = 0x2545f491;
+    for (unsigned Index = 0; Index < 96; ++Index)
+    {
+        Random = Random * 1664525 + 1013904223;
+        const unsigned Count = Index == 95 ? 160000 - VertexCount : 200 + (Random >> 8) % 2400;
+        ImDrawList* DrawList = new ImDrawList(nullptr);
+        DrawList->VtxBuffer.resize(Count);
+        memset((uint8_t*)DrawList->VtxBuffer.Data, (int)Index, Count * sizeof(ImDrawVert));
+        DrawLists.push_back(DrawList);
+        VertexCount += Count;
+    }
+
+    ImDrawData DrawData;
+    DrawData.Valid = true;
+    DrawData.CmdLists = DrawLists.data();
+    DrawData.CmdListsCount = (int)DrawLists.size();
+    DrawData.TotalVtxCount = (int)VertexCount;
+
+    // The null backend's upload memory is ordinary memory as well.
+    std::vector<ImDrawVert> Destination(VertexCount);
+    ImDrawVert* Vertices = Destination.data();
+
+    std::vector<double> Times;
+    for (unsigned Iteration = 0; Iteration < Options.Iterations; ++Iteration)
+    {
+        const double Time = Lib::GetTime();
+        ImDrawVert* VertexPtr = Vertices;
+        for (ImDrawList* DrawList : DrawLists)
+        {
+            memcpy(VertexPtr, &DrawList->VtxBuffer[0], DrawList->VtxBuffer.size() * sizeof(ImDrawVert));
+            VertexPtr += DrawList->VtxBuffer.size();
+        }
+        Times.push_back(Lib::GetTime() - Time);
+    }
+    Report("vertexcopy.memcpy", Times);
+    const double Baseline = Times[Times.size() / 2];
+
+    for (unsigned WorkerCount : GetWorkerCounts())
+    {
+        Jobs::Initialize(WorkerCount);
+        Times.clear();
+        for (unsigned Iteration = 0; Iteration < Options.Iterations; ++Iteration)
+        {
+            const double Time = Lib::GetTime();
+            Gui::CopyVertices(&DrawData, Vertices);
+            Times.push_back(Lib::GetTime() - Time);
+        }
+        Jobs::Shutdown();
+
+        size_t Mismatches = 0;
+        const ImDrawVert* VertexPtr = Vertices;
+        for (ImDrawList* DrawList : DrawLists)
+        {
+            Mismatches += memcmp(VertexPtr, DrawList->VtxBuffer.Data, DrawList->VtxBuffer.size() * sizeof(ImDrawVert)) != 0;
+            VertexPtr += DrawList->VtxBuffer.size();
+        }
+        Check(Mismatches == 0, "copied vertices differ from the draw lists");
+
+        char Name[64];
+        snprintf(Name, sizeof(Name), "vertexcopy.workers%u", WorkerCount);
+        Report(Name, Times);
+        std::sort(Times.begin(), Times.end());
+        printf("    %.2fx the memcpy loop, %.1f GB/s\n", Baseline / Times[Times.size() / 2],
+               VertexCount * sizeof(ImDrawVert) / Times[Times.size() / 2] * 1e-9);
+    }
+
+    for (ImDrawList* DrawList : DrawLists)
+        delete DrawList;
+}
+
+static void
+EmptyJob(void*, unsigned, unsigned)
+{
+}
+
+// About 100 ns of arithmetic per item.
+static void
+ComputeJob(void* Context, unsigned Begin, unsigned End)
+{
+    float* Values = (float*)Context;
+    for (unsigned Index = Begin; Index < End; ++Index)
+    {
+        float Value = (float)Index;
+        for (unsigned Step = 0; Step < 32; ++Step)
+            Value = Value * 0.999f + 0.5f / (1.0f + Value * Value);
+        Values[Index] = Value;
+    }
+}
+
+struct TStageData
+{
+    std::vector<unsigned> Input;
+    std::vector<unsigned> Doubled;
+    std::vector<unsigned> Output;
+};
+
+static void
+FillJob(void* Context, unsigned Begin, unsigned End)
+{
+    TStageData& Data = *(TStageData*)Context;
+    for (unsigned Index = Begin; Index < End; ++Index)
+        Data.Input[Index] = Index;
+}
+
+static void
+DoubleJob(void* Context, unsigned Begin, unsigned End)
+{
+    TStageData& Data = *(TStageData*)Context;
+    for (unsigned Index = Begin; Index < End; ++Index)
+        Data.Doubled[Index] = Data.Input[Index] * 2;
+}
+
+// Nested: splits its range again and waits for the parts, from inside a job.
+static void
+IncrementJob(void* Context, unsigned Begin, unsigned End)
+{
+    TStageData& Data = *(TStageData*)Context;
+    if (End - Begin > 256)
+    {
+        struct TPart
+        {
+            static void
+            Run(void* Context, unsigned Begin, unsigned End)
+            {
+                TStageData& Data = *(TStageData*)Context;
+                for (unsigned Index = Begin; Index < End; ++Index)
+                    Data.Output[Index] = Data.Doubled[Index] + 1;
+            }
+        };
+        const unsigned Middle = Begin + (End - Begin) / 2;
+        const Jobs::TJob Parts[2] = { { TPart::Run, Context, Begin, Middle }, { TPart::Run, Context, Middle, End } };
+        Jobs::TCounter Counter = {};
+        Jobs::Run(Parts, 2, &Counter);
+        Jobs::Wait(&Counter);
+        return;
+    }
+    for (unsigned Index = Begin; Index < End; ++Index)
+        Data.Output[Index] = Data.Doubled[Index] + 1;
+}
+
+// Spawn + execute cost of empty jobs, a compute-bound ParallelFor for growing worker counts, and a
+// three stage pipeline chained with RunAfter() whose last stage waits on nested jobs.
+static void
+JobSystem(const TOptions& Options)
+{
+    const unsigned BatchSize = 4096;
+    std::vector<Jobs::TJob> EmptyJobs(BatchSize, { EmptyJob, nullptr, 0, 1 });
+
+    const unsigned ItemCount = 1 << 20;
+    std::vector<float> Values(ItemCount);
+    double SerialTime = 0.0;
+
+    for (unsigned WorkerCount : GetWorkerCounts())
+    {
+        Jobs::Initialize(WorkerCount);
+
+        std::vector<double> SpawnTimes;
+        for (unsigned Iteration = 0; Iteration < Options.Iterations; ++Iteration)
+        {
+            const double Time = Lib::GetTime();
+            Jobs::TCounter Counter = {};
+            Jobs::Run(EmptyJobs.data(), BatchSize, &Counter);
+            Jobs::Wait(&Counter);
+            SpawnTimes.push_back((Lib::GetTime() - Time) / BatchSize);
+        }
+        const Jobs::TStats SpawnStats = Jobs::GetStats();
+
+        std::vector<double> ForTimes;
+        for (unsigned Iteration = 0; Iteration < std::max(Options.Iterations / 10, 3u); ++Iteration)
+        {
+            const double Time = Lib::GetTime();
+            Jobs::ParallelFor(ItemCount, 4096, ComputeJob, Values.data());
+            ForTimes.push_back(Lib::GetTime() - Time);
+        }
+
+        TStageData Data;
+        Data.Input.resize(ItemCount);
+        Data.Doubled.resize(ItemCount);
+        Data.Output.resize(ItemCount);
+        std::vector<Jobs::TJob> Stages[3];
+        for (unsigned Begin = 0; Begin < ItemCount; Begin += 16384)
+        {
+            Stages[0].push_back({ FillJob, &Data, Begin, Begin + 16384 });
+            Stages[1].push_back({ DoubleJob, &Data, Begin, Begin + 16384 });
+            Stages[2].push_back({ IncrementJob, &Data, Begin, Begin + 16384 });
+        }
+        Jobs::TCounter Counters[3] = {};
+        Jobs::Run(Stages[0].data(), (unsigned)Stages[0].size(), &Counters[0]);
+        Jobs::RunAfter(&Counters[0], Stages[1].data(), (unsigned)Stages[1].size(), &Counters[1]);
+        Jobs::RunAfter(&Counters[1], Stages[2].data(), (unsigned)Stages[2].size(), &Counters[2]);
+        Jobs::Wait(&Counters[2]);
+
+        unsigned Mismatches = 0;
+        for (unsigned Index = 0; Index < ItemCount; ++Index)
+            Mismatches += Data.Output[Index] != Index * 2 + 1;
+        Check(Mismatches == 0, "dependent stages ran out of order");
+
+        Jobs::Shutdown();
+
+        std::sort(SpawnTimes.begin(), SpawnTimes.end());
+        printf("jobs.workers%u.spawn %*.1f ns per job (p50), %.1f%% stolen, %llu sleeps\n", WorkerCount,
+               WorkerCount < 10 ? 12 : 11, SpawnTimes[SpawnTimes.size() / 2] * 1e9,
+               100.0 * SpawnStats.StealCount / std::max(SpawnStats.JobCount, (uint64_t)1),
+               (unsigned long long)SpawnStats.SleepCount);
+
+        char Name[64];
+        snprintf(Name, sizeof(Name), "jobs.workers%u.parallelfor", WorkerCount);
+        Report(Name, ForTimes);
+        if (WorkerCount == 0)
+            SerialTime = ForTimes[ForTimes.size() / 2];
+        printf("    %.2fx speedup over no workers\n", SerialTime / ForTimes[ForTimes.size() / 2]);
+    }
+}
+
+struct TScenePasses
+{
+    unsigned DrawsPerPass;
+    D3D12_CPU_DESCRIPTOR_HANDLE Descriptor;
+    std::vector<D3D12_GPU_VIRTUAL_ADDRESS> Addresses[64]; // constant buffers, per pass
+};
+
+// Pass N records DrawsPerPass + N draws, each with its own constant buffer, and a descriptor table
+// copy every 16 draws.
+static void
+RecordScenePass(void* Context, unsigned Pass, Cmd::TCommandList& List)
+{
+    TScenePasses& Scene = *(TScenePasses*)Context;
+    std::vector<D3D12_GPU_VIRTUAL_ADDRESS>& Addresses = Scene.Addresses[Pass];
+    Addresses.clear();
+
+    ID3D12Resource* BackBuffer;
+    D3D12_CPU_DESCRIPTOR_HANDLE BackBufferHandle;
+    Dx::GetBackBuffer(BackBuffer, BackBufferHandle);
+
+    const D3D12_VIEWPORT Viewport = { 0.0f, 0.0f, (float)Dx::GResolution[0], (float)Dx::GResolution[1], 0.0f, 1.0f };
+    Cmd::OMSetRenderTargets(List, BackBufferHandle, &Dx::GDepthBufferHandle);
+    Cmd::RSSetViewports(List, Viewport);
+    Cmd::IASetPrimitiveTopology(List, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+    for (unsigned Draw = 0; Draw < Scene.DrawsPerPass + Pass; ++Draw)
+    {
+        D3D12_GPU_VIRTUAL_ADDRESS Address;
+        float* Constants = (float*)Dx::AllocateGpuUploadMemory(64, Address);
+        for (unsigned Index = 0; Index < 16; ++Index)
+            Constants[Index] = (float)(Draw + Index);
+        Addresses.push_back(Address);
+
+        if (Draw % 16 == 0)
+            Cmd::SetGraphicsRootDescriptorTable(List, 1, Dx::CopyDescriptorsToGpu(1, Scene.Descriptor));
+        Cmd::SetGraphicsRootConstantBufferView(List, 0, Address);
+        Cmd::SetGraphicsRoot32BitConstant(List, 2, Draw, 0);
+        Cmd::DrawIndexedInstanced(List, 36, 1, 0, 0, 0);
+    }
+}
+
+// Records 32 scene passes per frame with Dx::RecordPasses() for growing worker counts, checks the
+// submission order, that no two passes got the same upload memory and that no allocator had two lists
+// open at once, and reports the speedup.
+static void
+CommandRecording(const TOptions& Options)
+{
+    const unsigned PassCount = 32;
+    TScenePasses* Scene = new TScenePasses();
+    Scene->DrawsPerPass = 500;
+
+    double SerialTime = 0.0;
+    for (unsigned WorkerCount : GetWorkerCounts())
+    {
+        Plat::THeadlessScript Script = {};
+        Script.FrameCount = std::min(Options.FrameCount, 200u);
+        Plat::SetHeadlessScript(Script);
+
+        Jobs::Initialize(WorkerCount);
+        ImGui::CreateContext();
+        const Plat::TWindow Window = Plat::Initialize("demo_bench", 1920, 1080);
+        Dx::Initialize(Window, Options.FrameSettings);
+        Dx::AllocateDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1, Scene->Descriptor);
+
+        std::vector<double> Times;
+        std::vector<D3D12_GPU_VIRTUAL_ADDRESS> Addresses;
+        unsigned OrderErrors = 0;
+        unsigned Overlaps = 0;
+        while (Plat::ProcessEvents())
+        {
+            Dx::ResetCommandList();
+            Dx::SetDescriptorHeap();
+
+            const double Time = Lib::GetTime();
+            Dx::RecordPasses(PassCount, RecordScenePass, Scene);
+            Times.push_back(Lib::GetTime() - Time);
+
+            Dx::ExecuteCommandList();
+
+            // The part of GCmdList before the passes, the passes in order, then GCmdList.
+            const std::vector<Cmd::TCommandList*>& Lists = Dx::GetSubmittedCommandLists();
+            OrderErrors += Lists.size() != PassCount + 2 || Lists.back() != &Dx::GCmdList;
+            for (unsigned Pass = 0; Pass < PassCount && Pass + 1 < Lists.size(); ++Pass)
+                OrderErrors += Lists[Pass + 1]->Counts[Cmd::KCmdDrawIndexedInstanced] != Scene->DrawsPerPass + Pass;
+
+            Addresses.clear();
+            for (unsigned Pass = 0; Pass < PassCount; ++Pass)
+                Addresses.insert(Addresses.end(), Scene->Addresses[Pass].begin(), Scene->Addresses[Pass].end());
+            std::sort(Addresses.begin(), Addresses.end());
+            for (size_t Index = 1; Index < Addresses.size(); ++Index)
+                Overlaps += Addresses[Index] - Addresses[Index - 1] < 64;
+
+            Dx::PresentFrame();
+        }
+
+        Dx::FreeDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, Scene->Descriptor, 1);
+        Dx::WaitForGpu();
+        const unsigned AllocatorConflicts = Dx::GetAllocatorConflictCount();
+        Dx::Shutdown();
+        Plat::Shutdown();
+        ImGui::DestroyContext();
+        Jobs::Shutdown();
+
+        char Name[64];
+        snprintf(Name, sizeof(Name), "recording.workers%u", WorkerCount);
+        Report(Name, Times);
+        std::sort(Times.begin(), Times.end());
+        const double Median = Times[Times.size() / 2];
+        if (WorkerCount == 0)
+            SerialTime = Median;
+        const unsigned DrawCount = PassCount * Scene->DrawsPerPass + PassCount * (PassCount - 1) / 2;
+        printf("    %.2fx speedup over no workers, %.0f draws per ms\n", SerialTime / Median,
+               DrawCount / (Median * 1000.0));
+        Check(OrderErrors == 0, "passes were submitted out of order");
+        Check(Overlaps == 0, "passes got overlapping upload memory");
+        Check(AllocatorConflicts == 0, "two command lists were open on one allocator");
+    }
+    delete Scene;
+}
+
+// What Lib::LoadFile used to do: a private heap copy of the whole file.
+static std::vector<uint8_t>
+ReadFileCopy(const char* FileName)
+{
+    std::vector<uint8_t> Content;
+    if (FILE* File = fopen(FileName, "rb"))
+    {
+        fseek(File, 0, SEEK_END);
+        Content.resize((size_t)ftell(File));
+        fseek(File, 0, SEEK_SET);
+        if (fread(Content.data(), 1, Content.size(), File) != Content.size())
+            Content.clear();
+        fclose(File);
+    }
+    return Content;
+}
+
+// Stands in for the consumer (font parser, PSO creation) reading every byte of the asset.
+static uint64_t
+ChecksumAsset(const uint8_t* Data, size_t Size)
+{
+    uint64_t Sum = 0;
+    for (size_t Index = 0; Index + 8 <= Size; Index += 8)
+    {
+        uint64_t Word;
+        memcpy(&Word, Data + Index, 8);
+        Sum = (Sum ^ Word) * 0x100000001b3ull;
+    }
+    return Sum;
+}
+
+// Private (anonymous) resident memory and peak resident memory of the process in KB; zero where the
+// OS doesn't report them. Writing 5 to clear_refs resets the peak.
+static void
+GetMemoryUsage(uint64_t& OutPrivate, uint64_t& OutPeak)
+{
+    OutPrivate = OutPeak = 0;
+#if defined(__linux__)
+    if (FILE* File = fopen("/proc/self/status", "r"))
+    {
+        char Line[256];
+        while (fgets(Line, sizeof(Line), File))
+        {
+            unsigned long long Value;
+            if (sscanf(Line, "RssAnon: %llu", &Value) == 1)
+                OutPrivate = Value;
+            else if (sscanf(Line, "VmHWM: %llu", &Value) == 1)
+                OutPeak = Value;
+        }
+        fclose(File);
+    }
+#endif
+}
+
+static void
+ResetPeakMemoryUsage()
+{
+#if defined(__linux__)
+    if (FILE* File = fopen("/proc/self/clear_refs", "w"))
+    {
+        fputs("5", File);
+        fclose(File);
+    }
+#endif
+}
+
+// Loads a 64 MB asset with a heap copy and with Lib::MapFile(), reads it once like a consumer would,
+// and reports the load time and how much private and peak memory each way costs while it's held.
+static void
+AssetLoading(const TOptions& Options)
+{
+    const size_t AssetSize = 64 << 20;
+    const char* TempDirectory = getenv("TMPDIR");
+    char FileName[512];
+    snprintf(FileName, sizeof(FileName), "%s/demo_bench_asset.bin", TempDirectory ? TempDirectory : "/tmp");
+
+    {
+        FILE* File = fopen(FileName, "wb");
+        if (!File)
+        {
+            printf("assetload: can't create %s\n", FileName);
+            return;
+        }
+        std::vector<uint32_t> Block(1 << 16);
+        uint32_t Random = 1;
+        for (size_t Written = 0; Written < AssetSize; Written += Block.size() * 4)
+        {
+            for (uint32_t& Word : Block)
+                Word = Random = Random * 1664525u + 1013904223u;
+            fwrite(Block.data(), 4, Block.size(), File);
+        }
+        fclose(File);
+    }
+
+    const unsigned Iterations = std::max(std::min(Options.Iterations, 20u), 1u);
+    std::vector<double> CopyTimes, MapTimes;
+    uint64_t CopyPrivate = 0, CopyPeak = 0, MapPrivate = 0, MapPeak = 0;
+    uint64_t CopySum = 0, MapSum = 0;
+
+    for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration)
+    {
+        uint64_t BasePrivate, BasePeak, Private, Peak;
+
+        ResetPeakMemoryUsage();
+        GetMemoryUsage(BasePrivate, BasePeak);
+        double Time = Lib::GetTime();
+        {
+            std::vector<uint8_t> Content = ReadFileCopy(FileName);
+            CopySum = ChecksumAsset(Content.data(), Content.size());
+            CopyTimes.push_back(Lib::GetTime() - Time);
+            GetMemoryUsage(Private, Peak);
+        }
+        CopyPrivate = std::max(CopyPrivate, Private - std::min(Private, BasePrivate));
+        CopyPeak = std::max(CopyPeak, Peak - std::min(Peak, BasePeak));
+
+        ResetPeakMemoryUsage();
+        GetMemoryUsage(BasePrivate, BasePeak);
+        Time = Lib::GetTime();
+        {
+            Lib::TMappedFile File = Lib::MapFile(FileName);
+            MapSum = ChecksumAsset(File.Data, File.Size);
+            MapTimes.push_back(Lib::GetTime() - Time);
+            GetMemoryUsage(Private, Peak);
+            Check(File.Size == AssetSize, "mapped size doesn't match the file");
+            Lib::UnmapFile(File);
+        }
+        MapPrivate = std::max(MapPrivate, Private - std::min(Private, BasePrivate));
+        MapPeak = std::max(MapPeak, Peak - std::min(Peak, BasePeak));
+    }
+    remove(FileName);
+
+    Report("assetload.copy", CopyTimes);
+    printf("    %llu KB private, %llu KB peak growth\n", (unsigned long long)CopyPrivate,
+           (unsigned long long)CopyPeak);
+    Report("assetload.map", MapTimes);
+    printf("    %llu KB private, %llu KB peak growth\n", (unsigned long long)MapPrivate,
+           (unsigned long long)MapPeak);
+    Check(CopySum == MapSum, "mapped content differs from the copy");
+
+    Lib::TMappedFile Missing = Lib::MapFile("Data/does_not_exist.bin");
+    Check(!Missing.Data && Missing.Size == 0, "mapping a missing file didn't fail");
+}
+
+// Result slot of one streamed asset, filled in by its Decode and Complete handlers.
+struct TStreamedAsset
+{
+    uint64_t Checksum;
+    double CompleteTime;
+    bool Completed;
+};
+
+// Stands in for decoding (image or mesh parsing): a few passes over the data.
+static uint64_t
+DecodeStreamedData(const uint8_t* Data, size_t Size)
+{
+    uint64_t Sum = 0;
+    for (unsigned Pass = 0; Pass < 4; ++Pass)
+        Sum += ChecksumAsset(Data, Size) >> Pass;
+    return Sum;
+}
+
+static void
+DecodeStreamedAsset(Load::TAsset& Asset)
+{
+    ((TStreamedAsset*)Asset.Context)->Checksum = DecodeStreamedData(Asset.Data, Asset.Size);
+}
+
+static void
+CompleteStreamedAsset(Load::TAsset& Asset)
+{
+    TStreamedAsset& Streamed = *(TStreamedAsset*)Asset.Context;
+    Streamed.CompleteTime = Lib::GetTime();
+    Streamed.Completed = !Asset.Failed;
+}
+
+// Loads a directory of 400 assets (16..256 KB) read and decoded one after another on the main thread,
+// then through Load with io_uring (where available) and with reader threads. Reports the time until
+// the first asset is usable and until all are, with the main thread polling Load::Update() like the
+// frame loop does. The files were just written, so reads come from the OS cache.
+static void
+AssetStreaming(const TOptions& Options)
+{
+    const unsigned AssetCount = 400;
+    const char* TempDirectory = getenv("TMPDIR");
+    char Directory[512];
+    snprintf(Directory, sizeof(Directory), "%s/demo_bench_assets", TempDirectory ? TempDirectory : "/tmp");
+#if defined(_WIN32)
+    _mkdir(Directory);
+#else
+    mkdir(Directory, 0755);
+#endif
+
+    std::vector<std::string> FileNames;
+    uint32_t Random = 7;
+    for (unsigned Index = 0; Index < AssetCount; ++Index)
+    {
+        char FileName[600];
+        snprintf(FileName, sizeof(FileName), "%s/asset%03u.bin", Directory, Index);
+        FileNames.push_back(FileName);
+
+        Random = Random * 1664525u + 1013904223u;
+        std::vector<uint32_t> Words((16 * 1024 + (Random >> 8) % (240 * 1024)) / 4);
+        for (uint32_t& Word : Words)
+            Word = Random = Random * 1664525u + 1013904223u;
+        if (FILE* File = fopen(FileName, "wb"))
+        {
+            fwrite(Words.data(), 4, Words.size(), File);
+            fclose(File);
+        }
+    }
+
+    Jobs::Initialize(Jobs::GetDefaultWorkerCount());
+    const unsigned Iterations = std::max(std::min(Options.Iterations, 10u), 1u);
+
+    std::vector<uint64_t> Expected(AssetCount);
+    {
+        std::vector<double> FirstTimes, TotalTimes;
+        for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration)
+        {
+            const double Start = Lib::GetTime();
+            for (unsigned Index = 0; Index < AssetCount; ++Index)
+            {
+                const std::vector<uint8_t> Content = ReadFileCopy(FileNames[Index].c_str());
+                Expected[Index] = DecodeStreamedData(Content.data(), Content.size());
+                if (Index == 0)
+                    FirstTimes.push_back(Lib::GetTime() - Start);
+            }
+            TotalTimes.push_back(Lib::GetTime() - Start);
+        }
+        Report("assetstream.serial.first", FirstTimes);
+        Report("assetstream.serial.all", TotalTimes);
+    }
+
+    for (unsigned UseIoUring = 0; UseIoUring < 2; ++UseIoUring)
+    {
+        Load::Initialize(UseIoUring != 0);
+        const Load::TStats InitialStats = Load::GetStats();
+        if (UseIoUring && !InitialStats.IoUring)
+        {
+            printf("assetstream: io_uring is not available\n");
+            Load::Shutdown();
+            break;
+        }
+
+        std::vector<double> FirstTimes, TotalTimes;
+        unsigned Mismatches = 0;
+        for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration)
+        {
+            std::vector<TStreamedAsset> Assets(AssetCount);
+            const double Start = Lib::GetTime();
+            for (unsigned Index = 0; Index < AssetCount; ++Index)
+                Load::Request(FileNames[Index].c_str(), DecodeStreamedAsset, CompleteStreamedAsset, &Assets[Index]);
+            while (Load::GetPendingCount() > 0)
+            {
+                Load::Update();
+                std::this_thread::yield();
+            }
+            double First = 1e9;
+            for (unsigned Index = 0; Index < AssetCount; ++Index)
+            {
+                First = std::min(First, Assets[Index].CompleteTime - Start);
+                Mismatches += !Assets[Index].Completed || Assets[Index].Checksum != Expected[Index];
+            }
+            FirstTimes.push_back(First);
+            TotalTimes.push_back(Lib::GetTime() - Start);
+        }
+
+        const Load::TStats Stats = Load::GetStats();
+        Load::Shutdown();
+
+        const char* Name = UseIoUring ? "uring" : "threads";
+        char ReportName[64];
+        snprintf(ReportName, sizeof(ReportName), "assetstream.%s.first", Name);
+        Report(ReportName, FirstTimes);
+        snprintf(ReportName, sizeof(ReportName), "assetstream.%s.all", Name);
+        Report(ReportName, TotalTimes);
+        printf("    %llu reads in %llu batches, %.1f MB\n", (unsigned long long)Stats.RequestCount,
+               (unsigned long long)Stats.BatchCount, Stats.ByteCount / (1024.0 * 1024.0));
+        Check(Mismatches == 0, "a streamed asset failed or decoded differently");
+        Check(Stats.CompleteCount == Stats.RequestCount, "not every request completed");
+    }
+
+    {
+        // A missing file still completes, as failed.
+        Load::Initialize(true);
+        TStreamedAsset Missing = {};
+        Missing.Completed = true;
+        Load::Request("Data/does_not_exist.bin", DecodeStreamedAsset, CompleteStreamedAsset, &Missing);
+        Load::Flush();
+        Check(!Missing.Completed && Missing.CompleteTime > 0.0, "a missing file didn't complete as failed");
+        Load::Shutdown();
+    }
+    Jobs::Shutdown();
+
+    for (const std::string& FileName : FileNames)
+        remove(FileName.c_str());
+#if defined(_WIN32)
+    _rmdir(Directory);
+#else
+    rmdir(Directory);
+#endif
+}
+
+// Drops the file's pages from the OS cache, so that the next read goes to the disk. Linux only.
+static bool
+EvictFromCache(const char* FileName)
+{
+#if defined(__linux__)
+    const int File = open(FileName, O_RDONLY);
+    if (File < 0)
+        return false;
+    fdatasync(File);
+    const bool Evicted = posix_fadvise(File, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(File);
+    return Evicted;
+#else
+    return false;
+#endif
+}
+
+// Packs 300 generated assets (16..256 KB, half of them compressible) and the font, checks that every
+// entry comes back intact, then loads them all through Load from loose files and from the archive,
+// with cold (evicted) and warm OS caches.
+static void
+PackedArchive(const TOptions& Options)
+{
+    const unsigned AssetCount = 300;
+    const char* TempDirectory = getenv("TMPDIR");
+    char Directory[512], ArchiveName[600];
+    snprintf(Directory, sizeof(Directory), "%s/demo_bench_pak", TempDirectory ? TempDirectory : "/tmp");
+    snprintf(ArchiveName, sizeof(ArchiveName), "%s.pak", Directory);
+#if defined(_WIN32)
+    _mkdir(Directory);
+#else
+    mkdir(Directory, 0755);
+#endif
+
+    std::vector<std::string> FileNames;
+    uint32_t Random = 11;
+    for (unsigned Index = 0; Index < AssetCount; ++Index)
+    {
+        char FileName[700];
+        snprintf(FileName, sizeof(FileName), "%s/asset%03u.bin", Directory, Index);
+        FileNames.push_back(FileName);
+
+        Random = Random * 1664525u + 1013904223u;
+        std::vector<uint8_t> Bytes(16 * 1024 + (Random >> 8) % (240 * 1024));
+        for (size_t Byte = 0; Byte < Bytes.size(); ++Byte)
+        {
+            // Odd assets are text-like: a few symbols in runs, which LZ4 shrinks a lot.
+            if (Byte % 64 == 0)
+                Random = Random * 1664525u + 1013904223u;
+            Bytes[Byte] = Index & 1 ? (uint8_t)('a' + (Random >> (Byte % 64 / 8 * 3 + 8)) % 6)
+                                    : (uint8_t)((Random = Random * 1664525u + 1013904223u) >> 24);
+        }
+        if (FILE* File = fopen(FileName, "wb"))
+        {
+            fwrite(Bytes.data(), 1, Bytes.size(), File);
+            fclose(File);
+        }
+    }
+    FileNames.push_back("Data/Roboto-Medium.ttf");
+
+    std::vector<const char*> Names;
+    for (const std::string& FileName : FileNames)
+        Names.push_back(FileName.c_str());
+
+    double Time = Lib::GetTime();
+    const bool Built = Pak::Build(ArchiveName, Names.data(), (unsigned)Names.size(), true);
+    const double BuildTime = Lib::GetTime() - Time;
+    Check(Built, "building the archive failed");
+
+    char StoredName[700];
+    snprintf(StoredName, sizeof(StoredName), "%s.stored", ArchiveName);
+    Check(Pak::Build(StoredName, Names.data(), (unsigned)Names.size(), false), "building the stored archive failed");
+
+    // Every entry round-trips; lookups of other names fail.
+    std::vector<uint64_t> Expected(Names.size());
+    {
+        Pak::TArchive Archive;
+        const bool Opened = Pak::Open(ArchiveName, Archive);
+        Check(Opened, "the archive doesn't open");
+
+        uint64_t OriginalSize = 0, StoredSize = 0;
+        unsigned Compressed = 0, Mismatches = 0, Misaligned = 0;
+        std::vector<uint8_t> Content;
+        for (unsigned Index = 0; Opened && Index < Names.size(); ++Index)
+        {
+            const std::vector<uint8_t> File = ReadFileCopy(Names[Index]);
+            Expected[Index] = DecodeStreamedData(File.data(), File.size());
+
+            const Pak::TEntry* Entry = Pak::Find(Archive, Names[Index]);
+            if (!Entry)
+            {
+                Mismatches++;
+                continue;
+            }
+            Content.resize((size_t)Entry->OriginalSize);
+            Mismatches += !Pak::Decompress(Archive, *Entry, Content.data()) || Content != File;
+            Misaligned += (uintptr_t)Pak::GetBlob(Archive, *Entry) % Pak::KBlobAlignment != 0;
+            Compressed += (Entry->Flags & Pak::KEntryLz4) != 0;
+            OriginalSize += Entry->OriginalSize;
+            StoredSize += Entry->Size;
+        }
+        printf("archive: %u entries, %u compressed, %.1f MB -> %.1f MB, built in %.0f ms\n", Archive.EntryCount,
+               Compressed, OriginalSize / (1024.0 * 1024.0), StoredSize / (1024.0 * 1024.0), BuildTime * 1000.0);
+        Check(Mismatches == 0, "an archive entry differs from its file");
+        Check(Misaligned == 0, "an archive blob isn't 64-byte aligned");
+        Check(Compressed > 0 && Compressed < Names.size(), "expected only the compressible assets to be compressed");
+        Check(Opened && !Pak::Find(Archive, "Data/does_not_exist.bin"), "found an entry that isn't packed");
+        Pak::Close(Archive);
+
+        // Truncated archives are rejected.
+        const std::vector<uint8_t> Bytes = ReadFileCopy(ArchiveName);
+        char TruncatedName[700];
+        snprintf(TruncatedName, sizeof(TruncatedName), "%s.truncated", ArchiveName);
+        if (FILE* File = fopen(TruncatedName, "wb"))
+        {
+            fwrite(Bytes.data(), 1, Bytes.size() / 2, File);
+            fclose(File);
+        }
+        Check(!Pak::Open(TruncatedName, Archive), "a truncated archive opened");
+        remove(TruncatedName);
+    }
+
+    Jobs::Initialize(Jobs::GetDefaultWorkerCount());
+    const unsigned Iterations = std::max(std::min(Options.Iterations, 10u), 1u);
+    bool Evicted = true;
+    for (unsigned Pass = 0; Pass < 2; ++Pass)
+    {
+        const bool Cold = Pass == 0;
+        // loose files, the LZ4 archive, the archive without compression
+        for (unsigned UseArchive = 0; UseArchive < 3; ++UseArchive)
+        {
+            const char* Archive = UseArchive == 1 ? ArchiveName : StoredName;
+            std::vector<double> Times;
+            unsigned Mismatches = 0;
+            uint64_t ArchiveCount = 0;
+            for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration)
+            {
+                if (Cold)
+                {
+                    for (const char* Name : Names)
+                        Evicted = EvictFromCache(Name) && Evicted;
+                    Evicted = EvictFromCache(Archive) && Evicted;
+                }
+
+                std::vector<TStreamedAsset> Assets(Names.size());
+                Time = Lib::GetTime();
+                Load::Initialize(true);
+                if (UseArchive)
+                    Load::MountArchive(Archive);
+                for (unsigned Index = 0; Index < Names.size(); ++Index)
+                    Load::Request(Names[Index], DecodeStreamedAsset, CompleteStreamedAsset, &Assets[Index]);
+                Load::Flush();
+                Times.push_back(Lib::GetTime() - Time);
+                ArchiveCount += Load::GetStats().ArchiveCount;
+                Load::Shutdown();
+
+                for (unsigned Index = 0; Index < Names.size(); ++Index)
+                    Mismatches += !Assets[Index].Completed || Assets[Index].Checksum != Expected[Index];
+            }
+
+            char Name[64];
+            static const char* KSources[] = { "loose", "packed", "stored" };
+            snprintf(Name, sizeof(Name), "archive.%s.%s", Cold ? "cold" : "warm", KSources[UseArchive]);
+            Report(Name, Times);
+            Check(Mismatches == 0, "an asset failed to load or decoded differently");
+            Check(UseArchive ? ArchiveCount == Iterations * Names.size() : ArchiveCount == 0,
+                  "assets weren't served from where expected");
+        }
+    }
+    if (!Evicted)
+        printf("    the OS cache couldn't be dropped, cold numbers are warm\n");
+    Jobs::Shutdown();
+
+    for (unsigned Index = 0; Index < AssetCount; ++Index)
+        remove(FileNames[Index].c_str());
+    remove(ArchiveName);
+    remove(StoredName);
+#if defined(_WIN32)
+    _rmdir(Directory);
+#else
+    rmdir(Directory);
+#endif
+}
+
+// Deletes the files in a directory (not in its subdirectories).
+static void
+RemoveFiles(const char* Directory)
+{
+#if defined(_WIN32)
+    WIN32_FIND_DATAA Found;
+    HANDLE Find = FindFirstFileA((std::string(Directory) + "/*").c_str(), &Found);
+    if (Find == INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        if (!(Found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            remove((std::string(Directory) + "/" + Found.cFileName).c_str());
+    } while (FindNextFileA(Find, &Found));
+    FindClose(Find);
+#else
+    DIR* Dir = opendir(Directory);
+    if (!Dir)
+        return;
+    while (const dirent* Entry = readdir(Dir))
+    {
+        if (Entry->d_type == DT_REG)
+            remove((std::string(Directory) + "/" + Entry->d_name).c_str());
+    }
+    closedir(Dir);
+#endif
+}
+
+// True when both fonts have the same glyphs, lookup tables and metrics.
+static bool
+IsSameFont(const ImFont* A, const ImFont* B)
+{
+    if (A->Glyphs.Size != B->Glyphs.Size)
+        return false;
+    // Field by field: ImFontGlyph has padding after Codepoint.
+    for (int Index = 0; Index < A->Glyphs.Size; ++Index)
+    {
+        const ImFontGlyph& GlyphA = A->Glyphs[Index];
+        const ImFontGlyph& GlyphB = B->Glyphs[Index];
+        if (GlyphA.Codepoint != GlyphB.Codepoint || GlyphA.AdvanceX != GlyphB.AdvanceX ||
+            memcmp(&GlyphA.X0, &GlyphB.X0, 8 * sizeof(float)) != 0)
+            return false;
+    }
+
+    const char* Text = "The quick brown fox jumps over the lazy dog\t0123456789 \xc3\xa9\xe2\x82\xac";
+    const ImVec2 SizeA = A->CalcTextSizeA(A->FontSize, FLT_MAX, 200.0f, Text);
+    const ImVec2 SizeB = B->CalcTextSizeA(B->FontSize, FLT_MAX, 200.0f, Text);
+    return A->FontSize == B->FontSize && A->Ascent == B->Ascent && A->Descent == B->Descent &&
+           A->IndexLookup.Size == B->IndexLookup.Size &&
+           memcmp(A->IndexLookup.Data, B->IndexLookup.Data, A->IndexLookup.Size * sizeof(unsigned short)) == 0 &&
+           memcmp(A->IndexAdvanceX.Data, B->IndexAdvanceX.Data, A->IndexAdvanceX.Size * sizeof(float)) == 0 &&
+           A->FallbackGlyph && A->FallbackGlyph - A->Glyphs.Data == B->FallbackGlyph - B->Glyphs.Data &&
+           SizeA.x == SizeB.x && SizeA.y == SizeB.y;
+}
+
+// True when both atlases hold the same pixels and fonts.
+static bool
+IsSameFontAtlas(ImFontAtlas* A, ImFontAtlas* B)
+{
+    if (A->Fonts.Size == 0 || A->Fonts.Size != B->Fonts.Size || !A->TexPixelsAlpha8 || !B->TexPixelsAlpha8 ||
+        A->TexWidth != B->TexWidth || A->TexHeight != B->TexHeight ||
+        memcmp(A->TexPixelsAlpha8, B->TexPixelsAlpha8, (size_t)A->TexWidth * A->TexHeight) != 0 ||
+        memcmp(&A->TexUvWhitePixel, &B->TexUvWhitePixel, sizeof(ImVec2)) != 0 ||
+        A->CustomRects.Size != B->CustomRects.Size || A->CustomRectIds[0] != B->CustomRectIds[0])
+        return false;
+
+    for (int Index = 0; Index < A->CustomRects.Size; ++Index)
+    {
+        const ImFontAtlas::CustomRect& RectA = A->CustomRects[Index];
+        const ImFontAtlas::CustomRect& RectB = B->CustomRects[Index];
+        if (RectA.ID != RectB.ID || RectA.X != RectB.X || RectA.Y != RectB.Y || !RectA.Font != !RectB.Font)
+            return false;
+    }
+    for (int Index = 0; Index < A->Fonts.Size; ++Index)
+    {
+        if (!IsSameFont(A->Fonts[Index], B->Fonts[Index]))
+            return false;
+    }
+    return true;
+}
+
+// Font startup work (Gui::BuildFontAtlas, whose Alpha8 pixels Gui::Initialize uploads) at several sizes,
+// with an empty atlas cache and with a warm one. A cached atlas must match a rasterized one exactly, and a
+// damaged cache file must be rebuilt rather than used.
+static void
+FontAtlasCache(const TOptions& Options)
+{
+    const char* TempDirectory = getenv("TMPDIR");
+    char Directory[512];
+    snprintf(Directory, sizeof(Directory), "%s/demo_bench_fonts", TempDirectory ? TempDirectory : "/tmp");
+    Lib::MakeDirectory(Directory);
+    RemoveFiles(Directory);
+
+    const std::vector<uint8_t> Ttf = ReadFileCopy("Data/Roboto-Medium.ttf");
+    Check(!Ttf.empty(), "can't read Data/Roboto-Medium.ttf");
+    if (Ttf.empty())
+        return;
+
+    const unsigned Iterations = std::max(std::min(Options.Iterations, 20u), 1u);
+    static const float KSizes[] = { 13.0f, 18.0f, 24.0f, 32.0f, 48.0f };
+    for (float Size : KSizes)
+    {
+        ImFontConfig Config;
+        Config.SizePixels = Size;
+
+        std::vector<double> ColdTimes, WarmTimes;
+        unsigned Misses = 0, Hits = 0;
+        for (unsigned Pass = 0; Pass < 2; ++Pass)
+        {
+            const bool Cold = Pass == 0;
+            for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration)
+            {
+                if (Cold)
+                    RemoveFiles(Directory);
+
+                ImFontAtlas Atlas;
+                const double Time = Lib::GetTime();
+                const bool Hit = Gui::BuildFontAtlas(&Atlas, Ttf.data(), Ttf.size(), Config, Directory);
+                (Cold ? ColdTimes : WarmTimes).push_back(Lib::GetTime() - Time);
+                Misses += Cold && Hit;
+                Hits += !Cold && Hit;
+            }
+        }
+
+        char Name[64];
+        snprintf(Name, sizeof(Name), "fontcache.%.0fpx.cold", Size);
+        Report(Name, ColdTimes);
+        snprintf(Name, sizeof(Name), "fontcache.%.0fpx.warm", Size);
+        Report(Name, WarmTimes);
+        Check(Misses == 0, "an empty cache was hit");
+        Check(Hits == Iterations, "a warm cache missed");
+
+        // The cached atlas is the one stb_truetype builds.
+        ImFontAtlas Built, Cached;
+        RemoveFiles(Directory);
+        const bool BuiltHit = Gui::BuildFontAtlas(&Built, Ttf.data(), Ttf.size(), Config, Directory);
+        const bool CachedHit = Gui::BuildFontAtlas(&Cached, Ttf.data(), Ttf.size(), Config, Directory);
+        Check(!BuiltHit && CachedHit && IsSameFontAtlas(&Built, &Cached), "the cached atlas differs from a built one");
+    }
+
+    {
+        // A different size gets its own file; a truncated file is rebuilt.
+        ImFontConfig Config;
+        Config.SizePixels = 18.0f;
+        RemoveFiles(Directory);
+        ImFontAtlas First;
+        Gui::BuildFontAtlas(&First, Ttf.data(), Ttf.size(), Config, Directory);
+
+        std::string CacheFile;
+#if !defined(_WIN32)
+        if (DIR* Dir = opendir(Directory))
+        {
+            while (const dirent* Entry = readdir(Dir))
+            {
+                if (Entry->d_type == DT_REG)
+                    CacheFile = std::string(Directory) + "/" + Entry->d_name;
+            }
+            closedir(Dir);
+        }
+#endif
+        const std::vector<uint8_t> Bytes = ReadFileCopy(CacheFile.c_str());
+        printf("fontcache: 18px cache file %.1f KB (atlas %dx%d)\n", Bytes.size() / 1024.0, First.TexWidth,
+               First.TexHeight);
+        if (FILE* File = fopen(CacheFile.c_str(), "wb"))
+        {
+            fwrite(Bytes.data(), 1, Bytes.size() - 1, File);
+            fclose(File);
+        }
+        ImFontAtlas Truncated, Rebuilt;
+        const bool TruncatedHit = Gui::BuildFontAtlas(&Truncated, Ttf.data(), Ttf.size(), Config, Directory);
+        const bool RebuiltHit = Gui::BuildFontAtlas(&Rebuilt, Ttf.data(), Ttf.size(), Config, Directory);
+        Check(!CacheFile.empty() && !TruncatedHit && RebuiltHit, "a truncated cache file was used or not rewritten");
+        Check(IsSameFontAtlas(&First, &Truncated) && IsSameFontAtlas(&First, &Rebuilt),
+              "an atlas rebuilt over a damaged cache differs");
+
+        Config.SizePixels = 19.0f;
+        ImFontAtlas Other;
+        Check(!Gui::BuildFontAtlas(&Other, Ttf.data(), Ttf.size(), Config, Directory),
+              "a 19px font hit the 18px cache");
+    }
+
+    RemoveFiles(Directory);
+#if defined(_WIN32)
+    _rmdir(Directory);
+#else
+    rmdir(Directory);
+#endif
+}
+
+// Adds the font at 13, 18, 24 and 32 px with Latin, IPA, Greek, Cyrillic, punctuation, symbol and box drawing
+// ranges (about 5000 codepoints each, 1400 of them in the font); the 24 px one is brightened.
+static void
+AddLargeFontRanges(ImFontAtlas* Atlas, const std::vector<uint8_t>& Ttf)
+{
+    static const ImWchar KRanges[] =
+    {
+        0x0020, 0x052f, // Latin, Latin Extended-A/B, IPA, Greek, Cyrillic
+        0x1d00, 0x1fff, // Phonetic extensions, Latin Extended Additional, Greek Extended
+        0x2000, 0x22ff, // Punctuation, super/subscripts, currency, letterlike symbols, arrows, math operators
+        0x2500, 0x25ff, // Box drawing, block elements, geometric shapes
+        0,
+    };
+    static const float KSizes[] = { 13.0f, 18.0f, 24.0f, 32.0f };
+    for (float Size : KSizes)
+    {
+        ImFontConfig Config;
+        Config.FontDataOwnedByAtlas = false;
+        Config.RasterizerMultiply = Size == 24.0f ? 1.2f : 1.0f;
+        Atlas->AddFontFromMemoryTTF((void*)Ttf.data(), (int)Ttf.size(), Size, &Config, KRanges);
+    }
+}
+
+// ImFontAtlas::Build() with glyph rasterization spread over the job system (Gui::ParallelForFontAtlas),
+// against the serial build, which must produce the same bytes.
+static void
+FontAtlasBuild(const TOptions& Options)
+{
+    const std::vector<uint8_t> Ttf = ReadFileCopy("Data/Roboto-Medium.ttf");
+    Check(!Ttf.empty(), "can't read Data/Roboto-Medium.ttf");
+    if (Ttf.empty())
+        return;
+
+    ImFontAtlas Serial;
+    AddLargeFontRanges(&Serial, Ttf);
+    const bool Built = Serial.Build();
+    Check(Built, "the serial atlas build failed");
+    if (!Built)
+        return;
+
+    unsigned GlyphCount = 0;
+    for (const ImFont* Font : Serial.Fonts)
+        GlyphCount += (unsigned)Font->Glyphs.Size;
+    printf("fontbuild: %u fonts, %u glyphs, atlas %dx%d\n", (unsigned)Serial.Fonts.Size, GlyphCount, Serial.TexWidth,
+           Serial.TexHeight);
+
+    const unsigned Iterations = std::max(std::min(Options.Iterations, 10u), 1u);
+    {
+        std::vector<double> Times;
+        for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration)
+        {
+            ImFontAtlas Atlas;
+            AddLargeFontRanges(&Atlas, Ttf);
+            const double Time = Lib::GetTime();
+            Atlas.Build();
+            Times.push_back(Lib::GetTime() - Time);
+        }
+        Report("fontbuild.serial", Times);
+    }
+
+    for (unsigned WorkerCount : GetWorkerCounts())
+    {
+        Jobs::Initialize(WorkerCount);
+        std::vector<double> Times;
+        unsigned Mismatches = 0;
+        for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration)
+        {
+            ImFontAtlas Atlas;
+            AddLargeFontRanges(&Atlas, Ttf);
+            Atlas.ParallelFor = Gui::ParallelForFontAtlas;
+            const double Time = Lib::GetTime();
+            Atlas.Build();
+            Times.push_back(Lib::GetTime() - Time);
+            Mismatches += !IsSameFontAtlas(&Serial, &Atlas);
+        }
+        Jobs::Shutdown();
+
+        char Name[64];
+        snprintf(Name, sizeof(Name), "fontbuild.workers%u", WorkerCount);
+        Report(Name, Times);
+        Check(Mismatches == 0, "a parallel atlas build differs from the serial one");
+    }
+}
+
+// Copies Height rows of RowSize bytes to a buffer laid out like a texture upload (rows at 256-byte
+// aligned pitches), as UpdateSubresources() does. Returns the buffer size.
+static size_t
+CopyTextureUpload(const uint8_t* Pixels, unsigned RowSize, unsigned Height, std::vector<uint8_t>& Buffer)
+{
+    const size_t RowPitch = (RowSize + 255) & ~(size_t)255;
+    Buffer.resize(RowPitch * Height);
+    for (unsigned Row = 0; Row < Height; ++Row)
+        Lib::StreamCopy(Buffer.data() + Row * RowPitch, Pixels + (size_t)Row * RowSize, RowSize);
+    return Buffer.size();
+}
+
+// Font texture preparation the way Gui::Initialize did it (RGBA32 expansion, then the upload copy) and
+// the way it does now (the Alpha8 pixels as an R8 texture), for the demo's 18 px atlas and the large
+// one from fontbuild. Also checks that the RGBA32 expansion is (1, 1, 1, coverage), which is what the
+// R8 texture's view returns.
+static void
+FontTextureUpload(const TOptions& Options)
+{
+    const std::vector<uint8_t> Ttf = ReadFileCopy("Data/Roboto-Medium.ttf");
+    Check(!Ttf.empty(), "can't read Data/Roboto-Medium.ttf");
+    if (Ttf.empty())
+        return;
+
+    const unsigned Iterations = std::max(std::min(Options.Iterations, 50u), 1u);
+    for (unsigned Large = 0; Large < 2; ++Large)
+    {
+        std::vector<double> Rgba32Times, Alpha8Times;
+        size_t Rgba32Size = 0, Alpha8Size = 0;
+        unsigned Mismatches = 0;
+        std::vector<uint8_t> Buffer;
+        for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration)
+        {
+            ImFontAtlas Atlas;
+            if (Large)
+            {
+                AddLargeFontRanges(&Atlas, Ttf);
+            }
+            else
+            {
+                ImFontConfig Config;
+                Config.FontDataOwnedByAtlas = false;
+                Atlas.AddFontFromMemoryTTF((void*)Ttf.data(), (int)Ttf.size(), 18.0f, &Config);
+            }
+            uint8_t* Alpha8;
+            int Width, Height;
+            Atlas.GetTexDataAsAlpha8(&Alpha8, &Width, &Height);
+
+            double Time = Lib::GetTime();
+            Alpha8Size = CopyTextureUpload(Alpha8, (unsigned)Width, (unsigned)Height, Buffer);
+            Alpha8Times.push_back(Lib::GetTime() - Time);
+
+            uint8_t* Rgba32;
+            Time = Lib::GetTime();
+            Atlas.GetTexDataAsRGBA32(&Rgba32, &Width, &Height);
+            Rgba32Size = CopyTextureUpload(Rgba32, (unsigned)Width * 4, (unsigned)Height, Buffer);
+            Rgba32Times.push_back(Lib::GetTime() - Time);
+
+            const uint32_t* Texels = (const uint32_t*)Rgba32;
+            for (size_t Index = 0; Index < (size_t)Width * Height; ++Index)
+                Mismatches += Texels[Index] != (0x00ffffffu | (uint32_t)Alpha8[Index] << 24);
+        }
+
+        const char* Atlas = Large ? "large" : "18px";
+        printf("fonttexture.%s: rgba32 %.1f KB, alpha8 %.1f KB uploaded\n", Atlas, Rgba32Size / 1024.0,
+               Alpha8Size / 1024.0);
+        char Name[64];
+        snprintf(Name, sizeof(Name), "fonttexture.%s.rgba32", Atlas);
+        Report(Name, Rgba32Times);
+        snprintf(Name, sizeof(Name), "fonttexture.%s.alpha8", Atlas);
+        Report(Name, Alpha8Times);
+        Check(Mismatches == 0, "the RGBA32 atlas isn't white with the coverage in alpha");
+        Check(Alpha8Size * 4 <= Rgba32Size, "the Alpha8 upload isn't a quarter of the RGBA32 one");
+    }
+}
+
+// Stone ramps across the canvas and a heap of sand and water blobs over its upper half, painted from
+// a fixed seed.
+static void
+PaintSandScene(Sand::TCanvas& Canvas)
+{
+    const float Width = (float)Canvas.Width;
+    const float Height = (float)Canvas.Height;
+    for (unsigned Ramp = 0; Ramp < 4; ++Ramp)
+    {
+        const float Y = Height * (0.45f + 0.12f * Ramp);
+        const float X = (Ramp & 1) ? Width * 0.3f : Width * 0.05f;
+        Sand::Paint(Canvas, X, Y, X + Width * 0.6f, Y + Height * 0.05f * ((Ramp & 1) ? -1.0f : 1.0f), 3.0f,
+                    Sand::KStone);
+    }
+
+    uint32_t Random = 0x2545f491;
+    for (unsigned Blob = 0; Blob < 4000; ++Blob)
+    {
+        Random = Random * 1664525 + 1013904223;
+        const float X = Width * ((Random >> 8) & 0xffff) / 65535.0f;
+        Random = Random * 1664525 + 1013904223;
+        const float Y = Height * 0.4f * ((Random >> 8) & 0xffff) / 65535.0f;
+        Sand::Paint(Canvas, X, Y, X, Y, 6.0f, (Random >> 30) ? Sand::KSand : Sand::KWater);
+    }
+}
+
+// Steps a 1920x1080 canvas (the demo's) while the heap collapses and settles, and reports the cells
+// updated per millisecond and the chunks awake. A second canvas with every chunk woken before each step
+// must stay identical, and no cells may appear or disappear. Also checks the gather path of the CPU
+// colour conversion against golden images from the scalar one, and times both.
+static void
+SandSimulation(const TOptions& Options)
+{
+    const unsigned Width = 1920, Height = 1080;
+    const unsigned StepCount = 600;
+
+    Sand::TCanvas Canvas, Replica;
+    Sand::CreateCanvas(Canvas, Width, Height);
+    Sand::CreateCanvas(Replica, Width, Height);
+    PaintSandScene(Canvas);
+    PaintSandScene(Replica);
+
+    uint64_t Counts[Sand::KMaterialCount], FinalCounts[Sand::KMaterialCount];
+    Sand::CountMaterials(Canvas, Counts);
+
+    std::vector<double> Early, Late;
+    uint64_t MoveCount = 0, ActiveChunkCounts[2] = {};
+    unsigned Mismatches = 0;
+    for (unsigned Index = 0; Index < StepCount; ++Index)
+    {
+        const double Time = Lib::GetTime();
+        Sand::Step(Canvas);
+        (Index < StepCount / 2 ? Early : Late).push_back(Lib::GetTime() - Time);
+        MoveCount += Sand::GetMoveCount(Canvas);
+        ActiveChunkCounts[Index >= StepCount / 2] += Sand::GetActiveChunkCount(Canvas);
+
+        Sand::WakeChunks(Replica, { 0, 0, (int)Width, (int)Height });
+        Sand::Step(Replica);
+        Mismatches += Sand::GetHash(Canvas) != Sand::GetHash(Replica);
+    }
+    Sand::CountMaterials(Canvas, FinalCounts);
+
+    double Total = 0.0;
+    for (double Time : Early)
+        Total += Time;
+    for (double Time : Late)
+        Total += Time;
+    printf("sand: %ux%u, %u steps, %.0f cells moved per step, %.2f M cell updates per ms\n", Width, Height,
+           StepCount, (double)MoveCount / StepCount, (double)Width * Height * StepCount / (Total * 1000.0) / 1e6);
+    Report("sand.step.falling", Early);
+    Report("sand.step.settling", Late);
+    printf("    active chunks per step of %u: falling %.0f, settling %.0f\n", (unsigned)Canvas.Chunks.size(),
+           (double)ActiveChunkCounts[0] / Early.size(), (double)ActiveChunkCounts[1] / Late.size());
+    Check(Mismatches == 0, "skipping sleeping chunks changed the result");
+    Check(memcmp(Counts, FinalCounts, sizeof(Counts)) == 0, "the number of cells of a material changed");
+
+    // Golden images of the settled canvas from the scalar converter (the reference of the DisplayCanvas
+    // pass) at a few shimmer frames, whole and in an unaligned rectangle. The gather path must match them.
+    const unsigned RectX = 7, RectY = 3, RectWidth = 333, RectHeight = 217;
+    const uint32_t ShimmerFrames[] = { 0, 1, 13, 1000003 };
+    std::vector<uint8_t> Golden((size_t)Width * Height * 4), Pixels((size_t)Width * Height * 4);
+    const bool HasGather = Sand::IsKernelSupported(Sand::KKernelAvx2);
+    unsigned GatherMismatches = 0;
+    for (uint32_t Frame : ShimmerFrames)
+    {
+        Sand::ConvertToRgba(Canvas, 0, 0, Width, Height, Golden.data(), Width * 4, Frame, Sand::KKernelScalar);
+        printf("    golden image, shimmer frame %u: %016llx\n", Frame,
+               (unsigned long long)ChecksumAsset(Golden.data(), Golden.size()));
+        if (HasGather)
+        {
+            Sand::ConvertToRgba(Canvas, 0, 0, Width, Height, Pixels.data(), Width * 4, Frame, Sand::KKernelAvx2);
+            GatherMismatches += memcmp(Golden.data(), Pixels.data(), Golden.size()) != 0;
+
+            Sand::ConvertToRgba(Canvas, RectX, RectY, RectWidth, RectHeight, Golden.data(), Width * 4, Frame,
+                                Sand::KKernelScalar);
+            Sand::ConvertToRgba(Canvas, RectX, RectY, RectWidth, RectHeight, Pixels.data(), Width * 4, Frame,
+                                Sand::KKernelAvx2);
+            for (unsigned Row = 0; Row < RectHeight; ++Row)
+            {
+                GatherMismatches += memcmp(&Golden[(size_t)Row * Width * 4], &Pixels[(size_t)Row * Width * 4],
+                                           RectWidth * 4) != 0;
+            }
+        }
+    }
+    Check(GatherMismatches == 0, "the gather conversion differs from the golden image");
+
+    for (Sand::EKernel Kernel : { Sand::KKernelScalar, Sand::KKernelAvx2 })
+    {
+        if (!Sand::IsKernelSupported(Kernel))
+            continue;
+        std::vector<double> Convert;
+        for (unsigned Iteration = 0; Iteration < std::max(std::min(Options.Iterations, 50u), 1u); ++Iteration)
+        {
+            const double Time = Lib::GetTime();
+            Sand::ConvertToRgba(Canvas, 0, 0, Width, Height, Pixels.data(), Width * 4, Iteration, Kernel);
+            Convert.push_back(Lib::GetTime() - Time);
+        }
+        Report(Kernel == Sand::KKernelScalar ? "sand.convert.scalar" : "sand.convert.gather", Convert);
+    }
+}
+
+// Sand::Step() with the chunk phases spread over 1 - 32 threads (the caller and its workers). Every
+// thread count must give the canvas of the serial update after every step.
+static void
+SandThreads(const TOptions& Options)
+{
+    const unsigned Width = 1920, Height = 1080;
+    const unsigned StepCount = std::max(std::min(Options.FrameCount, 240u), 1u);
+
+    std::vector<uint64_t> Hashes;
+    std::vector<double> SerialTimes;
+    {
+        Sand::TCanvas Canvas;
+        Sand::CreateCanvas(Canvas, Width, Height);
+        PaintSandScene(Canvas);
+        for (unsigned Index = 0; Index < StepCount; ++Index)
+        {
+            const double Time = Lib::GetTime();
+            Sand::Step(Canvas);
+            SerialTimes.push_back(Lib::GetTime() - Time);
+            Hashes.push_back(Sand::GetHash(Canvas));
+        }
+    }
+    Report("sandthreads.serial", SerialTimes);
+
+    double SerialTotal = 0.0;
+    for (double Time : SerialTimes)
+        SerialTotal += Time;
+    printf("sandthreads: %ux%u, %u steps, %u hardware threads\n", Width, Height, StepCount,
+           Jobs::GetDefaultWorkerCount() + 1);
+
+    for (unsigned ThreadCount = 1; ThreadCount <= 32; ThreadCount *= 2)
+    {
+        Jobs::Initialize(ThreadCount - 1);
+
+        Sand::TCanvas Canvas;
+        Sand::CreateCanvas(Canvas, Width, Height);
+        PaintSandScene(Canvas);
+
+        std::vector<double> Times;
+        unsigned Mismatches = 0;
+        for (unsigned Index = 0; Index < StepCount; ++Index)
+        {
+            const double Time = Lib::GetTime();
+            Sand::Step(Canvas);
+            Times.push_back(Lib::GetTime() - Time);
+            Mismatches += Sand::GetHash(Canvas) != Hashes[Index];
+        }
+        Jobs::Shutdown();
+
+        double Total = 0.0;
+        for (double Time : Times)
+            Total += Time;
+        char Name[64];
+        snprintf(Name, sizeof(Name), "sandthreads.threads%u", ThreadCount);
+        Report(Name, Times);
+        printf("%s: %.2fx the serial update\n", Name, SerialTotal / Total);
+        Check(Mismatches == 0, "a threaded sand update differs from the serial one");
+    }
+}
+
+// Sand::Step() with each row kernel the CPU supports, serially. Every kernel must give the canvas of
+// the scalar one after every step.
+static void
+SandKernels(const TOptions& Options)
+{
+    const unsigned Width = 1920, Height = 1080;
+    const unsigned StepCount = std::max(std::min(Options.FrameCount, 300u), 1u);
+
+    printf("sandkernels: %ux%u, %u steps, best kernel %s\n", Width, Height, StepCount,
+           Sand::GetKernelName(Sand::GetBestKernel()));
+
+    std::vector<uint64_t> Hashes;
+    double ScalarTotal = 0.0;
+    for (unsigned Kernel = Sand::KKernelScalar; Kernel < Sand::KKernelCount; ++Kernel)
+    {
+        if (!Sand::IsKernelSupported((Sand::EKernel)Kernel))
+            continue;
+
+        Sand::TCanvas Canvas;
+        Sand::CreateCanvas(Canvas, Width, Height);
+        Canvas.Kernel = (Sand::EKernel)Kernel;
+        PaintSandScene(Canvas);
+
+        std::vector<double> Times;
+        double Total = 0.0;
+        unsigned Mismatches = 0;
+        for (unsigned Index = 0; Index < StepCount; ++Index)
+        {
+            const double Time = Lib::GetTime();
+            Sand::Step(Canvas);
+            Times.push_back(Lib::GetTime() - Time);
+            Total += Times.back();
+
+            if (Kernel == Sand::KKernelScalar)
+                Hashes.push_back(Sand::GetHash(Canvas));
+            else
+                Mismatches += Sand::GetHash(Canvas) != Hashes[Index];
+        }
+        if (Kernel == Sand::KKernelScalar)
+            ScalarTotal = Total;
+
+        char Name[64];
+        snprintf(Name, sizeof(Name), "sandkernels.%s", Sand::GetKernelName((Sand::EKernel)Kernel));
+        Report(Name, Times);
+        printf("%s: %.2fx the scalar kernel\n", Name, ScalarTotal / Total);
+        Check(Mismatches == 0, "a SIMD sand kernel differs from the scalar one");
+    }
+}
+
+static const TBenchmark GBenchmarks[] =
+{
+    { "frame", FrameLoop },
+    { "submission", Submission },
+    { "merge", DrawMerging },
+    { "upload", UploadRing },
+    { "bindless", BindlessTextures },
+    { "descriptors", DescriptorChurn },
+    { "latency", FrameLatency },
+    { "profiler", Profiler },
+    { "guigrowth", GuiGrowth },
+    { "vertexcopy", VertexCopy },
+    { "jobs", JobSystem },
+    { "recording", CommandRecording },
+    { "assetload", AssetLoading },
+    { "assetstream", AssetStreaming },
+    { "archive", PackedArchive },
+    { "fontcache", FontAtlasCache },
+    { "fontbuild", FontAtlasBuild },
+    { "fonttexture", FontTextureUpload },
+    { "sand", SandSimulation },
+    { "sandthreads", SandThreads },
+    { "sandkernels", SandKernels },
+};
+
+} // namespace Bench
+
+int
+main(int Argc, char** Argv)
+{
+    Bench::TOptions Options = {};
+    Options.FrameCount = 600;
+    Options.Iterations = 100;
+    Options.FrameSettings.FramesInFlight = 2;
+    Options.FrameSettings.LowLatency = false;
+    const char* Filter = nullptr;
+
+    for (int Index = 1; Index < Argc; ++Index)
+    {
+        if (strcmp(Argv[Index], "--frames") == 0 && Index + 1 < Argc)
+            Options.FrameCount = (unsigned)atoi(Argv[++Index]);
+        else if (strcmp(Argv[Index], "--iterations") == 0 && Index + 1 < Argc)
+            Options.Iterations = (unsigned)atoi(Argv[++Index]);
+        else if (strcmp(Argv[Index], "--frames-in-flight") == 0 && Index + 1 < Argc)
+            Options.FrameSettings.FramesInFlight = std::min(std::max(atoi(Argv[++Index]), 1), (int)Dx::KMaxFramesInFlight);
+        else if (strcmp(Argv[Index], "--low-latency") == 0)
+            Options.FrameSettings.LowLatency = true;
+        else if (strcmp(Argv[Index], "--list") == 0)
+        {
+            for (const Bench::TBenchmark& Benchmark : Bench::GBenchmarks)
+                printf("%s\n", Benchmark.Name);
+            return 0;
+        }
+        else
+            Filter = Argv[Index];
+    }
+
+    // Assets are loaded relative to the repository root.
+#if defined(DEMO_SOURCE_DIR)
+    if (FILE* File = fopen("Data/Roboto-Medium.ttf", "rb"))
+        fclose(File);
+    else if (chdir(DEMO_SOURCE_DIR) != 0)
+        fprintf(stderr, "Can't change directory to %s\n", DEMO_SOURCE_DIR);
+#endif
+
+    for (const Bench::TBenchmark& Benchmark : Bench::GBenchmarks)
+    {
+        if (Filter && !strstr(Benchmark.Name, Filter))
+            continue;
+        Benchmark.Run(Options);
+    }
+    return Bench::GFailed ? 1 : 0;
+}
+// vim: set ts=4 sw=4 expandtab:
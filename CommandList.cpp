@@ -0,0 +1,536 @@
+namespace Cmd
+{
+namespace Priv
+{
+
+struct TResourceBarrier
+{
+    ID3D12Resource* Resource;
+    D3D12_RESOURCE_STATES StateBefore;
+    D3D12_RESOURCE_STATES StateAfter;
+};
+
+struct TOMSetRenderTargets
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE RenderTarget;
+    D3D12_CPU_DESCRIPTOR_HANDLE DepthStencil;
+    bool HasDepthStencil;
+};
+
+struct TClearRenderTargetView
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE RenderTarget;
+    float Color[4];
+};
+
+struct TClearDepthStencilView
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE DepthStencil;
+    float Depth;
+};
+
+struct TSetRootConstantBufferView
+{
+    unsigned RootIndex;
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+};
+
+struct TSetRootDescriptorTable
+{
+    unsigned RootIndex;
+    D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor;
+};
+
+struct TSetRoot32BitConstant
+{
+    unsigned RootIndex;
+    uint32_t Value;
+    unsigned DestOffset;
+};
+
+struct TIASetVertexBuffers
+{
+    unsigned Slot;
+    D3D12_VERTEX_BUFFER_VIEW View;
+};
+
+struct TDrawInstanced
+{
+    unsigned VertexCountPerInstance;
+    unsigned InstanceCount;
+    unsigned StartVertexLocation;
+    unsigned StartInstanceLocation;
+};
+
+struct TDrawIndexedInstanced
+{
+    unsigned IndexCountPerInstance;
+    unsigned InstanceCount;
+    unsigned StartIndexLocation;
+    int BaseVertexLocation;
+    unsigned StartInstanceLocation;
+};
+
+struct TCopyTextureRegion
+{
+    ID3D12Resource* Destination;
+    unsigned DestinationX;
+    unsigned DestinationY;
+    ID3D12Resource* Source;
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT Footprint;
+};
+
+// Stream layout: one ECommand byte followed by the unaligned payload of that command.
+template<typename T> static inline void
+Record(TCommandList& List, ECommand Command, const T& Payload)
+{
+    const size_t Offset = List.Stream.size();
+    List.Stream.resize(Offset + 1 + sizeof(T));
+    List.Stream[Offset] = (uint8_t)Command;
+    memcpy(&List.Stream[Offset + 1], &Payload, sizeof(T));
+}
+
+static inline void
+Record(TCommandList& List, ECommand Command)
+{
+    List.Stream.push_back((uint8_t)Command);
+}
+
+// Returns true (and counts the call as filtered) when Value is already bound on the list.
+template<typename T> static inline bool
+IsRedundant(TCommandList& List, ECommand Command, T& Cached, const T& Value)
+{
+    if (!List.FilterRedundantState)
+        return false;
+
+    const uint32_t Bit = 1u << Command;
+    if ((List.Cache.ValidMask & Bit) && memcmp(&Cached, &Value, sizeof(T)) == 0)
+    {
+        List.FilteredCounts[Command]++;
+        return true;
+    }
+    Cached = Value;
+    List.Cache.ValidMask |= Bit;
+    return false;
+}
+
+static inline bool
+IsRedundantRootArgument(TCommandList& List, ECommand Command, unsigned RootIndex, uint64_t Value)
+{
+    if (!List.FilterRedundantState || RootIndex >= KMaxRootParameters)
+        return false;
+
+    const uint32_t Bit = 1u << RootIndex;
+    if ((List.Cache.RootValidMask & Bit) && List.Cache.RootArguments[RootIndex] == Value)
+    {
+        List.FilteredCounts[Command]++;
+        return true;
+    }
+    List.Cache.RootArguments[RootIndex] = Value;
+    List.Cache.RootValidMask |= Bit;
+    return false;
+}
+
+template<typename T> static inline T
+Read(const uint8_t*& Cursor)
+{
+    T Payload;
+    memcpy(&Payload, Cursor, sizeof(T));
+    Cursor += sizeof(T);
+    return Payload;
+}
+
+} // namespace Priv
+
+#if !defined(DEMO_HEADLESS)
+#define CMD_FORWARD(List, Call) if ((List).Native) { (List).Native->Call; return; }
+#else
+#define CMD_FORWARD(List, Call)
+#endif
+
+static void
+Reset(TCommandList& List)
+{
+    List.Stream.clear();
+    memset(List.Counts, 0, sizeof(List.Counts));
+    memset(List.FilteredCounts, 0, sizeof(List.FilteredCounts));
+    memset(&List.Cache, 0, sizeof(List.Cache));
+}
+
+static unsigned
+GetCallCount(const TCommandList& List)
+{
+    unsigned Count = 0;
+    for (unsigned Index = 0; Index < KCmdCount; ++Index)
+        Count += List.Counts[Index];
+    return Count;
+}
+
+static unsigned
+GetStateChangeCount(const TCommandList& List)
+{
+    return GetCallCount(List) - List.Counts[KCmdDrawInstanced] - List.Counts[KCmdDrawIndexedInstanced] -
+        List.Counts[KCmdResourceBarrier] - List.Counts[KCmdClearRenderTargetView] -
+        List.Counts[KCmdClearDepthStencilView] - List.Counts[KCmdCopyTextureRegion] - List.Counts[KCmdClose];
+}
+
+static unsigned
+GetFilteredCount(const TCommandList& List)
+{
+    unsigned Count = 0;
+    for (unsigned Index = 0; Index < KCmdCount; ++Index)
+        Count += List.FilteredCounts[Index];
+    return Count;
+}
+
+static const char*
+GetCommandName(ECommand Command)
+{
+    static const char* Names[KCmdCount] =
+    {
+        "SetDescriptorHeaps",
+        "RSSetViewports",
+        "RSSetScissorRects",
+        "ResourceBarrier",
+        "OMSetRenderTargets",
+        "ClearRenderTargetView",
+        "ClearDepthStencilView",
+        "IASetPrimitiveTopology",
+        "SetPipelineState",
+        "SetGraphicsRootSignature",
+        "SetGraphicsRootConstantBufferView",
+        "SetGraphicsRootDescriptorTable",
+        "SetGraphicsRoot32BitConstant",
+        "IASetVertexBuffers",
+        "IASetIndexBuffer",
+        "DrawInstanced",
+        "DrawIndexedInstanced",
+        "CopyTextureRegion",
+        "Close",
+    };
+    return Command < KCmdCount ? Names[Command] : "Unknown";
+}
+
+static void
+SetDescriptorHeaps(TCommandList& List, ID3D12DescriptorHeap* Heap)
+{
+    if (Priv::IsRedundant(List, KCmdSetDescriptorHeaps, List.Cache.DescriptorHeap, Heap))
+        return;
+    // Tables set before the heap change point into the old heap.
+    List.Cache.RootValidMask = 0;
+    List.Counts[KCmdSetDescriptorHeaps]++;
+    CMD_FORWARD(List, SetDescriptorHeaps(1, &Heap));
+    Priv::Record(List, KCmdSetDescriptorHeaps, Heap);
+}
+
+static void
+RSSetViewports(TCommandList& List, const D3D12_VIEWPORT& Viewport)
+{
+    if (Priv::IsRedundant(List, KCmdRSSetViewports, List.Cache.Viewport, Viewport))
+        return;
+    List.Counts[KCmdRSSetViewports]++;
+    CMD_FORWARD(List, RSSetViewports(1, &Viewport));
+    Priv::Record(List, KCmdRSSetViewports, Viewport);
+}
+
+static void
+RSSetScissorRects(TCommandList& List, const D3D12_RECT& Rect)
+{
+    if (Priv::IsRedundant(List, KCmdRSSetScissorRects, List.Cache.ScissorRect, Rect))
+        return;
+    List.Counts[KCmdRSSetScissorRects]++;
+    CMD_FORWARD(List, RSSetScissorRects(1, &Rect));
+    Priv::Record(List, KCmdRSSetScissorRects, Rect);
+}
+
+static void
+ResourceBarrier(TCommandList& List, ID3D12Resource* Resource, D3D12_RESOURCE_STATES StateBefore,
+                D3D12_RESOURCE_STATES StateAfter)
+{
+    List.Counts[KCmdResourceBarrier]++;
+    CMD_FORWARD(List, ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(Resource, StateBefore, StateAfter)));
+    Priv::Record(List, KCmdResourceBarrier, Priv::TResourceBarrier{ Resource, StateBefore, StateAfter });
+}
+
+static void
+OMSetRenderTargets(TCommandList& List, D3D12_CPU_DESCRIPTOR_HANDLE RenderTarget,
+                   const D3D12_CPU_DESCRIPTOR_HANDLE* DepthStencil)
+{
+    List.Counts[KCmdOMSetRenderTargets]++;
+    CMD_FORWARD(List, OMSetRenderTargets(1, &RenderTarget, FALSE, DepthStencil));
+    Priv::TOMSetRenderTargets Payload = {};
+    Payload.RenderTarget = RenderTarget;
+    if (DepthStencil)
+    {
+        Payload.DepthStencil = *DepthStencil;
+        Payload.HasDepthStencil = true;
+    }
+    Priv::Record(List, KCmdOMSetRenderTargets, Payload);
+}
+
+static void
+ClearRenderTargetView(TCommandList& List, D3D12_CPU_DESCRIPTOR_HANDLE RenderTarget, const float Color[4])
+{
+    List.Counts[KCmdClearRenderTargetView]++;
+    CMD_FORWARD(List, ClearRenderTargetView(RenderTarget, Color, 0, nullptr));
+    Priv::Record(List, KCmdClearRenderTargetView,
+                 Priv::TClearRenderTargetView{ RenderTarget, { Color[0], Color[1], Color[2], Color[3] } });
+}
+
+static void
+ClearDepthStencilView(TCommandList& List, D3D12_CPU_DESCRIPTOR_HANDLE DepthStencil, float Depth)
+{
+    List.Counts[KCmdClearDepthStencilView]++;
+    CMD_FORWARD(List, ClearDepthStencilView(DepthStencil, D3D12_CLEAR_FLAG_DEPTH, Depth, 0, 0, nullptr));
+    Priv::Record(List, KCmdClearDepthStencilView, Priv::TClearDepthStencilView{ DepthStencil, Depth });
+}
+
+static void
+IASetPrimitiveTopology(TCommandList& List, D3D12_PRIMITIVE_TOPOLOGY Topology)
+{
+    if (Priv::IsRedundant(List, KCmdIASetPrimitiveTopology, List.Cache.Topology, Topology))
+        return;
+    List.Counts[KCmdIASetPrimitiveTopology]++;
+    CMD_FORWARD(List, IASetPrimitiveTopology(Topology));
+    Priv::Record(List, KCmdIASetPrimitiveTopology, Topology);
+}
+
+static void
+SetPipelineState(TCommandList& List, ID3D12PipelineState* PipelineState)
+{
+    if (Priv::IsRedundant(List, KCmdSetPipelineState, List.Cache.PipelineState, PipelineState))
+        return;
+    List.Counts[KCmdSetPipelineState]++;
+    CMD_FORWARD(List, SetPipelineState(PipelineState));
+    Priv::Record(List, KCmdSetPipelineState, PipelineState);
+}
+
+static void
+SetGraphicsRootSignature(TCommandList& List, ID3D12RootSignature* RootSignature)
+{
+    if (Priv::IsRedundant(List, KCmdSetGraphicsRootSignature, List.Cache.RootSignature, RootSignature))
+        return;
+    // Root arguments are undefined after a root signature change.
+    List.Cache.RootValidMask = 0;
+    List.Counts[KCmdSetGraphicsRootSignature]++;
+    CMD_FORWARD(List, SetGraphicsRootSignature(RootSignature));
+    Priv::Record(List, KCmdSetGraphicsRootSignature, RootSignature);
+}
+
+static void
+SetGraphicsRootConstantBufferView(TCommandList& List, unsigned RootIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+{
+    if (Priv::IsRedundantRootArgument(List, KCmdSetGraphicsRootConstantBufferView, RootIndex, BufferLocation))
+        return;
+    List.Counts[KCmdSetGraphicsRootConstantBufferView]++;
+    CMD_FORWARD(List, SetGraphicsRootConstantBufferView(RootIndex, BufferLocation));
+    Priv::Record(List, KCmdSetGraphicsRootConstantBufferView, Priv::TSetRootConstantBufferView{ RootIndex, BufferLocation });
+}
+
+static void
+SetGraphicsRootDescriptorTable(TCommandList& List, unsigned RootIndex, D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor)
+{
+    if (Priv::IsRedundantRootArgument(List, KCmdSetGraphicsRootDescriptorTable, RootIndex, BaseDescriptor.ptr))
+        return;
+    List.Counts[KCmdSetGraphicsRootDescriptorTable]++;
+    CMD_FORWARD(List, SetGraphicsRootDescriptorTable(RootIndex, BaseDescriptor));
+    Priv::Record(List, KCmdSetGraphicsRootDescriptorTable, Priv::TSetRootDescriptorTable{ RootIndex, BaseDescriptor });
+}
+
+static void
+SetGraphicsRoot32BitConstant(TCommandList& List, unsigned RootIndex, uint32_t Value, unsigned DestOffset)
+{
+    const uint64_t Argument = ((uint64_t)DestOffset << 32) | Value;
+    if (Priv::IsRedundantRootArgument(List, KCmdSetGraphicsRoot32BitConstant, RootIndex, Argument))
+        return;
+    List.Counts[KCmdSetGraphicsRoot32BitConstant]++;
+    CMD_FORWARD(List, SetGraphicsRoot32BitConstant(RootIndex, Value, DestOffset));
+    Priv::Record(List, KCmdSetGraphicsRoot32BitConstant, Priv::TSetRoot32BitConstant{ RootIndex, Value, DestOffset });
+}
+
+static void
+IASetVertexBuffers(TCommandList& List, unsigned Slot, const D3D12_VERTEX_BUFFER_VIEW& View)
+{
+    if (Slot == 0 && Priv::IsRedundant(List, KCmdIASetVertexBuffers, List.Cache.VertexBuffer, View))
+        return;
+    List.Counts[KCmdIASetVertexBuffers]++;
+    CMD_FORWARD(List, IASetVertexBuffers(Slot, 1, &View));
+    Priv::Record(List, KCmdIASetVertexBuffers, Priv::TIASetVertexBuffers{ Slot, View });
+}
+
+static void
+IASetIndexBuffer(TCommandList& List, const D3D12_INDEX_BUFFER_VIEW& View)
+{
+    if (Priv::IsRedundant(List, KCmdIASetIndexBuffer, List.Cache.IndexBuffer, View))
+        return;
+    List.Counts[KCmdIASetIndexBuffer]++;
+    CMD_FORWARD(List, IASetIndexBuffer(&View));
+    Priv::Record(List, KCmdIASetIndexBuffer, View);
+}
+
+static void
+DrawInstanced(TCommandList& List, unsigned VertexCountPerInstance, unsigned InstanceCount,
+              unsigned StartVertexLocation, unsigned StartInstanceLocation)
+{
+    List.Counts[KCmdDrawInstanced]++;
+    CMD_FORWARD(List, DrawInstanced(VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation));
+    Priv::Record(List, KCmdDrawInstanced, Priv::TDrawInstanced{ VertexCountPerInstance, InstanceCount,
+                                                                StartVertexLocation, StartInstanceLocation });
+}
+
+static void
+DrawIndexedInstanced(TCommandList& List, unsigned IndexCountPerInstance, unsigned InstanceCount,
+                     unsigned StartIndexLocation, int BaseVertexLocation, unsigned StartInstanceLocation)
+{
+    List.Counts[KCmdDrawIndexedInstanced]++;
+    CMD_FORWARD(List, DrawIndexedInstanced(IndexCountPerInstance, InstanceCount, StartIndexLocation,
+                                           BaseVertexLocation, StartInstanceLocation));
+    Priv::Record(List, KCmdDrawIndexedInstanced, Priv::TDrawIndexedInstanced{ IndexCountPerInstance, InstanceCount,
+                                                                              StartIndexLocation, BaseVertexLocation,
+                                                                              StartInstanceLocation });
+}
+
+static void
+CopyTextureRegion(TCommandList& List, ID3D12Resource* Destination, unsigned DestinationX, unsigned DestinationY,
+                  ID3D12Resource* Source, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& Footprint)
+{
+    List.Counts[KCmdCopyTextureRegion]++;
+    CMD_FORWARD(List, CopyTextureRegion(&CD3DX12_TEXTURE_COPY_LOCATION(Destination, 0), DestinationX, DestinationY, 0,
+                                        &CD3DX12_TEXTURE_COPY_LOCATION(Source, Footprint), nullptr));
+    Priv::Record(List, KCmdCopyTextureRegion, Priv::TCopyTextureRegion{ Destination, DestinationX, DestinationY,
+                                                                        Source, Footprint });
+}
+
+static void
+Close(TCommandList& List)
+{
+    List.Counts[KCmdClose]++;
+    List.Open = false;
+    memset(&List.Cache, 0, sizeof(List.Cache));
+#if !defined(DEMO_HEADLESS)
+    if (List.Native)
+    {
+        VHR(List.Native->Close());
+        return;
+    }
+#endif
+    Priv::Record(List, KCmdClose);
+}
+
+#undef CMD_FORWARD
+
+// Decodes a recorded stream and issues every command on Target (which may itself be recording).
+static void
+Replay(const TCommandList& Source, TCommandList& Target)
+{
+    const uint8_t* Cursor = Source.Stream.data();
+    const uint8_t* End = Cursor + Source.Stream.size();
+
+    while (Cursor < End)
+    {
+        const ECommand Command = (ECommand)*Cursor++;
+        switch (Command)
+        {
+        case KCmdSetDescriptorHeaps:
+            SetDescriptorHeaps(Target, Priv::Read<ID3D12DescriptorHeap*>(Cursor));
+            break;
+        case KCmdRSSetViewports:
+            RSSetViewports(Target, Priv::Read<D3D12_VIEWPORT>(Cursor));
+            break;
+        case KCmdRSSetScissorRects:
+            RSSetScissorRects(Target, Priv::Read<D3D12_RECT>(Cursor));
+            break;
+        case KCmdResourceBarrier:
+            {
+                const auto Payload = Priv::Read<Priv::TResourceBarrier>(Cursor);
+                ResourceBarrier(Target, Payload.Resource, Payload.StateBefore, Payload.StateAfter);
+            }
+            break;
+        case KCmdOMSetRenderTargets:
+            {
+                const auto Payload = Priv::Read<Priv::TOMSetRenderTargets>(Cursor);
+                OMSetRenderTargets(Target, Payload.RenderTarget, Payload.HasDepthStencil ? &Payload.DepthStencil : nullptr);
+            }
+            break;
+        case KCmdClearRenderTargetView:
+            {
+                const auto Payload = Priv::Read<Priv::TClearRenderTargetView>(Cursor);
+                ClearRenderTargetView(Target, Payload.RenderTarget, Payload.Color);
+            }
+            break;
+        case KCmdClearDepthStencilView:
+            {
+                const auto Payload = Priv::Read<Priv::TClearDepthStencilView>(Cursor);
+                ClearDepthStencilView(Target, Payload.DepthStencil, Payload.Depth);
+            }
+            break;
+        case KCmdIASetPrimitiveTopology:
+            IASetPrimitiveTopology(Target, Priv::Read<D3D12_PRIMITIVE_TOPOLOGY>(Cursor));
+            break;
+        case KCmdSetPipelineState:
+            SetPipelineState(Target, Priv::Read<ID3D12PipelineState*>(Cursor));
+            break;
+        case KCmdSetGraphicsRootSignature:
+            SetGraphicsRootSignature(Target, Priv::Read<ID3D12RootSignature*>(Cursor));
+            break;
+        case KCmdSetGraphicsRootConstantBufferView:
+            {
+                const auto Payload = Priv::Read<Priv::TSetRootConstantBufferView>(Cursor);
+                SetGraphicsRootConstantBufferView(Target, Payload.RootIndex, Payload.BufferLocation);
+            }
+            break;
+        case KCmdSetGraphicsRootDescriptorTable:
+            {
+                const auto Payload = Priv::Read<Priv::TSetRootDescriptorTable>(Cursor);
+                SetGraphicsRootDescriptorTable(Target, Payload.RootIndex, Payload.BaseDescriptor);
+            }
+            break;
+        case KCmdSetGraphicsRoot32BitConstant:
+            {
+                const auto Payload = Priv::Read<Priv::TSetRoot32BitConstant>(Cursor);
+                SetGraphicsRoot32BitConstant(Target, Payload.RootIndex, Payload.Value, Payload.DestOffset);
+            }
+            break;
+        case KCmdIASetVertexBuffers:
+            {
+                const auto Payload = Priv::Read<Priv::TIASetVertexBuffers>(Cursor);
+                IASetVertexBuffers(Target, Payload.Slot, Payload.View);
+            }
+            break;
+        case KCmdIASetIndexBuffer:
+            IASetIndexBuffer(Target, Priv::Read<D3D12_INDEX_BUFFER_VIEW>(Cursor));
+            break;
+        case KCmdDrawInstanced:
+            {
+                const auto Payload = Priv::Read<Priv::TDrawInstanced>(Cursor);
+                DrawInstanced(Target, Payload.VertexCountPerInstance, Payload.InstanceCount,
+                              Payload.StartVertexLocation, Payload.StartInstanceLocation);
+            }
+            break;
+        case KCmdDrawIndexedInstanced:
+            {
+                const auto Payload = Priv::Read<Priv::TDrawIndexedInstanced>(Cursor);
+                DrawIndexedInstanced(Target, Payload.IndexCountPerInstance, Payload.InstanceCount,
+                                     Payload.StartIndexLocation, Payload.BaseVertexLocation,
+                                     Payload.StartInstanceLocation);
+            }
+            break;
+        case KCmdCopyTextureRegion:
+            {
+                const auto Payload = Priv::Read<Priv::TCopyTextureRegion>(Cursor);
+                CopyTextureRegion(Target, Payload.Destination, Payload.DestinationX, Payload.DestinationY,
+                                  Payload.Source, Payload.Footprint);
+            }
+            break;
+        case KCmdClose:
+            Close(Target);
+            break;
+        default:
+            assert(0);
+            return;
+        }
+    }
+}
+
+} // namespace Cmd
+// vim: set ts=4 sw=4 expandtab:
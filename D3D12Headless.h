@@ -0,0 +1,111 @@
+#pragma once
+
+// Plain-data stand-ins for the D3D12 types shared by the portable code and DirectX12.cpp. Headless
+// builds (DEMO_HEADLESS) use these instead of d3d12.h; enum values match the real headers so that
+// recorded command streams look the same on both platforms. Interfaces are empty objects, the null
+// backend only uses their addresses as identities.
+
+typedef int32_t LONG;
+typedef uint64_t D3D12_GPU_VIRTUAL_ADDRESS;
+
+struct D3D12_CPU_DESCRIPTOR_HANDLE { size_t ptr; };
+struct D3D12_GPU_DESCRIPTOR_HANDLE { uint64_t ptr; };
+
+struct D3D12_RECT { LONG left, top, right, bottom; };
+
+struct D3D12_VIEWPORT
+{
+    float TopLeftX, TopLeftY;
+    float Width, Height;
+    float MinDepth, MaxDepth;
+};
+
+enum DXGI_FORMAT
+{
+    DXGI_FORMAT_UNKNOWN = 0,
+    DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+    DXGI_FORMAT_D32_FLOAT = 40,
+    DXGI_FORMAT_R32_UINT = 42,
+    DXGI_FORMAT_R16_UINT = 57,
+    DXGI_FORMAT_R8_UNORM = 61,
+    DXGI_FORMAT_R8_UINT = 62,
+};
+
+struct D3D12_VERTEX_BUFFER_VIEW
+{
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+    uint32_t SizeInBytes;
+    uint32_t StrideInBytes;
+};
+
+struct D3D12_INDEX_BUFFER_VIEW
+{
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+    uint32_t SizeInBytes;
+    DXGI_FORMAT Format;
+};
+
+// Upload buffer rows of a texture copy are D3D12_TEXTURE_DATA_PITCH_ALIGNMENT apart, and the copied
+// footprint starts at a D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT aligned offset.
+#define D3D12_TEXTURE_DATA_PITCH_ALIGNMENT 256
+#define D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT 512
+
+struct D3D12_SUBRESOURCE_FOOTPRINT
+{
+    DXGI_FORMAT Format;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Depth;
+    uint32_t RowPitch;
+};
+
+struct D3D12_PLACED_SUBRESOURCE_FOOTPRINT
+{
+    uint64_t Offset;
+    D3D12_SUBRESOURCE_FOOTPRINT Footprint;
+};
+
+enum D3D12_PRIMITIVE_TOPOLOGY
+{
+    D3D_PRIMITIVE_TOPOLOGY_UNDEFINED = 0,
+    D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4,
+    D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP = 5,
+};
+
+enum D3D12_RESOURCE_STATES
+{
+    D3D12_RESOURCE_STATE_COMMON = 0,
+    D3D12_RESOURCE_STATE_RENDER_TARGET = 0x4,
+    D3D12_RESOURCE_STATE_DEPTH_WRITE = 0x10,
+    D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE = 0x80,
+    D3D12_RESOURCE_STATE_COPY_DEST = 0x400,
+    D3D12_RESOURCE_STATE_COPY_SOURCE = 0x800,
+    D3D12_RESOURCE_STATE_GENERIC_READ = 0xac3,
+    D3D12_RESOURCE_STATE_PRESENT = 0,
+};
+
+enum D3D12_CLEAR_FLAGS
+{
+    D3D12_CLEAR_FLAG_DEPTH = 0x1,
+    D3D12_CLEAR_FLAG_STENCIL = 0x2,
+};
+
+enum D3D12_DESCRIPTOR_HEAP_TYPE
+{
+    D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV = 0,
+    D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER = 1,
+    D3D12_DESCRIPTOR_HEAP_TYPE_RTV = 2,
+    D3D12_DESCRIPTOR_HEAP_TYPE_DSV = 3,
+};
+
+enum D3D12_DESCRIPTOR_HEAP_FLAGS
+{
+    D3D12_DESCRIPTOR_HEAP_FLAG_NONE = 0,
+    D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE = 0x1,
+};
+
+struct ID3D12Resource {};
+struct ID3D12DescriptorHeap {};
+struct ID3D12PipelineState {};
+struct ID3D12RootSignature {};
+// vim: set ts=4 sw=4 expandtab:
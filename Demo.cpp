@@ -1,123 +1,313 @@
-﻿#include "External.h"
-#include "Demo.h"
-
-
-static void
-BeginFrame()
-{
-    ID3D12CommandAllocator* CmdAlloc = Dx::GCmdAlloc[Dx::GFrameIndex];
-    Dx::TGraphicsCommandList* CmdList = Dx::GCmdList;
-
-    CmdAlloc->Reset();
-    CmdList->Reset(CmdAlloc, nullptr);
-
-    Dx::SetDescriptorHeap();
-
-    CmdList->RSSetViewports(1, &CD3DX12_VIEWPORT(0.0f, 0.0f, (float)Dx::GResolution[0], (float)Dx::GResolution[1]));
-    CmdList->RSSetScissorRects(1, &CD3DX12_RECT(0, 0, Dx::GResolution[0], Dx::GResolution[1]));
-
-    ID3D12Resource* BackBuffer;
-    D3D12_CPU_DESCRIPTOR_HANDLE BackBufferHandle;
-    Dx::GetBackBuffer(BackBuffer, BackBufferHandle);
-
-    CmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(BackBuffer, D3D12_RESOURCE_STATE_PRESENT,
-                                                                      D3D12_RESOURCE_STATE_RENDER_TARGET));
-
-    CmdList->OMSetRenderTargets(1, &BackBufferHandle, FALSE, &Dx::GDepthBufferHandle);
-    CmdList->ClearRenderTargetView(BackBufferHandle, XMVECTORF32{ 1.0f, 1.0f, 1.0f, 0.0f }, 0, nullptr);
-    CmdList->ClearDepthStencilView(Dx::GDepthBufferHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
-}
-
-static void
-EndFrame()
-{
-    ID3D12Resource* BackBuffer;
-    D3D12_CPU_DESCRIPTOR_HANDLE BackBufferHandle;
-    Dx::GetBackBuffer(BackBuffer, BackBufferHandle);
-
-    Dx::GCmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(BackBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET,
-                                                                           D3D12_RESOURCE_STATE_PRESENT));
-    VHR(Dx::GCmdList->Close());
-
-    Dx::GCmdQueue->ExecuteCommandLists(1, (ID3D12CommandList**)&Dx::GCmdList);
-}
-
-static void
-UpdateAndRender(double Time, float DeltaTime)
-{
-    ImGui::ShowDemoWindow();
-}
-
-static void
-Initialize()
-{
-}
-
-static void
-Shutdown()
-{
-}
-
-int CALLBACK
-WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
-{
-    const char* WindowName = "Demo1";
-    const unsigned WindowWidth = 1920;
-    const unsigned WindowHeight = 1080;
-
-    SetProcessDPIAware();
-    ImGui::CreateContext();
-
-    Dx::Initialize(Lib::InitializeWindow(WindowName, WindowWidth, WindowHeight));
-    Gui::Initialize();
-    Initialize();
-
-    // Upload resources to the GPU.
-    VHR(Dx::GCmdList->Close());
-    Dx::GCmdQueue->ExecuteCommandLists(1, (ID3D12CommandList**)&Dx::GCmdList);
-    Dx::WaitForGpu();
-
-    for (ID3D12Resource* Resource : Dx::GIntermediateResources)
-        SAFE_RELEASE(Resource);
-
-    Dx::GIntermediateResources.resize(0);
-
-
-    for (;;)
-    {
-        MSG Message = {};
-        if (PeekMessage(&Message, 0, 0, 0, PM_REMOVE))
-        {
-            DispatchMessage(&Message);
-            if (Message.message == WM_QUIT)
-                break;
-        }
-        else
-        {
-            double Time;
-            float DeltaTime;
-            Lib::UpdateFrameStats(Dx::GWindow, WindowName, Time, DeltaTime);
-            Gui::Update(DeltaTime);
-
-            BeginFrame();
-            ImGui::NewFrame();
-            UpdateAndRender(Time, DeltaTime);
-            ImGui::Render();
-            Gui::Render();
-            EndFrame();
-
-            Dx::PresentFrame();
-        }
-    }
-
-    Dx::WaitForGpu();
-    Shutdown();
-    Gui::Shutdown();
-    Dx::Shutdown();
-    return 0;
-}
-
-#include "Directx12.cpp"
-#include "Gui.cpp"
-#include "Library.cpp"
-// vim: set ts=4 sw=4 expandtab:
+﻿#include "External.h"
+#include "Demo.h"
+
+
+static void
+BeginFrame()
+{
+    Cmd::TCommandList& CmdList = Dx::GCmdList;
+
+    Dx::ResetCommandList();
+    Dx::SetDescriptorHeap();
+
+    const D3D12_VIEWPORT Viewport = { 0.0f, 0.0f, (float)Dx::GResolution[0], (float)Dx::GResolution[1], 0.0f, 1.0f };
+    const D3D12_RECT ScissorRect = { 0, 0, (LONG)Dx::GResolution[0], (LONG)Dx::GResolution[1] };
+    Cmd::RSSetViewports(CmdList, Viewport);
+    Cmd::RSSetScissorRects(CmdList, ScissorRect);
+
+    ID3D12Resource* BackBuffer;
+    D3D12_CPU_DESCRIPTOR_HANDLE BackBufferHandle;
+    Dx::GetBackBuffer(BackBuffer, BackBufferHandle);
+
+    Cmd::ResourceBarrier(CmdList, BackBuffer, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+    const float ClearColor[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+    Cmd::OMSetRenderTargets(CmdList, BackBufferHandle, &Dx::GDepthBufferHandle);
+    Cmd::ClearRenderTargetView(CmdList, BackBufferHandle, ClearColor);
+    Cmd::ClearDepthStencilView(CmdList, Dx::GDepthBufferHandle, 1.0f);
+}
+
+static void
+EndFrame()
+{
+    PROF_ZONE("EndFrame");
+    ID3D12Resource* BackBuffer;
+    D3D12_CPU_DESCRIPTOR_HANDLE BackBufferHandle;
+    Dx::GetBackBuffer(BackBuffer, BackBufferHandle);
+
+    Cmd::ResourceBarrier(Dx::GCmdList, BackBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+    Dx::ExecuteCommandList();
+}
+
+// Sand canvas covering the window; the left mouse button paints with the selected material.
+struct TSandState
+{
+    Sand::TCanvas Canvas;
+    int BrushMaterial;
+    int BrushRadius;
+    bool Spouts;
+    bool Paused;
+    bool Painting;
+    ImVec2 LastMousePosition;
+    double StepTime; // of the last Sand::Update(), per step
+};
+static TSandState GSand;
+
+// Stone ramps zigzagging down the canvas, with a basin at the bottom.
+static void
+ResetSandScene()
+{
+    Sand::TCanvas& Canvas = GSand.Canvas;
+    Sand::CreateCanvas(Canvas, Canvas.Width, Canvas.Height);
+
+    const float Width = (float)Canvas.Width;
+    const float Height = (float)Canvas.Height;
+    for (unsigned Ramp = 0; Ramp < 4; ++Ramp)
+    {
+        const float Y = Height * (0.2f + 0.17f * Ramp);
+        if (Ramp & 1)
+            Sand::Paint(Canvas, Width * 0.35f, Y + Height * 0.06f, Width * 0.9f, Y, 4.0f, Sand::KStone);
+        else
+            Sand::Paint(Canvas, Width * 0.1f, Y, Width * 0.65f, Y + Height * 0.06f, 4.0f, Sand::KStone);
+    }
+    Sand::Paint(Canvas, Width * 0.3f, Height * 0.82f, Width * 0.3f, Height, 4.0f, Sand::KStone);
+    Sand::Paint(Canvas, Width * 0.7f, Height * 0.82f, Width * 0.7f, Height, 4.0f, Sand::KStone);
+}
+
+static void
+UpdateSand(float DeltaTime)
+{
+    PROF_ZONE("UpdateSand");
+    Sand::TCanvas& Canvas = GSand.Canvas;
+
+    if (ImGui::Begin("Sand"))
+    {
+        ImGui::Text("%u x %u cells, step %llu", Canvas.Width, Canvas.Height, (unsigned long long)Canvas.StepCount);
+        ImGui::Text("%.3f ms per step (%s kernel), %llu cells moved", GSand.StepTime * 1000.0,
+                    Sand::GetKernelName(Canvas.Kernel), (unsigned long long)Sand::GetMoveCount(Canvas));
+        const Sand::TUploadStats& UploadStats = Sand::GetUploadStats();
+        ImGui::Text("%u of %u chunks active, %.1f KB uploaded in %u copies", Sand::GetActiveChunkCount(Canvas),
+                    (unsigned)Canvas.Chunks.size(), UploadStats.ByteCount / 1024.0, UploadStats.CopyCount);
+        ImGui::RadioButton("Sand", &GSand.BrushMaterial, Sand::KSand);
+        ImGui::SameLine();
+        ImGui::RadioButton("Water", &GSand.BrushMaterial, Sand::KWater);
+        ImGui::SameLine();
+        ImGui::RadioButton("Stone", &GSand.BrushMaterial, Sand::KStone);
+        ImGui::SameLine();
+        ImGui::RadioButton("Erase", &GSand.BrushMaterial, Sand::KEmpty);
+        ImGui::SliderInt("Brush radius", &GSand.BrushRadius, 1, 64);
+        ImGui::Checkbox("Spouts", &GSand.Spouts);
+        ImGui::SameLine();
+        ImGui::Checkbox("Paused", &GSand.Paused);
+        if (ImGui::Button("Reset"))
+            ResetSandScene();
+    }
+    ImGui::End();
+
+    const ImGuiIO& Io = ImGui::GetIO();
+    if (Io.MouseDown[0] && (GSand.Painting || !Io.WantCaptureMouse))
+    {
+        const ImVec2 From = GSand.Painting ? GSand.LastMousePosition : Io.MousePos;
+        Sand::Paint(Canvas, From.x, From.y, Io.MousePos.x, Io.MousePos.y, (float)GSand.BrushRadius,
+                    (Sand::EMaterial)GSand.BrushMaterial);
+        GSand.Painting = true;
+        GSand.LastMousePosition = Io.MousePos;
+    }
+    else
+    {
+        GSand.Painting = false;
+    }
+
+    if (GSand.Paused)
+        return;
+
+    if (GSand.Spouts)
+    {
+        const float Width = (float)Canvas.Width;
+        Sand::Paint(Canvas, Width * 0.2f, 8.0f, Width * 0.2f, 8.0f, 3.0f, Sand::KSand);
+        Sand::Paint(Canvas, Width * 0.5f, 8.0f, Width * 0.5f, 8.0f, 3.0f, Sand::KWater);
+        Sand::Paint(Canvas, Width * 0.8f, 8.0f, Width * 0.8f, 8.0f, 3.0f, Sand::KSand);
+    }
+
+    const double Time = Lib::GetTime();
+    const unsigned StepCount = Sand::Update(Canvas, DeltaTime);
+    if (StepCount > 0)
+        GSand.StepTime = (Lib::GetTime() - Time) / StepCount;
+}
+
+static void
+UpdateAndRender(double Time, float DeltaTime)
+{
+    PROF_ZONE("UpdateAndRender");
+    UpdateSand(DeltaTime);
+    Sand::Render(GSand.Canvas);
+    ImGui::ShowDemoWindow();
+    Prof::ShowWindow();
+}
+
+static void
+Initialize()
+{
+    GSand.Canvas.Width = Dx::GResolution[0];
+    GSand.Canvas.Height = Dx::GResolution[1];
+    GSand.BrushMaterial = Sand::KSand;
+    GSand.BrushRadius = 8;
+    GSand.Spouts = true;
+    GSand.Paused = false;
+    GSand.Painting = false;
+    GSand.StepTime = 0.0;
+    ResetSandScene();
+    Sand::Initialize(GSand.Canvas.Width, GSand.Canvas.Height);
+}
+
+static void
+Shutdown()
+{
+    Sand::Shutdown();
+}
+
+static Plat::TWindow
+InitializeFramework(const char* WindowName, unsigned WindowWidth, unsigned WindowHeight,
+                    const Dx::TFrameSettings& FrameSettings)
+{
+    Jobs::Initialize(Jobs::GetDefaultWorkerCount());
+    Load::Initialize(true);
+    // Data.pak is built from Data/ by demo_pack; without it the loose files are read.
+    Load::MountArchive("Data.pak");
+    ImGui::CreateContext();
+
+    // The Gui assets are read while the window is created. Their decode jobs (the font atlas) start
+    // before the device is created and run on the workers meanwhile; Gui::Initialize() waits for them.
+    Gui::RequestAssets();
+    Sand::RequestAssets();
+    const Plat::TWindow Window = Plat::Initialize(WindowName, WindowWidth, WindowHeight);
+    Load::WaitForReads();
+    Dx::Initialize(Window, FrameSettings);
+    Gui::Initialize();
+    Initialize();
+
+    // Upload resources to the GPU.
+    Dx::ExecuteCommandList();
+    Dx::WaitForGpu();
+
+#if !defined(DEMO_HEADLESS)
+    for (ID3D12Resource* Resource : Dx::GIntermediateResources)
+        SAFE_RELEASE(Resource);
+
+    Dx::GIntermediateResources.resize(0);
+#endif
+    return Window;
+}
+
+// Input is sampled after the frame latency wait so that, in low latency mode, it is as recent as
+// possible when the frame is recorded.
+static bool
+ProcessFrameEvents()
+{
+    Dx::WaitForFrameLatency();
+    return Plat::ProcessEvents();
+}
+
+static void
+RunFrame(Plat::TWindow Window, const char* WindowName)
+{
+    {
+        PROF_ZONE("Frame");
+
+        double Time;
+        float DeltaTime;
+        Lib::UpdateFrameStats(Window, WindowName, Time, DeltaTime);
+        Gui::Update(DeltaTime);
+
+        BeginFrame();
+        Load::Update();
+        {
+            PROF_ZONE("ImGui::NewFrame");
+            ImGui::NewFrame();
+        }
+        UpdateAndRender(Time, DeltaTime);
+        {
+            PROF_ZONE("ImGui::Render");
+            ImGui::Render();
+        }
+        Gui::Render();
+        EndFrame();
+
+        Dx::PresentFrame();
+    }
+    Prof::EndFrame();
+}
+
+static void
+ShutdownFramework()
+{
+    Dx::WaitForGpu();
+    Shutdown();
+    Gui::Shutdown();
+    Dx::Shutdown();
+    Plat::Shutdown();
+    ImGui::DestroyContext();
+    Load::Shutdown();
+    Jobs::Shutdown();
+}
+
+#if !defined(DEMO_HEADLESS)
+
+// The demo's command line: "--frames-in-flight N" (1-4, default 2) and "--low-latency", which pick the
+// frame settings as the same options of demo_bench do.
+static Dx::TFrameSettings
+ParseFrameSettings(const char* CommandLine)
+{
+    Dx::TFrameSettings Settings = { 2, false };
+    char Buffer[256];
+    snprintf(Buffer, sizeof(Buffer), "%s", CommandLine ? CommandLine : "");
+
+    for (char* Token = strtok(Buffer, " \t"); Token; Token = strtok(nullptr, " \t"))
+    {
+        if (strcmp(Token, "--frames-in-flight") == 0)
+        {
+            if (const char* Value = strtok(nullptr, " \t"))
+                Settings.FramesInFlight = std::min(std::max(atoi(Value), 1), (int)Dx::KMaxFramesInFlight);
+        }
+        else if (strcmp(Token, "--low-latency") == 0)
+            Settings.LowLatency = true;
+    }
+    return Settings;
+}
+
+int CALLBACK
+WinMain(HINSTANCE, HINSTANCE, LPSTR CommandLine, int)
+{
+    const char* WindowName = "Demo1";
+
+    SetProcessDPIAware();
+    const Dx::TFrameSettings FrameSettings = ParseFrameSettings(CommandLine);
+    const Plat::TWindow Window = InitializeFramework(WindowName, 1920, 1080, FrameSettings);
+
+    while (ProcessFrameEvents())
+        RunFrame(Window, WindowName);
+
+    ShutdownFramework();
+    return 0;
+}
+
+#endif
+
+#include "Memory.cpp"
+#include "Profiler.cpp"
+#include "Jobs.cpp"
+#include "Archive.cpp"
+#include "Loader.cpp"
+#include "CommandList.cpp"
+#include "DirectX.cpp"
+#if defined(DEMO_HEADLESS)
+#include "DirectXNull.cpp"
+#include "PlatformHeadless.cpp"
+#else
+#include "Directx12.cpp"
+#include "PlatformWin32.cpp"
+#endif
+#include "Gui.cpp"
+#include "Sand.cpp"
+#include "Library.cpp"
+// vim: set ts=4 sw=4 expandtab:
@@ -1,71 +1,915 @@
-namespace Dx
-{
-
-typedef ID3D12Device3 TDevice;
-typedef ID3D12GraphicsCommandList2 TGraphicsCommandList;
-
-static TDevice* GDevice;
-static ID3D12CommandQueue* GCmdQueue;
-static ID3D12CommandAllocator* GCmdAlloc[2];
-static TGraphicsCommandList* GCmdList;
-static ID3D12Resource* GDepthBuffer;
-static D3D12_CPU_DESCRIPTOR_HANDLE GDepthBufferHandle;
-static HWND GWindow;
-static unsigned GResolution[2];
-static unsigned GDescriptorSize;
-static unsigned GDescriptorSizeRtv;
-static unsigned GFrameIndex;
-static std::vector<ID3D12Resource*> GIntermediateResources;
-
-static void AllocateDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE Type,
-                                unsigned Count,
-                                D3D12_CPU_DESCRIPTOR_HANDLE& OutFirst);
-static void AllocateGpuDescriptors(unsigned Count,
-                                   D3D12_CPU_DESCRIPTOR_HANDLE& OutFirstCpu,
-                                   D3D12_GPU_DESCRIPTOR_HANDLE& OutFirstGpu);
-static void* AllocateGpuUploadMemory(unsigned Size,
-                                     D3D12_GPU_VIRTUAL_ADDRESS& OutGpuAddress);
-
-static D3D12_GPU_DESCRIPTOR_HANDLE CopyDescriptorsToGpu(unsigned Count,
-                                                        D3D12_CPU_DESCRIPTOR_HANDLE Source);
-
-static inline void GetBackBuffer(ID3D12Resource*& OutResource,
-                                 D3D12_CPU_DESCRIPTOR_HANDLE& OutHandle);
-
-static inline void SetDescriptorHeap();
-
-static void Initialize(HWND Window);
-static void Shutdown();
-static void PresentFrame();
-static void WaitForGpu();
-
-} // namespace Dx
-
-namespace Gui
-{
-
-static void Initialize();
-static void Shutdown();
-static void Update(float DeltaTime);
-static void Render();
-
-} // namespace Gui
-
-namespace Lib
-{
-
-static std::vector<uint8_t> LoadFile(const char* FileName);
-
-static double GetTime();
-
-static void UpdateFrameStats(HWND Window,
-                             const char* Name,
-                             double& OutTime,
-                             float& OutDeltaTime);
-
-static HWND InitializeWindow(const char* Name,
-                             unsigned Width,
-                             unsigned Height);
-
-} // namespace Lib
-// vim: set ts=4 sw=4 expandtab:
+namespace Plat
+{
+
+#if defined(DEMO_HEADLESS)
+
+struct THeadlessWindow
+{
+    unsigned Width;
+    unsigned Height;
+};
+typedef THeadlessWindow* TWindow;
+
+enum EScriptEventType
+{
+    KScriptMouseMove,
+    KScriptMouseDown,
+    KScriptMouseUp,
+    KScriptMouseWheel,
+    KScriptKeyDown,
+    KScriptKeyUp,
+    KScriptChar,
+    KScriptQuit
+};
+
+struct TScriptEvent
+{
+    unsigned Frame;
+    EScriptEventType Type;
+    int Value; // button, key (ImGuiKey_), wheel direction or character
+    float X, Y;
+};
+
+struct THeadlessScript
+{
+    unsigned FrameCount; // 0 runs until a KScriptQuit event
+    double TimeStep;
+    const TScriptEvent* Events; // sorted by Frame
+    unsigned EventCount;
+};
+
+static void SetHeadlessScript(const THeadlessScript& Script);
+
+#else
+
+typedef HWND TWindow;
+
+#endif
+
+static TWindow Initialize(const char* Name,
+                          unsigned Width,
+                          unsigned Height);
+static void Shutdown();
+static bool ProcessEvents();
+static double GetFrameTime();
+static void SetWindowTitle(TWindow Window,
+                           const char* Title);
+
+} // namespace Plat
+
+namespace Mem
+{
+
+// GPU progress as seen by the allocators: a monotonically increasing fence value.
+struct TRingFence
+{
+    uint64_t (*GetCompletedValue)(void* Context);
+    void (*WaitForValue)(void* Context, uint64_t Value);
+    void* Context;
+};
+
+struct TRingStats
+{
+    uint64_t HighWaterMark; // most bytes ever in flight
+    uint64_t FrameBytes;
+    uint64_t LastFrameBytes;
+    uint64_t PeakFrameBytes;
+    unsigned WaitCount;
+    unsigned WrapCount;
+    unsigned FailedCount;
+};
+
+static const unsigned KMaxRingFrames = 16;
+
+// Fence-tracked ring of bytes, used for per-frame upload memory.
+struct TRingAllocator
+{
+    uint64_t Capacity;
+    uint64_t Head;
+    uint64_t Tail;
+    struct
+    {
+        uint64_t FenceValue;
+        uint64_t End;
+    } Frames[KMaxRingFrames];
+    unsigned FrameFirst;
+    unsigned FrameCount;
+    TRingFence Fence;
+    TRingStats Stats;
+};
+
+static void InitializeRing(TRingAllocator& Ring,
+                           uint64_t Capacity,
+                           const TRingFence& Fence);
+static bool AllocateRing(TRingAllocator& Ring,
+                         uint64_t Size,
+                         uint64_t Alignment,
+                         uint64_t& OutOffset);
+static void EndRingFrame(TRingAllocator& Ring,
+                         uint64_t FenceValue);
+static bool RetireRing(TRingAllocator& Ring,
+                       bool Wait);
+
+static const unsigned KMaxSizeClasses = 16;
+
+// Descriptor counts, except PageCount and the operation counters.
+struct TPagedStats
+{
+    unsigned PageCount;
+    unsigned LiveCount;     // as requested
+    unsigned ReservedCount; // live, rounded up to the size class
+    unsigned FreeCount;     // on the free lists
+    unsigned PendingCount;  // freed, waiting for the fence
+    unsigned AllocationCount;
+    unsigned FailedCount;
+};
+
+// Hands out ranges of indices in [0, PageCount * PageSize) that never cross a page boundary. Ranges
+// are rounded up to a power of two and recycled through one free list per size class.
+struct TPagedAllocator
+{
+    struct TPendingFree
+    {
+        uint64_t FenceValue;
+        uint32_t Index;
+        unsigned Count;
+    };
+
+    unsigned PageSize;
+    unsigned MaxPageCount; // 0 is unlimited
+    uint32_t Cursor;
+    std::vector<uint32_t> FreeLists[KMaxSizeClasses];
+    std::vector<TPendingFree> Pending;
+    size_t PendingFirst;
+    TPagedStats Stats;
+};
+
+static void InitializePaged(TPagedAllocator& Allocator,
+                            unsigned PageSize,
+                            unsigned MaxPageCount);
+static bool AllocatePaged(TPagedAllocator& Allocator,
+                          unsigned Count,
+                          uint32_t& OutIndex);
+static void FreePaged(TPagedAllocator& Allocator,
+                      uint32_t Index,
+                      unsigned Count);
+static void DeferFreePaged(TPagedAllocator& Allocator,
+                           uint32_t Index,
+                           unsigned Count,
+                           uint64_t FenceValue);
+static void RetirePaged(TPagedAllocator& Allocator,
+                        uint64_t CompletedValue);
+
+} // namespace Mem
+
+namespace Prof
+{
+
+static const unsigned KMaxZones = 256;
+static const unsigned KMaxThreads = 64;
+static const unsigned KHistoryFrameCount = 256;
+
+// Per-zone time of the last KHistoryFrameCount frames, in seconds. A zone entered several times in a
+// frame counts once, with the sum of its durations.
+struct TZoneStats
+{
+    const char* Name;
+    unsigned FrameCount;
+    double Last;
+    double Min;
+    double Avg;
+    double P99;
+};
+
+static uint64_t GetTimestamp(); // nanoseconds
+static unsigned RegisterZone(const char* Name);
+static void BeginZone(unsigned ZoneId);
+static void EndZone(unsigned ZoneId);
+static void EndFrame();
+static unsigned GetZoneCount();
+static bool GetZoneStats(unsigned ZoneId,
+                         TZoneStats& OutStats);
+static void ShowWindow();
+
+struct TScopedZone
+{
+    unsigned ZoneId;
+    TScopedZone(unsigned Id) : ZoneId(Id) { BeginZone(Id); }
+    ~TScopedZone() { EndZone(ZoneId); }
+};
+
+} // namespace Prof
+
+// PROF_ZONE("Name") times the rest of the enclosing scope. Defining DEMO_NO_PROFILER compiles zones out.
+#if !defined(DEMO_NO_PROFILER)
+#define PROF_CONCAT2(A, B) A##B
+#define PROF_CONCAT(A, B) PROF_CONCAT2(A, B)
+#define PROF_ZONE(Name) \
+    static const unsigned PROF_CONCAT(ProfZoneId, __LINE__) = Prof::RegisterZone(Name); \
+    Prof::TScopedZone PROF_CONCAT(ProfZone, __LINE__)(PROF_CONCAT(ProfZoneId, __LINE__))
+#else
+#define PROF_ZONE(Name)
+#endif
+
+namespace Jobs
+{
+
+static const unsigned KMaxThreads = 64;
+
+typedef void (*TJobFunc)(void* Context, unsigned Begin, unsigned End);
+
+struct TJob
+{
+    TJobFunc Func;
+    void* Context;
+    unsigned Begin;
+    unsigned End;
+};
+
+// Number of unfinished jobs that were run with this counter. Must outlive them.
+struct TCounter
+{
+    std::atomic<unsigned> Value;
+};
+
+struct TStats
+{
+    uint64_t JobCount;
+    uint64_t StealCount;
+    uint64_t InlineCount; // ran right away because the deque was full
+    uint64_t SleepCount;
+};
+
+static unsigned GetDefaultWorkerCount();
+static void Initialize(unsigned WorkerCount);
+static void Shutdown();
+static unsigned GetWorkerCount();
+static unsigned GetThreadIndex();
+
+// Run/RunAfter/Wait/ParallelFor may be called from the thread that called Initialize() and from jobs.
+static void Run(const TJob* Jobs,
+                unsigned Count,
+                TCounter* Counter);
+static void RunAfter(TCounter* Dependency,
+                     const TJob* Jobs,
+                     unsigned Count,
+                     TCounter* Counter);
+static void Wait(TCounter* Counter);
+static void ParallelFor(unsigned Count,
+                        unsigned Grain,
+                        TJobFunc Func,
+                        void* Context);
+static TStats GetStats();
+
+} // namespace Jobs
+
+namespace Load
+{
+
+// A file requested with Request(). The I/O thread reads it into Data, then Decode (if any) runs on a
+// job thread and Complete on the main thread, from Update(). Data is freed after Complete unless it
+// takes the buffer (sets Data to nullptr and later calls free()). Files in the mounted archive skip the
+// I/O thread: stored ones are served from its mapping, compressed ones are decompressed by their decode job.
+struct TAsset
+{
+    char FileName[260];
+    uint8_t* Data;
+    size_t Size;
+    bool Failed; // couldn't be opened or read; Data is nullptr
+    bool Mapped; // Data points into the mounted archive: valid until Shutdown(), never freed
+    void* Context;
+    void* Decoded; // for Decode to hand its result to Complete
+};
+
+typedef void (*TDecodeFunc)(TAsset& Asset);
+typedef void (*TCompleteFunc)(TAsset& Asset);
+
+struct TStats
+{
+    uint64_t RequestCount;
+    uint64_t CompleteCount;
+    uint64_t BatchCount; // reads submitted together by the I/O thread
+    uint64_t ByteCount;
+    uint64_t ArchiveCount; // served from the mounted archive
+    bool IoUring; // reads go through io_uring instead of blocking reader threads
+};
+
+// Starts the I/O thread: one submitting batches to io_uring where the kernel supports it (and
+// AllowIoUring is set), otherwise a few threads doing blocking reads. Jobs must be initialized.
+static void Initialize(bool AllowIoUring);
+static void Shutdown();
+
+// Maps a Pak archive; later requests for names in it are served from there. False if it can't be
+// opened. The archive stays mounted until Shutdown().
+static bool MountArchive(const char* FileName);
+
+// Called on the main thread; returns at once. Decode may be nullptr.
+static void Request(const char* FileName,
+                    TDecodeFunc Decode,
+                    TCompleteFunc Complete,
+                    void* Context);
+// Starts decode jobs for the files read so far and runs the completion handlers of decoded ones.
+static void Update();
+// Blocks until every request made so far has been read, then Update()s: all decode jobs are running
+// when it returns, so the caller can do other work while they finish.
+static void WaitForReads();
+// Update()s until every request made so far has completed.
+static void Flush();
+static unsigned GetPendingCount();
+static TStats GetStats();
+
+} // namespace Load
+
+namespace Cmd
+{
+
+enum ECommand : uint8_t
+{
+    KCmdSetDescriptorHeaps,
+    KCmdRSSetViewports,
+    KCmdRSSetScissorRects,
+    KCmdResourceBarrier,
+    KCmdOMSetRenderTargets,
+    KCmdClearRenderTargetView,
+    KCmdClearDepthStencilView,
+    KCmdIASetPrimitiveTopology,
+    KCmdSetPipelineState,
+    KCmdSetGraphicsRootSignature,
+    KCmdSetGraphicsRootConstantBufferView,
+    KCmdSetGraphicsRootDescriptorTable,
+    KCmdSetGraphicsRoot32BitConstant,
+    KCmdIASetVertexBuffers,
+    KCmdIASetIndexBuffer,
+    KCmdDrawInstanced,
+    KCmdDrawIndexedInstanced,
+    KCmdCopyTextureRegion,
+    KCmdClose,
+    KCmdCount
+};
+
+static const unsigned KMaxRootParameters = 8;
+
+// Last value set for each piece of filterable state. A bit in ValidMask (one per ECommand) or
+// RootValidMask (one per root parameter) means the value is known to be bound.
+struct TStateCache
+{
+    uint32_t ValidMask;
+    uint32_t RootValidMask;
+    ID3D12DescriptorHeap* DescriptorHeap;
+    D3D12_VIEWPORT Viewport;
+    D3D12_RECT ScissorRect;
+    D3D12_PRIMITIVE_TOPOLOGY Topology;
+    ID3D12PipelineState* PipelineState;
+    ID3D12RootSignature* RootSignature;
+    uint64_t RootArguments[KMaxRootParameters];
+    D3D12_VERTEX_BUFFER_VIEW VertexBuffer;
+    D3D12_INDEX_BUFFER_VIEW IndexBuffer;
+};
+
+// Commands go straight to Native when it is set (D3D12 backend), otherwise they are serialized into
+// Stream (recording backend). Counts are kept by both backends. With FilterRedundantState set, calls
+// that would rebind the state already bound on the list are dropped and counted in FilteredCounts.
+struct TCommandList
+{
+#if !defined(DEMO_HEADLESS)
+    ID3D12GraphicsCommandList2* Native;
+#endif
+    std::vector<uint8_t> Stream;
+    unsigned Counts[KCmdCount];
+    unsigned FilteredCounts[KCmdCount];
+    bool FilterRedundantState;
+    bool Open; // from the backend's BeginCommandList to Close()
+    TStateCache Cache;
+};
+
+static void Reset(TCommandList& List);
+static void Replay(const TCommandList& Source,
+                   TCommandList& Target);
+static unsigned GetCallCount(const TCommandList& List);
+static unsigned GetStateChangeCount(const TCommandList& List);
+static unsigned GetFilteredCount(const TCommandList& List);
+static const char* GetCommandName(ECommand Command);
+
+static void SetDescriptorHeaps(TCommandList& List,
+                               ID3D12DescriptorHeap* Heap);
+static void RSSetViewports(TCommandList& List,
+                           const D3D12_VIEWPORT& Viewport);
+static void RSSetScissorRects(TCommandList& List,
+                              const D3D12_RECT& Rect);
+static void ResourceBarrier(TCommandList& List,
+                            ID3D12Resource* Resource,
+                            D3D12_RESOURCE_STATES StateBefore,
+                            D3D12_RESOURCE_STATES StateAfter);
+static void OMSetRenderTargets(TCommandList& List,
+                               D3D12_CPU_DESCRIPTOR_HANDLE RenderTarget,
+                               const D3D12_CPU_DESCRIPTOR_HANDLE* DepthStencil);
+static void ClearRenderTargetView(TCommandList& List,
+                                  D3D12_CPU_DESCRIPTOR_HANDLE RenderTarget,
+                                  const float Color[4]);
+static void ClearDepthStencilView(TCommandList& List,
+                                  D3D12_CPU_DESCRIPTOR_HANDLE DepthStencil,
+                                  float Depth);
+static void IASetPrimitiveTopology(TCommandList& List,
+                                   D3D12_PRIMITIVE_TOPOLOGY Topology);
+static void SetPipelineState(TCommandList& List,
+                             ID3D12PipelineState* PipelineState);
+static void SetGraphicsRootSignature(TCommandList& List,
+                                     ID3D12RootSignature* RootSignature);
+static void SetGraphicsRootConstantBufferView(TCommandList& List,
+                                              unsigned RootIndex,
+                                              D3D12_GPU_VIRTUAL_ADDRESS BufferLocation);
+static void SetGraphicsRootDescriptorTable(TCommandList& List,
+                                           unsigned RootIndex,
+                                           D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor);
+static void SetGraphicsRoot32BitConstant(TCommandList& List,
+                                         unsigned RootIndex,
+                                         uint32_t Value,
+                                         unsigned DestOffset);
+static void IASetVertexBuffers(TCommandList& List,
+                               unsigned Slot,
+                               const D3D12_VERTEX_BUFFER_VIEW& View);
+static void IASetIndexBuffer(TCommandList& List,
+                             const D3D12_INDEX_BUFFER_VIEW& View);
+static void DrawInstanced(TCommandList& List,
+                          unsigned VertexCountPerInstance,
+                          unsigned InstanceCount,
+                          unsigned StartVertexLocation,
+                          unsigned StartInstanceLocation);
+static void DrawIndexedInstanced(TCommandList& List,
+                                 unsigned IndexCountPerInstance,
+                                 unsigned InstanceCount,
+                                 unsigned StartIndexLocation,
+                                 int BaseVertexLocation,
+                                 unsigned StartInstanceLocation);
+// Copies Footprint (a texture image placed in the Source buffer) into subresource 0 of Destination at
+// (DestinationX, DestinationY).
+static void CopyTextureRegion(TCommandList& List,
+                              ID3D12Resource* Destination,
+                              unsigned DestinationX,
+                              unsigned DestinationY,
+                              ID3D12Resource* Source,
+                              const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& Footprint);
+static void Close(TCommandList& List);
+
+} // namespace Cmd
+
+namespace Dx
+{
+
+static const unsigned KMaxFramesInFlight = 4;
+
+// Frame pacing, fixed at startup.
+struct TFrameSettings
+{
+    unsigned FramesInFlight; // 1-4: per-frame resource sets, i.e. frames the CPU may run ahead
+    bool LowLatency;         // wait for the GPU before sampling input instead of after submission
+};
+
+static unsigned GResolution[2];
+static unsigned GFrameIndex; // 0 .. GFramesInFlight-1
+static unsigned GFramesInFlight;
+static unsigned GDescriptorSize;
+static unsigned GDescriptorSizeRtv;
+static Cmd::TCommandList GCmdList;
+static D3D12_CPU_DESCRIPTOR_HANDLE GDepthBufferHandle;
+
+static void AllocateDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE Type,
+                                unsigned Count,
+                                D3D12_CPU_DESCRIPTOR_HANDLE& OutFirst);
+static void FreeDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE Type,
+                            D3D12_CPU_DESCRIPTOR_HANDLE First,
+                            unsigned Count);
+static const Mem::TPagedStats& GetDescriptorStats(D3D12_DESCRIPTOR_HEAP_TYPE Type);
+static void AllocateGpuDescriptors(unsigned Count,
+                                   D3D12_CPU_DESCRIPTOR_HANDLE& OutFirstCpu,
+                                   D3D12_GPU_DESCRIPTOR_HANDLE& OutFirstGpu);
+static void* AllocateGpuUploadMemory(unsigned Size,
+                                     D3D12_GPU_VIRTUAL_ADDRESS& OutGpuAddress);
+// The buffer that upload memory lives in and the offset of GpuAddress in it, for copy sources.
+static ID3D12Resource* GetUploadBuffer(D3D12_GPU_VIRTUAL_ADDRESS GpuAddress,
+                                       uint64_t& OutOffset);
+static const Mem::TRingStats& GetUploadStats();
+
+static D3D12_GPU_DESCRIPTOR_HANDLE CopyDescriptorsToGpu(unsigned Count,
+                                                        D3D12_CPU_DESCRIPTOR_HANDLE Source);
+
+// Bindless descriptors live in the shader visible heap until freed; shaders index them through the
+// table returned by GetBindlessTable().
+static uint32_t AllocateBindlessDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE Source);
+static void FreeBindlessDescriptor(uint32_t Index);
+static D3D12_GPU_DESCRIPTOR_HANDLE GetBindlessTable();
+
+// Descriptors written into the shader visible heap since initialization.
+struct TDescriptorCopyStats
+{
+    uint64_t BindlessCount;
+    uint64_t DynamicCount;
+};
+static const TDescriptorCopyStats& GetDescriptorCopyStats();
+
+static inline void GetBackBuffer(ID3D12Resource*& OutResource,
+                                 D3D12_CPU_DESCRIPTOR_HANDLE& OutHandle);
+
+static inline void SetDescriptorHeap();
+
+static void ResetCommandList();
+static void ExecuteCommandList();
+
+// Records PassCount command lists in parallel, one job per pass, and queues them in pass order after
+// what GCmdList holds so far. GCmdList then continues as a new list with no state bound, and so does
+// every pass list. Func runs on worker threads and must not wait for jobs. Descriptor and upload
+// allocation is safe from Func.
+typedef void (*TRecordFunc)(void* Context, unsigned Pass, Cmd::TCommandList& List);
+static void RecordPasses(unsigned PassCount,
+                         TRecordFunc Func,
+                         void* Context);
+
+// Lists of the last ExecuteCommandList(), in submission order. Valid until ResetCommandList().
+static const std::vector<Cmd::TCommandList*>& GetSubmittedCommandLists();
+
+static void Initialize(Plat::TWindow Window,
+                       const TFrameSettings& Settings);
+static void Shutdown();
+static void WaitForFrameLatency();
+static void PresentFrame();
+static void WaitForGpu();
+
+#if defined(DEMO_HEADLESS)
+
+// Optional GPU timeline for the null backend. Without one, a frame completes one present after it
+// was submitted and fence waits return immediately.
+struct TSimulatedGpu
+{
+    double Clock;       // seconds; advanced by the caller (CPU work) and by fence waits
+    double FrameTime;   // GPU time of every submitted frame
+    double LastEndTime; // when the last submitted frame finishes
+    double WaitTime;    // total time spent in fence waits
+};
+
+static void SetSimulatedGpu(TSimulatedGpu* Gpu);
+
+// Times since Initialize() a list was opened on a frame's allocator for a thread while another list
+// was still open on it, which D3D12 doesn't allow. Debug builds assert instead.
+static unsigned GetAllocatorConflictCount();
+
+#endif
+
+#if !defined(DEMO_HEADLESS)
+
+typedef ID3D12Device3 TDevice;
+typedef ID3D12GraphicsCommandList2 TGraphicsCommandList;
+
+static TDevice* GDevice;
+static ID3D12CommandQueue* GCmdQueue;
+static ID3D12CommandAllocator* GCmdAlloc[KMaxFramesInFlight][Jobs::KMaxThreads]; // created on first use
+static ID3D12Resource* GDepthBuffer;
+static HWND GWindow;
+static std::vector<ID3D12Resource*> GIntermediateResources;
+
+#endif
+
+} // namespace Dx
+
+namespace Gui
+{
+
+// One draw call after merging: a run of adjacent ImDrawCmds (possibly from different ImDrawLists)
+// with the same texture and a compatible clip rect, or a single user callback.
+struct TDraw
+{
+    ImVec4 ClipRect;
+    ImTextureID TextureId;
+    unsigned IndexOffset;
+    unsigned ElemCount;
+    ImDrawList* CallbackList;
+    const ImDrawCmd* CallbackCmd;
+};
+
+static void MergeDrawCommands(const ImDrawData* DrawData,
+                              void* OutIndices,
+                              unsigned IndexSize,
+                              std::vector<TDraw>& OutDraws);
+
+static void CopyVertices(const ImDrawData* DrawData,
+                         ImDrawVert* OutVertices);
+
+// Bytes of vertices and indices the last Render() took from the upload ring.
+struct TGeometryStats
+{
+    unsigned VertexSize;
+    unsigned IndexSize;
+};
+
+// Adds the font described by Config (its FontData is not used) to the empty Atlas and builds it, or
+// restores the built atlas from CacheDirectory. Cache files are named by a hash of the TTF contents,
+// the size, glyph ranges, oversampling and the other settings that change the result; a miss writes
+// one. Returns true when the cache was used.
+static bool BuildFontAtlas(ImFontAtlas* Atlas,
+                           const void* TtfData,
+                           size_t TtfSize,
+                           const ImFontConfig& Config,
+                           const char* CacheDirectory);
+
+// ImFontAtlas::ParallelFor on the job system. BuildFontAtlas() rasterizes through it.
+static void ParallelForFontAtlas(unsigned Count,
+                                 ImFontAtlasBuildTask Task,
+                                 void* TaskData);
+
+static void RequestAssets();
+static void Initialize();
+static void Shutdown();
+static void Update(float DeltaTime);
+static void Render();
+static const TGeometryStats& GetGeometryStats();
+
+} // namespace Gui
+
+namespace Sand
+{
+
+// A cell is one byte: the material in the low bits and a shade (colour variation of the grain) above
+// it. KMovedBit marks cells that already moved while a step runs; it is clear between steps.
+enum EMaterial : uint8_t
+{
+    KEmpty,
+    KWater,
+    KSand,
+    KStone,
+    KMaterialCount
+};
+
+static const uint8_t KMaterialMask = 0x07;
+static const unsigned KShadeShift = 3;
+static const uint8_t KShadeMask = 0x78;
+static const uint8_t KMovedBit = 0x80;
+
+// Chunks are KChunkSize x KChunkSize cells; the ones at the right and bottom edges may be smaller.
+static const unsigned KChunkSize = 64;
+// Stone cells on each side of a row, so the update reads neighbours (8 at a time) without checks.
+static const unsigned KBorder = 32;
+
+// How a chunk update finds and moves cells. The scalar kernel is the reference; the others test
+// 16 (SSE4.1, NEON) or 32 (AVX2) cells at a time in byte lanes and apply the falls of those cells at
+// once, with the same result.
+enum EKernel : uint8_t
+{
+    KKernelScalar,
+    KKernelSse41,
+    KKernelAvx2,
+    KKernelNeon,
+    KKernelCount
+};
+
+// Update() advances the simulation in steps of KStepTime, at most KMaxStepsPerUpdate per call.
+static const double KStepTime = 1.0 / 60.0;
+static const unsigned KMaxStepsPerUpdate = 4;
+
+// Cells [X0, X1) x [Y0, Y1); empty when X0 >= X1 or Y0 >= Y1.
+struct TRect
+{
+    int X0;
+    int Y0;
+    int X1;
+    int Y1;
+};
+
+// A chunk sleeps (the step skips it) while nothing changed since its last update, which moved nothing,
+// in the cells its update reads: its own, the column on each side of it and the row below it.
+struct TChunk
+{
+    unsigned MoveCount; // cells of the chunk that moved in the last step
+    bool Active; // updated by the last step
+    bool Woken; // cells changed outside of a step; the next step updates the chunk
+    TRect Changed; // cells the last update of the chunk changed, up to one cell outside of it
+    TRect PreviousChanged; // the same for the update before
+    TRect Dirty; // cells of the chunk changed since Render() last copied them
+};
+
+// Rows of Width cells Pitch bytes apart, each between KBorder stone cells, over one row of stone.
+// A step depends only on the cells and StepCount, so canvases painted the same way stay identical.
+struct TCanvas
+{
+    unsigned Width;
+    unsigned Height;
+    unsigned Pitch;
+    unsigned ChunkCountX;
+    unsigned ChunkCountY;
+    std::vector<uint8_t> Storage;
+    std::vector<TChunk> Chunks; // row-major
+    uint64_t StepCount;
+    double StepTime; // elapsed time not simulated yet
+    EKernel Kernel; // GetBestKernel() unless changed
+};
+
+static inline uint8_t*
+GetRow(TCanvas& Canvas, unsigned Y)
+{
+    return Canvas.Storage.data() + (size_t)Y * Canvas.Pitch + KBorder;
+}
+
+static inline const uint8_t*
+GetRow(const TCanvas& Canvas, unsigned Y)
+{
+    return Canvas.Storage.data() + (size_t)Y * Canvas.Pitch + KBorder;
+}
+
+// Whether the build has the kernel and the CPU can run it.
+static bool IsKernelSupported(EKernel Kernel);
+// The widest supported kernel, picked once.
+static EKernel GetBestKernel();
+static const char* GetKernelName(EKernel Kernel);
+// Makes an empty canvas; all of its chunks are awake and dirty.
+static void CreateCanvas(TCanvas& Canvas,
+                         unsigned Width,
+                         unsigned Height);
+// Wakes the chunks whose update reads the cells of Rect. Paint() does this itself; it's for code that
+// changes the cells directly.
+static void WakeChunks(TCanvas& Canvas,
+                       const TRect& Rect);
+// Sets the cells within Radius of the segment from (X0, Y0) to (X1, Y1), in cells, to Material.
+static void Paint(TCanvas& Canvas,
+                  float X0,
+                  float Y0,
+                  float X1,
+                  float Y1,
+                  float Radius,
+                  EMaterial Material);
+// Updates the awake chunks in four checkerboard phases, each spread over the job system; the result is
+// the same for any number of threads, and the same as updating every chunk.
+static void Step(TCanvas& Canvas);
+// Runs the steps that DeltaTime (seconds) adds up to; returns how many.
+static unsigned Update(TCanvas& Canvas,
+                       double DeltaTime);
+// Cells moved by the last step.
+static uint64_t GetMoveCount(const TCanvas& Canvas);
+// Chunks updated by the last step.
+static unsigned GetActiveChunkCount(const TCanvas& Canvas);
+static uint64_t GetHash(const TCanvas& Canvas);
+static void CountMaterials(const TCanvas& Canvas,
+                           uint64_t OutCounts[KMaterialCount]);
+// The colour (RGBA8 as stored in memory) of cell C is entry C & ~KMovedBit of the palette. Water also
+// shimmers: its red, green and blue are scaled by GetShimmerScale() / 256 of the phase at its position
+// and the shimmer frame, which advances KShimmerFrameRate times a second.
+static const unsigned KPaletteSize = 128;
+static const unsigned KShimmerPhaseCount = 64;
+static const double KShimmerFrameRate = 20.0;
+
+static void MakePalette(uint32_t OutPalette[KPaletteSize]);
+
+static inline unsigned
+GetShimmerPhase(unsigned X, unsigned Y, uint32_t Frame)
+{
+    return (X * 3 + Y * 5 + Frame * 2) & (KShimmerPhaseCount - 1);
+}
+
+static inline unsigned
+GetShimmerScale(unsigned Phase)
+{
+    return 240 + (unsigned)abs((int)Phase - (int)KShimmerPhaseCount / 2);
+}
+
+// Reference of the DisplayCanvas pixel shader: writes the colours of the cells in the rectangle at
+// shimmer frame Frame as RGBA8 rows DestinationPitch bytes apart. KKernelAvx2 looks the colours up with
+// AVX2 gathers; the other kernels use the scalar code, which the shader follows. Both give the same
+// image.
+static void ConvertToRgba(const TCanvas& Canvas,
+                          unsigned X,
+                          unsigned Y,
+                          unsigned Width,
+                          unsigned Height,
+                          void* Destination,
+                          unsigned DestinationPitch,
+                          uint32_t Frame,
+                          EKernel Kernel);
+
+// Texture copies of the last Render().
+struct TUploadStats
+{
+    unsigned CopyCount;
+    unsigned ByteCount; // cells copied, one byte each
+};
+
+// The canvas is shown full screen by the DisplayCanvas pass, from an R8_UINT texture of the cells of
+// the given size and a KPaletteSize x 1 palette texture. Render() copies the dirty cells of the canvas
+// into it, one rectangle per run of dirty chunks in a row of chunks, and makes them clean; the pass
+// looks up the colours.
+static void RequestAssets();
+static void Initialize(unsigned Width,
+                       unsigned Height);
+static void Shutdown();
+static void Render(TCanvas& Canvas);
+static const TUploadStats& GetUploadStats();
+
+} // namespace Sand
+
+namespace Lib
+{
+
+// Read-only view of a whole file. The pages are shared with the OS file cache, so nothing is copied
+// until they are touched; Data stays valid until UnmapFile(). Data is nullptr if the file can't be
+// opened or is empty.
+struct TMappedFile
+{
+    const uint8_t* Data;
+    size_t Size;
+};
+
+static TMappedFile MapFile(const char* FileName);
+static void UnmapFile(TMappedFile& File);
+// Creates the directory (not its parents); true if it exists afterwards.
+static bool MakeDirectory(const char* Path);
+
+static double GetTime();
+
+// memcpy with non-temporal stores where available, for memory the CPU won't read back (upload heaps).
+static void StreamCopy(void* Destination, const void* Source, size_t Size);
+
+// Instruction sets that code compiled with DEMO_TARGET() may use on this CPU.
+enum ECpuFeature : uint32_t
+{
+    KCpuSse41 = 0x1,
+    KCpuAvx2 = 0x2, // the OS saves the YMM registers too
+    KCpuNeon = 0x4,
+};
+
+static uint32_t GetCpuFeatures();
+
+static void UpdateFrameStats(Plat::TWindow Window,
+                             const char* Name,
+                             double& OutTime,
+                             float& OutDeltaTime);
+
+} // namespace Lib
+
+namespace Pak
+{
+
+// Packed archive: THeader, EntryCount TEntry sorted by Hash, the zero-terminated names (NamesSize
+// bytes), then the blobs, each at a KBlobAlignment aligned offset. Little-endian.
+static const uint32_t KMagic = 0x4b415044; // "DPAK"
+static const uint32_t KVersion = 1;
+static const unsigned KBlobAlignment = 64;
+
+enum EEntryFlags : uint32_t
+{
+    KEntryLz4 = 0x1, // the blob is an LZ4 block of OriginalSize bytes
+};
+
+struct THeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t EntryCount;
+    uint32_t NamesSize;
+};
+
+struct TEntry
+{
+    uint64_t Hash; // HashName() of the name
+    uint64_t Offset;
+    uint64_t Size;
+    uint64_t OriginalSize;
+    uint32_t NameOffset;
+    uint32_t Flags;
+};
+
+// An archive mapped with Open(); entries point into the mapping until Close().
+struct TArchive
+{
+    Lib::TMappedFile File;
+    const TEntry* Entries;
+    const char* Names;
+    unsigned EntryCount;
+};
+
+static uint64_t HashName(const char* Name);
+static bool Open(const char* FileName,
+                 TArchive& OutArchive);
+static void Close(TArchive& Archive);
+static const TEntry* Find(const TArchive& Archive,
+                          const char* Name);
+// Stored bytes of the entry, straight from the mapping; for compressed entries use Decompress().
+static const uint8_t* GetBlob(const TArchive& Archive,
+                              const TEntry& Entry);
+static bool Decompress(const TArchive& Archive,
+                       const TEntry& Entry,
+                       void* Out);
+
+// Packs the files, stored under their names as given. With Compress set, entries are LZ4 compressed
+// when that saves at least an eighth.
+static bool Build(const char* FileName,
+                  const char* const* Names,
+                  unsigned Count,
+                  bool Compress);
+
+static size_t CompressLz4(const void* Source,
+                          size_t Size,
+                          void* Destination,
+                          size_t Capacity);
+static bool DecompressLz4(const void* Source,
+                          size_t SourceSize,
+                          void* Destination,
+                          size_t Size);
+
+} // namespace Pak
+// vim: set ts=4 sw=4 expandtab:
@@ -1,138 +1,180 @@
-//=============================================================================
-#if defined(VS_IMGUI) || defined(PS_IMGUI)
-//=============================================================================
-
-#define KRsi \
-    "RootFlags(ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT), " \
-    "CBV(b0, visibility = SHADER_VISIBILITY_VERTEX), " \
-    "DescriptorTable(SRV(t0), visibility = SHADER_VISIBILITY_PIXEL), " \
-    "StaticSampler(s0, filter = FILTER_MIN_MAG_MIP_LINEAR, visibility = SHADER_VISIBILITY_PIXEL)"
-
-struct TVertexData
-{
-    float2 Position : POSITION;
-    float2 Texcoord : TEXCOORD0;
-    float4 Color : COLOR;
-};
-
-struct TPixelData
-{
-    float4 Position : SV_Position;
-    float2 Texcoord : TEXCOORD0;
-    float4 Color : COLOR;
-};
-
-#if defined(VS_IMGUI)
-
-struct TConstantData
-{
-    float4x4 Matrix;
-};
-ConstantBuffer<TConstantData> GCbv : register(b0);
-
-[RootSignature(KRsi)]
-TPixelData
-VertexMain(TVertexData Input)
-{
-    TPixelData Output;
-    Output.Position = mul(float4(Input.Position, 0.0f, 1.0f), GCbv.Matrix);
-    Output.Texcoord = Input.Texcoord;
-    Output.Color = Input.Color;
-    return Output;
-}
-
-#elif defined(PS_IMGUI)
-
-Texture2D GGuiSrv : register(t0);
-SamplerState GGuiSam : register(s0);
-
-[RootSignature(KRsi)]
-float4
-PixelMain(TPixelData Input) : SV_Target0
-{
-    return Input.Color * GGuiSrv.Sample(GGuiSam, Input.Texcoord);
-}
-
-#endif
-//=============================================================================
-#elif defined(VS_DISPLAY_CANVAS) || defined(PS_DISPLAY_CANVAS)
-//=============================================================================
-
-#define KRsi \
-    "RootFlags(0), " \
-    "DescriptorTable(SRV(t0), visibility = SHADER_VISIBILITY_PIXEL), " \
-    "StaticSampler(s0, filter = FILTER_MIN_MAG_MIP_LINEAR, visibility = SHADER_VISIBILITY_PIXEL)"
-
-struct TPixelData
-{
-    float4 Position : SV_Position;
-    float2 Texcoord : TEXCOORD0;
-};
-
-#if defined(VS_DISPLAY_CANVAS)
-
-[RootSignature(KRsi)]
-TPixelData
-VertexMain(uint VertexId : SV_VertexID)
-{
-    float2 Positions[] = { float2(-1.0f, -1.0f), float2(-1.0f, 3.0f), float2(3.0f, -1.0f) };
-    TPixelData Output;
-    Output.Position = float4(Positions[VertexId], 0.0f, 1.0f);
-    Output.Texcoord = 0.5f + 0.5f * Positions[VertexId];
-    return Output;
-}
-
-#elif defined(PS_DISPLAY_CANVAS)
-
-Texture2D GCanvasSrv : register(t0);
-SamplerState GCanvasSam : register(s0);
-
-[RootSignature(KRsi)]
-float4
-PixelMain(TPixelData Input) : SV_Target0
-{
-    return GCanvasSrv.Sample(GCanvasSam, Input.Texcoord);
-}
-
-#endif
-//=============================================================================
-#elif defined(VS_SAND) || defined(PS_SAND)
-//=============================================================================
-
-#define KRsi \
-    "RootFlags(ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT)"
-
-struct TVertexData
-{
-    float2 Position : POSITION;
-};
-
-struct TPixelData
-{
-    float4 Position : SV_Position;
-};
-
-#if defined(VS_SAND)
-
-[RootSignature(KRsi)]
-TPixelData
-VertexMain(TVertexData Input)
-{
-    TPixelData Output;
-    Output.Position = float4(Input.Position, 0.0f, 1.0f);
-    return Output;
-}
-
-#elif defined(PS_SAND)
-
-[RootSignature(KRsi)]
-float4
-PixelMain(TPixelData Input) : SV_Target0
-{
-    return float4(0.0f, 0.0f, 0.0f, 0.01f);
-}
-
-#endif
-//=============================================================================
-#endif
-// vim: set ts=4 sw=4 expandtab:
+// Bindless textures (Dx::AllocateBindlessDescriptor), bound as one table starting at t0. Draws pick a
+// texture with a root constant.
+#define KRsiBindlessTable \
+    "DescriptorTable(SRV(t0, numDescriptors = unbounded, flags = DESCRIPTORS_VOLATILE), " \
+    "visibility = SHADER_VISIBILITY_PIXEL)"
+
+Texture2D GTextures[] : register(t0);
+
+//=============================================================================
+#if defined(VS_IMGUI) || defined(PS_IMGUI)
+//=============================================================================
+
+#define KRsi \
+    "RootFlags(ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT), " \
+    "CBV(b0, visibility = SHADER_VISIBILITY_VERTEX), " \
+    KRsiBindlessTable ", " \
+    "RootConstants(b1, num32BitConstants = 1, visibility = SHADER_VISIBILITY_PIXEL), " \
+    "StaticSampler(s0, filter = FILTER_MIN_MAG_MIP_LINEAR, visibility = SHADER_VISIBILITY_PIXEL)"
+
+struct TVertexData
+{
+    float2 Position : POSITION;
+    float2 Texcoord : TEXCOORD0;
+    float4 Color : COLOR;
+};
+
+struct TPixelData
+{
+    float4 Position : SV_Position;
+    float2 Texcoord : TEXCOORD0;
+    float4 Color : COLOR;
+};
+
+#if defined(VS_IMGUI)
+
+struct TConstantData
+{
+    float4x4 Matrix;
+};
+ConstantBuffer<TConstantData> GCbv : register(b0);
+
+[RootSignature(KRsi)]
+TPixelData
+VertexMain(TVertexData Input)
+{
+    TPixelData Output;
+    Output.Position = mul(float4(Input.Position, 0.0f, 1.0f), GCbv.Matrix);
+    Output.Texcoord = Input.Texcoord;
+    Output.Color = Input.Color;
+    return Output;
+}
+
+#elif defined(PS_IMGUI)
+
+struct TDrawData
+{
+    uint TextureIndex;
+};
+ConstantBuffer<TDrawData> GDraw : register(b1);
+SamplerState GGuiSam : register(s0);
+
+// The font atlas is an R8 texture whose view swizzles the coverage into alpha and reads 1 for the
+// color channels, so it samples like any RGBA image texture and needs no branch here.
+[RootSignature(KRsi)]
+float4
+PixelMain(TPixelData Input) : SV_Target0
+{
+    return Input.Color * GTextures[GDraw.TextureIndex].Sample(GGuiSam, Input.Texcoord);
+}
+
+#endif
+//=============================================================================
+#elif defined(VS_DISPLAY_CANVAS) || defined(PS_DISPLAY_CANVAS)
+//=============================================================================
+
+// The bindless table a second time in space1, where the texture of the cells is read as uint.
+#define KRsi \
+    "RootFlags(0), " \
+    "DescriptorTable(SRV(t0, numDescriptors = unbounded, flags = DESCRIPTORS_VOLATILE), " \
+    "SRV(t0, space = 1, numDescriptors = unbounded, offset = 0, flags = DESCRIPTORS_VOLATILE), " \
+    "visibility = SHADER_VISIBILITY_PIXEL), " \
+    "RootConstants(b0, num32BitConstants = 3, visibility = SHADER_VISIBILITY_PIXEL)"
+
+struct TPixelData
+{
+    float4 Position : SV_Position;
+};
+
+#if defined(VS_DISPLAY_CANVAS)
+
+[RootSignature(KRsi)]
+TPixelData
+VertexMain(uint VertexId : SV_VertexID)
+{
+    float2 Positions[] = { float2(-1.0f, -1.0f), float2(-1.0f, 3.0f), float2(3.0f, -1.0f) };
+    TPixelData Output;
+    Output.Position = float4(Positions[VertexId], 0.0f, 1.0f);
+    return Output;
+}
+
+#elif defined(PS_DISPLAY_CANVAS)
+
+struct TDrawData
+{
+    uint TextureIndex;
+    uint PaletteTextureIndex;
+    uint ShimmerFrame;
+};
+ConstantBuffer<TDrawData> GDraw : register(b0);
+Texture2D<uint> GCellTextures[] : register(t0, space1);
+
+// Sand::KMaterialMask, Sand::KWater, Sand::KPaletteSize and Sand::KShimmerPhaseCount.
+static const uint KMaterialMask = 0x07;
+static const uint KWater = 1;
+static const uint KPaletteSize = 128;
+static const uint KShimmerPhaseCount = 64;
+
+// The texture has one cell per pixel, row 0 at the top of the screen. Colours are computed in integers
+// the way Sand::ConvertToRgba() does it, so the CPU reference gives the same image.
+[RootSignature(KRsi)]
+float4
+PixelMain(TPixelData Input) : SV_Target0
+{
+    const uint2 Position = uint2(Input.Position.xy);
+    const uint Cell = GCellTextures[GDraw.TextureIndex].Load(int3(Position, 0));
+    const float4 Entry = GTextures[GDraw.PaletteTextureIndex].Load(int3(Cell & (KPaletteSize - 1), 0, 0));
+    uint3 Color = uint3(round(Entry.rgb * 255.0f));
+
+    // Sand::GetShimmerPhase() and Sand::GetShimmerScale().
+    if ((Cell & KMaterialMask) == KWater)
+    {
+        const uint Phase = (Position.x * 3 + Position.y * 5 + GDraw.ShimmerFrame * 2) & (KShimmerPhaseCount - 1);
+        const uint Scale = 240 + (uint)abs((int)Phase - (int)KShimmerPhaseCount / 2);
+        Color = min((Color * Scale) >> 8, 255);
+    }
+    return float4(Color / 255.0f, 1.0f);
+}
+
+#endif
+//=============================================================================
+#elif defined(VS_SAND) || defined(PS_SAND)
+//=============================================================================
+
+#define KRsi \
+    "RootFlags(ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT)"
+
+struct TVertexData
+{
+    float2 Position : POSITION;
+};
+
+struct TPixelData
+{
+    float4 Position : SV_Position;
+};
+
+#if defined(VS_SAND)
+
+[RootSignature(KRsi)]
+TPixelData
+VertexMain(TVertexData Input)
+{
+    TPixelData Output;
+    Output.Position = float4(Input.Position, 0.0f, 1.0f);
+    return Output;
+}
+
+#elif defined(PS_SAND)
+
+[RootSignature(KRsi)]
+float4
+PixelMain(TPixelData Input) : SV_Target0
+{
+    return float4(0.0f, 0.0f, 0.0f, 0.01f);
+}
+
+#endif
+//=============================================================================
+#endif
+// vim: set ts=4 sw=4 expandtab:
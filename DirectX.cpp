@@ -0,0 +1,533 @@
+namespace Dx
+{
+namespace Priv
+{
+
+struct TDescriptorHeap
+{
+    ID3D12DescriptorHeap* Heap;
+    D3D12_CPU_DESCRIPTOR_HANDLE CpuStart;
+    D3D12_GPU_DESCRIPTOR_HANDLE GpuStart;
+    unsigned Size;
+    unsigned Capacity;
+};
+
+struct TGpuMemoryHeap
+{
+    ID3D12Resource* Heap;
+    uint8_t* CpuStart;
+    D3D12_GPU_VIRTUAL_ADDRESS GpuStart;
+    unsigned Size;
+    unsigned Capacity;
+};
+
+// CPU-only descriptors (RTV, DSV and non-shader visible CBV/SRV/UAV), indexed by heap type. Pages are
+// separate descriptor heaps, created when the allocator first hands out an index in them. A page spans
+// PageSize * DescriptorSize bytes of handles; PageByBlock maps the span-sized block its CpuStart falls in
+// to its index, so a handle's page is in the handle's block or the one before.
+struct TDescriptorPool
+{
+    Mem::TPagedAllocator Allocator;
+    std::vector<TDescriptorHeap> Pages;
+    std::unordered_map<size_t, unsigned> PageByBlock;
+    unsigned DescriptorSize;
+};
+static TDescriptorPool GDescriptorPools[4];
+
+// One shader visible heap: bindless descriptors with stable indices first, then one range of
+// dynamic (per-frame) descriptors for each frame. GDynamicDescriptors are views into that heap.
+static TDescriptorHeap GShaderVisibleHeap;
+static TDescriptorHeap GDynamicDescriptors[KMaxFramesInFlight];
+static std::atomic<unsigned> GDynamicDescriptorCounts[KMaxFramesInFlight];
+static Mem::TPagedAllocator GBindlessAllocator;
+static const unsigned KBindlessCapacity = 4096;
+static const unsigned KDynamicDescriptorCapacity = 10000;
+static TDescriptorCopyStats GDescriptorCopyStats;
+static std::atomic<uint64_t> GDynamicCopyCount;
+
+// Guards the descriptor pools and the bindless allocator, which jobs recording passes may use.
+static std::mutex GDescriptorMutex;
+
+// upload memory, shared by all frames in flight
+static TGpuMemoryHeap GUploadMemoryHeap;
+static Mem::TRingAllocator GUploadRing;
+static const unsigned KUploadRingCapacity = 16*1024*1024;
+
+// Allocations up to a quarter of a slice come from a slice of the ring owned by the allocating thread
+// for the current frame; only taking a new slice (and larger allocations) locks GUploadMutex.
+struct alignas(64) TUploadSlice
+{
+    uint64_t Offset;
+    uint64_t FrameCount; // GFrameCount when taken
+    unsigned Used;
+};
+static const unsigned KUploadSliceSize = 64*1024;
+static TUploadSlice GUploadSlices[Jobs::KMaxThreads];
+static std::mutex GUploadMutex;
+
+// Command lists. RecordPasses() splits GCmdList into segments; segments and pass lists are pooled
+// across frames. GSubmitLists is the frame's submission order, GCmdList last.
+static std::vector<Cmd::TCommandList*> GSegmentLists;
+static std::vector<Cmd::TCommandList*> GPassLists;
+static unsigned GSegmentCount;
+static unsigned GPassCount;
+static std::vector<Cmd::TCommandList*> GSubmitLists;
+
+static ID3D12Resource* GSwapBuffers[4];
+static D3D12_CPU_DESCRIPTOR_HANDLE GSwapBufferHandles[4];
+
+static uint64_t GFrameCount;
+static unsigned GBackBufferIndex;
+
+// Fence value signaled at the end of the frame that last used each set of per-frame resources, and
+// of the two most recently submitted frames.
+static uint64_t GFrameFenceValues[KMaxFramesInFlight];
+static uint64_t GLastFrameFenceValues[2];
+static bool GLowLatency;
+
+// Frame fence, implemented by the backend.
+static uint64_t GetCompletedFrameCount(void* Context);
+static void WaitForFrameCount(void* Context, uint64_t FrameCount);
+
+// Blocks until the swap chain can queue another frame (low latency mode), implemented by the backend.
+static void WaitForSwapChain();
+
+// Descriptor heap pages and copies, implemented by the backend.
+static void CreateDescriptorPage(D3D12_DESCRIPTOR_HEAP_TYPE Type, unsigned Capacity, TDescriptorHeap& OutPage);
+static void ReleaseDescriptorPage(TDescriptorHeap& Page);
+static void CopyDescriptors(unsigned Count, D3D12_CPU_DESCRIPTOR_HANDLE Destination,
+                            D3D12_CPU_DESCRIPTOR_HANDLE Source);
+
+// Command lists, implemented by the backend. CreateCommandList makes a closed list; BeginCommandList
+// opens it with the calling thread's allocator for the current frame.
+static void CreateCommandList(Cmd::TCommandList& List);
+static void ReleaseCommandList(Cmd::TCommandList& List);
+static void BeginCommandList(Cmd::TCommandList& List);
+
+static void
+InitializeFramePacing(const TFrameSettings& Settings)
+{
+    assert(Settings.FramesInFlight >= 1 && Settings.FramesInFlight <= KMaxFramesInFlight);
+    GFramesInFlight = Settings.FramesInFlight;
+    GLowLatency = Settings.LowLatency;
+    GFrameIndex = 0;
+    GFrameCount = 0;
+    memset(GFrameFenceValues, 0, sizeof(GFrameFenceValues));
+    memset(GLastFrameFenceValues, 0, sizeof(GLastFrameFenceValues));
+    for (TUploadSlice& Slice : GUploadSlices)
+        Slice.FrameCount = ~0ull;
+}
+
+static unsigned
+GetShaderVisibleCapacity()
+{
+    return KBindlessCapacity + GFramesInFlight * KDynamicDescriptorCapacity;
+}
+
+// Splits GShaderVisibleHeap, which the backend has created with GetShaderVisibleCapacity() descriptors.
+static void
+InitializeShaderVisibleRanges()
+{
+    assert(GShaderVisibleHeap.Capacity == GetShaderVisibleCapacity());
+    Mem::InitializePaged(GBindlessAllocator, KBindlessCapacity, 1);
+    memset(&GDescriptorCopyStats, 0, sizeof(GDescriptorCopyStats));
+    GDynamicCopyCount = 0;
+
+    for (unsigned Index = 0; Index < GFramesInFlight; ++Index)
+    {
+        const unsigned First = KBindlessCapacity + Index * KDynamicDescriptorCapacity;
+
+        TDescriptorHeap& Range = GDynamicDescriptors[Index];
+        Range.Heap = GShaderVisibleHeap.Heap;
+        Range.CpuStart.ptr = GShaderVisibleHeap.CpuStart.ptr + First * GDescriptorSize;
+        Range.GpuStart.ptr = GShaderVisibleHeap.GpuStart.ptr + First * GDescriptorSize;
+        Range.Size = 0;
+        Range.Capacity = KDynamicDescriptorCapacity;
+        GDynamicDescriptorCounts[Index] = 0;
+    }
+}
+
+static void
+InitializeDescriptorPools()
+{
+    const unsigned PageSizes[4] = { 1024, 0, 64, 64 };
+    for (unsigned Type = 0; Type < 4; ++Type)
+    {
+        if (PageSizes[Type] == 0)
+            continue;
+
+        TDescriptorPool& Pool = GDescriptorPools[Type];
+        Mem::InitializePaged(Pool.Allocator, PageSizes[Type], 0);
+        Pool.Pages.clear();
+        Pool.PageByBlock.clear();
+        Pool.DescriptorSize = (Type == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV) ? GDescriptorSize : GDescriptorSizeRtv;
+    }
+}
+
+static void
+ShutdownDescriptorPools()
+{
+    for (TDescriptorPool& Pool : GDescriptorPools)
+    {
+        for (TDescriptorHeap& Page : Pool.Pages)
+            ReleaseDescriptorPage(Page);
+        Pool.Pages.clear();
+        Pool.PageByBlock.clear();
+    }
+}
+
+// Returns descriptors freed during frames the GPU has finished to the free lists.
+static void
+RetireDescriptors()
+{
+    const uint64_t CompletedFrameCount = GetCompletedFrameCount(nullptr);
+    std::lock_guard<std::mutex> Lock(GDescriptorMutex);
+    for (TDescriptorPool& Pool : GDescriptorPools)
+        Mem::RetirePaged(Pool.Allocator, CompletedFrameCount);
+    Mem::RetirePaged(GBindlessAllocator, CompletedFrameCount);
+}
+
+// Called by the backend's PresentFrame once the frame's fence value is signaled. Moves on to the
+// next set of per-frame resources; outside of low latency mode, also waits for the GPU to release it.
+static void
+AdvanceFrame(uint64_t FenceValue)
+{
+    GFrameFenceValues[GFrameIndex] = FenceValue;
+    GLastFrameFenceValues[0] = GLastFrameFenceValues[1];
+    GLastFrameFenceValues[1] = FenceValue;
+    Mem::EndRingFrame(GUploadRing, FenceValue);
+
+    GFrameIndex = (GFrameIndex + 1) % GFramesInFlight;
+    if (!GLowLatency)
+        WaitForFrameCount(nullptr, GFrameFenceValues[GFrameIndex]);
+
+    GDynamicDescriptorCounts[GFrameIndex] = 0;
+    RetireDescriptors();
+}
+
+static Cmd::TCommandList*
+GetPooledCommandList(std::vector<Cmd::TCommandList*>& Pool, unsigned Index)
+{
+    while (Index >= Pool.size())
+    {
+        Cmd::TCommandList* List = new Cmd::TCommandList();
+        List->FilterRedundantState = true;
+        CreateCommandList(*List);
+        Pool.push_back(List);
+    }
+    return Pool[Index];
+}
+
+// Called by the backend's ResetCommandList (and Initialize) before GCmdList is opened.
+static void
+BeginFrameCommandLists()
+{
+    GSubmitLists.clear();
+    GSegmentCount = 0;
+    GPassCount = 0;
+}
+
+static void
+ShutdownCommandLists()
+{
+    for (std::vector<Cmd::TCommandList*>* Pool : { &GSegmentLists, &GPassLists })
+    {
+        for (Cmd::TCommandList* List : *Pool)
+        {
+            ReleaseCommandList(*List);
+            delete List;
+        }
+        Pool->clear();
+    }
+    GSubmitLists.clear();
+}
+
+// Closes and queues what GCmdList holds so far. GCmdList is then a closed list; reopen it with
+// BeginCommandList once no other list is open on this thread's allocator.
+static void
+SplitCommandList()
+{
+    Cmd::Close(GCmdList);
+    Cmd::TCommandList* Segment = GetPooledCommandList(GSegmentLists, GSegmentCount++);
+    std::swap(*Segment, GCmdList);
+    GSubmitLists.push_back(Segment);
+}
+
+struct TRecordPasses
+{
+    TRecordFunc Func;
+    void* Context;
+    unsigned FirstList;
+};
+
+static void
+RecordPassRange(void* Context, unsigned Begin, unsigned End)
+{
+    const TRecordPasses& Record = *(const TRecordPasses*)Context;
+    for (unsigned Pass = Begin; Pass < End; ++Pass)
+    {
+        Cmd::TCommandList& List = *GPassLists[Record.FirstList + Pass];
+        BeginCommandList(List);
+        Record.Func(Record.Context, Pass, List);
+        Cmd::Close(List);
+    }
+}
+
+static TDescriptorPool&
+GetDescriptorPool(D3D12_DESCRIPTOR_HEAP_TYPE Type)
+{
+    assert(Type == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV || Type == D3D12_DESCRIPTOR_HEAP_TYPE_RTV ||
+           Type == D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+    return GDescriptorPools[Type];
+}
+
+// Returns the index of the page holding the handle, or UINT32_MAX if it isn't from the pool.
+static unsigned
+FindDescriptorPage(const TDescriptorPool& Pool, D3D12_CPU_DESCRIPTOR_HANDLE Handle)
+{
+    const size_t Span = (size_t)Pool.Allocator.PageSize * Pool.DescriptorSize;
+    const size_t Block = Handle.ptr / Span;
+    const size_t Candidates[2] = { Block, Block - 1 };
+    for (unsigned Index = 0; Index < (Block ? 2u : 1u); ++Index)
+    {
+        const auto Found = Pool.PageByBlock.find(Candidates[Index]);
+        if (Found == Pool.PageByBlock.end())
+            continue;
+        const size_t Start = Pool.Pages[Found->second].CpuStart.ptr;
+        if (Handle.ptr >= Start && Handle.ptr < Start + Span)
+            return Found->second;
+    }
+    return UINT32_MAX;
+}
+
+} // namespace Priv
+
+static void
+AllocateDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE Type, unsigned Count, D3D12_CPU_DESCRIPTOR_HANDLE& OutFirst)
+{
+    Priv::TDescriptorPool& Pool = Priv::GetDescriptorPool(Type);
+    std::lock_guard<std::mutex> Lock(Priv::GDescriptorMutex);
+
+    uint32_t Index;
+    if (!Mem::AllocatePaged(Pool.Allocator, Count, Index))
+    {
+        assert(0);
+        OutFirst.ptr = 0;
+        return;
+    }
+
+    const unsigned PageSize = Pool.Allocator.PageSize;
+    while (Index / PageSize >= Pool.Pages.size())
+    {
+        Pool.Pages.push_back({});
+        Priv::CreateDescriptorPage(Type, PageSize, Pool.Pages.back());
+        const size_t Span = (size_t)PageSize * Pool.DescriptorSize;
+        Pool.PageByBlock[Pool.Pages.back().CpuStart.ptr / Span] = (unsigned)Pool.Pages.size() - 1;
+    }
+
+    OutFirst.ptr = Pool.Pages[Index / PageSize].CpuStart.ptr + (Index % PageSize) * Pool.DescriptorSize;
+}
+
+// The descriptors are reused once the GPU has finished the frame being recorded.
+static void
+FreeDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE Type, D3D12_CPU_DESCRIPTOR_HANDLE First, unsigned Count)
+{
+    Priv::TDescriptorPool& Pool = Priv::GetDescriptorPool(Type);
+    std::lock_guard<std::mutex> Lock(Priv::GDescriptorMutex);
+
+    const unsigned Page = Priv::FindDescriptorPage(Pool, First);
+    if (Page == UINT32_MAX)
+    {
+        assert(0);
+        return;
+    }
+
+    const size_t Offset = First.ptr - Pool.Pages[Page].CpuStart.ptr;
+    const uint32_t Index = Page * Pool.Allocator.PageSize + (uint32_t)(Offset / Pool.DescriptorSize);
+    Mem::DeferFreePaged(Pool.Allocator, Index, Count, Priv::GFrameCount + 1);
+}
+
+static const Mem::TPagedStats&
+GetDescriptorStats(D3D12_DESCRIPTOR_HEAP_TYPE Type)
+{
+    return Priv::GetDescriptorPool(Type).Allocator.Stats;
+}
+
+static void
+AllocateGpuDescriptors(unsigned Count, D3D12_CPU_DESCRIPTOR_HANDLE& OutFirstCpu, D3D12_GPU_DESCRIPTOR_HANDLE& OutFirstGpu)
+{
+    const Priv::TDescriptorHeap& DescriptorHeap = Priv::GDynamicDescriptors[GFrameIndex];
+    const unsigned First = Priv::GDynamicDescriptorCounts[GFrameIndex].fetch_add(Count, std::memory_order_relaxed);
+
+    assert((First + Count) < DescriptorHeap.Capacity);
+
+    OutFirstCpu.ptr = DescriptorHeap.CpuStart.ptr + First * GDescriptorSize;
+    OutFirstGpu.ptr = DescriptorHeap.GpuStart.ptr + First * GDescriptorSize;
+}
+
+static inline void
+GetBackBuffer(ID3D12Resource*& OutResource, D3D12_CPU_DESCRIPTOR_HANDLE& OutHandle)
+{
+    OutResource = Priv::GSwapBuffers[Priv::GBackBufferIndex];
+    OutHandle = Priv::GSwapBufferHandles[Priv::GBackBufferIndex];
+}
+
+// Call before sampling input. In low latency mode this is where the CPU waits for the GPU: for the swap
+// chain, whose maximum frame latency of 1 lets it go once the last presented frame is done, so no frame
+// is queued ahead of the one about to read input; then, should the swap chain return early, for the
+// per-frame resources and all but the last submitted frame. Otherwise the wait happened in PresentFrame.
+static void
+WaitForFrameLatency()
+{
+    if (!Priv::GLowLatency)
+        return;
+
+    Priv::WaitForSwapChain();
+    Priv::WaitForFrameCount(nullptr, std::max(Priv::GFrameFenceValues[GFrameIndex], Priv::GLastFrameFenceValues[0]));
+    Priv::RetireDescriptors();
+}
+
+static inline void
+SetDescriptorHeap()
+{
+    Cmd::SetDescriptorHeaps(GCmdList, Priv::GShaderVisibleHeap.Heap);
+}
+
+static D3D12_GPU_DESCRIPTOR_HANDLE
+CopyDescriptorsToGpu(unsigned Count, D3D12_CPU_DESCRIPTOR_HANDLE Source)
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE DestinationCpu;
+    D3D12_GPU_DESCRIPTOR_HANDLE DestinationGpu;
+    AllocateGpuDescriptors(Count, DestinationCpu, DestinationGpu);
+
+    Priv::CopyDescriptors(Count, DestinationCpu, Source);
+    Priv::GDynamicCopyCount.fetch_add(Count, std::memory_order_relaxed);
+    return DestinationGpu;
+}
+
+static uint32_t
+AllocateBindlessDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE Source)
+{
+    std::lock_guard<std::mutex> Lock(Priv::GDescriptorMutex);
+
+    uint32_t Index;
+    if (!Mem::AllocatePaged(Priv::GBindlessAllocator, 1, Index))
+    {
+        assert(0);
+        return 0;
+    }
+
+    D3D12_CPU_DESCRIPTOR_HANDLE Destination = Priv::GShaderVisibleHeap.CpuStart;
+    Destination.ptr += Index * GDescriptorSize;
+    Priv::CopyDescriptors(1, Destination, Source);
+    Priv::GDescriptorCopyStats.BindlessCount++;
+    return Index;
+}
+
+// The index is reused once the GPU has finished the frame being recorded.
+static void
+FreeBindlessDescriptor(uint32_t Index)
+{
+    std::lock_guard<std::mutex> Lock(Priv::GDescriptorMutex);
+    Mem::DeferFreePaged(Priv::GBindlessAllocator, Index, 1, Priv::GFrameCount + 1);
+}
+
+static D3D12_GPU_DESCRIPTOR_HANDLE
+GetBindlessTable()
+{
+    return Priv::GShaderVisibleHeap.GpuStart;
+}
+
+static const TDescriptorCopyStats&
+GetDescriptorCopyStats()
+{
+    Priv::GDescriptorCopyStats.DynamicCount = Priv::GDynamicCopyCount.load(std::memory_order_relaxed);
+    return Priv::GDescriptorCopyStats;
+}
+
+static void*
+AllocateGpuUploadMemory(unsigned Size, D3D12_GPU_VIRTUAL_ADDRESS& OutGpuAddress)
+{
+    assert(Size > 0);
+
+    if (Size & 0xff) // always align to 256 bytes
+        Size = (Size + 255) & ~0xff;
+
+    uint64_t Offset;
+    if (Size <= Priv::KUploadSliceSize / 4)
+    {
+        Priv::TUploadSlice& Slice = Priv::GUploadSlices[Jobs::GetThreadIndex()];
+        if (Slice.FrameCount != Priv::GFrameCount || Slice.Used + Size > Priv::KUploadSliceSize)
+        {
+            std::lock_guard<std::mutex> Lock(Priv::GUploadMutex);
+            if (!Mem::AllocateRing(Priv::GUploadRing, Priv::KUploadSliceSize, 256, Slice.Offset))
+            {
+                assert(0);
+                return nullptr;
+            }
+            Slice.FrameCount = Priv::GFrameCount;
+            Slice.Used = 0;
+        }
+        Offset = Slice.Offset + Slice.Used;
+        Slice.Used += Size;
+    }
+    else
+    {
+        std::lock_guard<std::mutex> Lock(Priv::GUploadMutex);
+        if (!Mem::AllocateRing(Priv::GUploadRing, Size, 256, Offset))
+        {
+            assert(0);
+            return nullptr;
+        }
+    }
+
+    const Priv::TGpuMemoryHeap& UploadHeap = Priv::GUploadMemoryHeap;
+    OutGpuAddress = UploadHeap.GpuStart + Offset;
+    return UploadHeap.CpuStart + Offset;
+}
+
+static ID3D12Resource*
+GetUploadBuffer(D3D12_GPU_VIRTUAL_ADDRESS GpuAddress, uint64_t& OutOffset)
+{
+    const Priv::TGpuMemoryHeap& UploadHeap = Priv::GUploadMemoryHeap;
+    assert(GpuAddress >= UploadHeap.GpuStart && GpuAddress < UploadHeap.GpuStart + UploadHeap.Capacity);
+    OutOffset = GpuAddress - UploadHeap.GpuStart;
+    return UploadHeap.Heap;
+}
+
+static const Mem::TRingStats&
+GetUploadStats()
+{
+    return Priv::GUploadRing.Stats;
+}
+
+static void
+RecordPasses(unsigned PassCount, TRecordFunc Func, void* Context)
+{
+    if (PassCount == 0)
+        return;
+
+    Priv::SplitCommandList();
+
+    // The pool only grows here, on the calling thread, before the jobs look at it.
+    const Priv::TRecordPasses Record = { Func, Context, Priv::GPassCount };
+    Priv::GetPooledCommandList(Priv::GPassLists, Priv::GPassCount + PassCount - 1);
+    Priv::GPassCount += PassCount;
+
+    // This thread records passes too, on the allocator GCmdList uses, so GCmdList stays closed until
+    // every pass list is.
+    Jobs::ParallelFor(PassCount, 1, Priv::RecordPassRange, (void*)&Record);
+
+    for (unsigned Pass = 0; Pass < PassCount; ++Pass)
+        Priv::GSubmitLists.push_back(Priv::GPassLists[Record.FirstList + Pass]);
+    Priv::BeginCommandList(GCmdList);
+}
+
+static const std::vector<Cmd::TCommandList*>&
+GetSubmittedCommandLists()
+{
+    return Priv::GSubmitLists;
+}
+
+} // namespace Dx
+// vim: set ts=4 sw=4 expandtab:
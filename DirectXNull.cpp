@@ -0,0 +1,241 @@
+namespace Dx
+{
+namespace Priv
+{
+
+// Stand-ins for the device objects; only their addresses are recorded into command lists.
+static ID3D12DescriptorHeap GNullShaderVisibleHeap;
+static ID3D12Resource GNullSwapBuffers[4];
+static ID3D12Resource GNullUploadBuffer;
+static std::vector<uint8_t> GNullUploadMemory;
+
+// The null "GPU" finishes a frame one present after it was submitted, unless a simulated timeline is
+// set (SetSimulatedGpu); GSimulatedEndTimes holds the completion time of each fence value.
+static uint64_t GCompletedFrameCount;
+static TSimulatedGpu* GSimulatedGpu;
+static std::vector<double> GSimulatedEndTimes;
+
+// The list each null allocator last opened, to catch a second list opened on it before the first is
+// closed (D3D12 allows one open list per allocator).
+static Cmd::TCommandList* GOpenLists[KMaxFramesInFlight][Jobs::KMaxThreads];
+static std::atomic<unsigned> GAllocatorConflictCount;
+
+// Fake, non-overlapping address ranges keep handles from different heaps distinguishable: the shader
+// visible heap at 1 << 32, descriptor pages at (Type + 1) << 44 + (Page + 1) << 32.
+static void
+InitializeNullShaderVisibleHeap()
+{
+    TDescriptorHeap& Heap = GShaderVisibleHeap;
+    Heap.Heap = &GNullShaderVisibleHeap;
+    Heap.Size = 0;
+    Heap.Capacity = GetShaderVisibleCapacity();
+    Heap.CpuStart.ptr = (size_t)1 << 32;
+    Heap.GpuStart.ptr = (uint64_t)1 << 40;
+}
+
+static void
+CreateDescriptorPage(D3D12_DESCRIPTOR_HEAP_TYPE Type, unsigned Capacity, TDescriptorHeap& OutPage)
+{
+    const unsigned Page = (unsigned)GDescriptorPools[Type].Pages.size() - 1;
+
+    OutPage.Heap = nullptr;
+    OutPage.Size = 0;
+    OutPage.Capacity = Capacity;
+    OutPage.CpuStart.ptr = ((size_t)(Type + 1) << 44) + ((size_t)(Page + 1) << 32);
+    OutPage.GpuStart.ptr = 0;
+}
+
+static void
+ReleaseDescriptorPage(TDescriptorHeap& Page)
+{
+    Page.Heap = nullptr;
+}
+
+static void
+CopyDescriptors(unsigned, D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_CPU_DESCRIPTOR_HANDLE)
+{
+}
+
+// The swap chain of low latency mode has a maximum frame latency of 1: its waitable object is signaled
+// once the last presented frame is off the present queue, which without vsync is when the GPU finishes
+// it. Only the simulated timeline models this.
+static void
+WaitForSwapChain()
+{
+    if (GSimulatedGpu)
+        WaitForFrameCount(nullptr, GFrameCount);
+}
+
+static void
+CreateCommandList(Cmd::TCommandList&)
+{
+}
+
+static void
+ReleaseCommandList(Cmd::TCommandList&)
+{
+}
+
+static void
+BeginCommandList(Cmd::TCommandList& List)
+{
+    Cmd::TCommandList*& OpenList = GOpenLists[GFrameIndex][Jobs::GetThreadIndex()];
+    if (OpenList && OpenList != &List && OpenList->Open)
+    {
+        assert(0);
+        GAllocatorConflictCount++;
+    }
+    Cmd::Reset(List);
+    List.Open = true;
+    OpenList = &List;
+}
+
+// Submits a frame (with GpuTime of work on the simulated timeline) and signals the next fence value.
+static void
+SignalFrame(double GpuTime)
+{
+    ++GFrameCount;
+    if (GSimulatedGpu)
+    {
+        GSimulatedGpu->LastEndTime = std::max(GSimulatedGpu->Clock, GSimulatedGpu->LastEndTime) + GpuTime;
+        GSimulatedEndTimes.push_back(GSimulatedGpu->LastEndTime);
+    }
+    else
+    {
+        GCompletedFrameCount = GFrameCount - 1;
+    }
+}
+
+static uint64_t
+GetCompletedFrameCount(void*)
+{
+    if (GSimulatedGpu)
+    {
+        while (GCompletedFrameCount < GFrameCount &&
+               GSimulatedEndTimes[GCompletedFrameCount + 1] <= GSimulatedGpu->Clock)
+            GCompletedFrameCount++;
+    }
+    return GCompletedFrameCount;
+}
+
+static void
+WaitForFrameCount(void*, uint64_t FrameCount)
+{
+    assert(FrameCount <= GFrameCount);
+    if (GSimulatedGpu && FrameCount > GCompletedFrameCount)
+    {
+        const double EndTime = GSimulatedEndTimes[FrameCount];
+        if (EndTime > GSimulatedGpu->Clock)
+        {
+            GSimulatedGpu->WaitTime += EndTime - GSimulatedGpu->Clock;
+            GSimulatedGpu->Clock = EndTime;
+        }
+    }
+    GCompletedFrameCount = std::max(GCompletedFrameCount, FrameCount);
+}
+
+} // namespace Priv
+
+static void
+ResetCommandList()
+{
+    Priv::BeginFrameCommandLists();
+    Priv::BeginCommandList(GCmdList);
+}
+
+static void
+ExecuteCommandList()
+{
+    Cmd::Close(GCmdList);
+    Priv::GSubmitLists.push_back(&GCmdList);
+}
+
+static void
+Initialize(Plat::TWindow Window, const TFrameSettings& Settings)
+{
+    GResolution[0] = Window->Width;
+    GResolution[1] = Window->Height;
+    GDescriptorSize = 32;
+    GDescriptorSizeRtv = 32;
+    Priv::InitializeFramePacing(Settings);
+    Priv::GBackBufferIndex = 0;
+    Priv::GSimulatedEndTimes.assign(1, 0.0);
+
+    memset(Priv::GOpenLists, 0, sizeof(Priv::GOpenLists));
+    Priv::GAllocatorConflictCount = 0;
+
+    Priv::InitializeDescriptorPools();
+    Priv::InitializeNullShaderVisibleHeap();
+    Priv::InitializeShaderVisibleRanges();
+
+    {
+        Priv::TGpuMemoryHeap& UploadHeap = Priv::GUploadMemoryHeap;
+        Priv::GNullUploadMemory.resize(Priv::KUploadRingCapacity);
+
+        UploadHeap.Heap = &Priv::GNullUploadBuffer;
+        UploadHeap.Size = 0;
+        UploadHeap.Capacity = Priv::KUploadRingCapacity;
+        UploadHeap.CpuStart = Priv::GNullUploadMemory.data();
+        UploadHeap.GpuStart = (D3D12_GPU_VIRTUAL_ADDRESS)(uintptr_t)UploadHeap.CpuStart;
+
+        Priv::GCompletedFrameCount = 0;
+        Mem::TRingFence Fence = { Priv::GetCompletedFrameCount, Priv::WaitForFrameCount, nullptr };
+        Mem::InitializeRing(Priv::GUploadRing, UploadHeap.Capacity, Fence);
+    }
+
+    for (unsigned Index = 0; Index < 4; ++Index)
+    {
+        Priv::GSwapBuffers[Index] = &Priv::GNullSwapBuffers[Index];
+        AllocateDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE_RTV, 1, Priv::GSwapBufferHandles[Index]);
+    }
+
+    AllocateDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 1, GDepthBufferHandle);
+
+    Priv::BeginFrameCommandLists();
+    Priv::BeginCommandList(GCmdList);
+    GCmdList.FilterRedundantState = true;
+}
+
+static void
+Shutdown()
+{
+    Priv::ShutdownCommandLists();
+    Priv::ShutdownDescriptorPools();
+    Priv::GNullUploadMemory.clear();
+    Priv::GNullUploadMemory.shrink_to_fit();
+}
+
+static void
+PresentFrame()
+{
+    PROF_ZONE("PresentFrame");
+    Priv::SignalFrame(Priv::GSimulatedGpu ? Priv::GSimulatedGpu->FrameTime : 0.0);
+
+    Priv::GBackBufferIndex = (unsigned)(Priv::GFrameCount % 4);
+    Priv::AdvanceFrame(Priv::GFrameCount);
+}
+
+static void
+WaitForGpu()
+{
+    Priv::SignalFrame(0.0);
+    Priv::WaitForFrameCount(nullptr, Priv::GFrameCount);
+    Mem::RetireRing(Priv::GUploadRing, false);
+    Priv::RetireDescriptors();
+}
+
+// Takes effect from the next Initialize(); pass nullptr to go back to the default timing.
+static void
+SetSimulatedGpu(TSimulatedGpu* Gpu)
+{
+    Priv::GSimulatedGpu = Gpu;
+}
+
+static unsigned
+GetAllocatorConflictCount()
+{
+    return Priv::GAllocatorConflictCount;
+}
+
+} // namespace Dx
+// vim: set ts=4 sw=4 expandtab:
@@ -1,7 +1,7 @@
-#include "External.h"
-#define IMGUI_STB_NAMESPACE ImGuiStb
-#include "imgui.cpp"
-#include "imgui_draw.cpp"
-#include "imgui_demo.cpp"
-#include "imgui_widgets.cpp"
-// vim: set ts=4 sw=4 expandtab:
+#include "External.h"
+#define IMGUI_STB_NAMESPACE ImGuiStb
+#include "imgui.cpp"
+#include "imgui_draw.cpp"
+#include "imgui_demo.cpp"
+#include "imgui_widgets.cpp"
+// vim: set ts=4 sw=4 expandtab:
@@ -1,27 +1,91 @@
-#pragma once
-
-#define _CRT_SECURE_NO_WARNINGS
-#include <assert.h>
-#include <stdint.h>
-#include <math.h>
-
-#define NOMINMAX
-#define WIN32_LEAN_AND_MEAN
-#include <dxgi1_4.h>
-#include <d3d12.h>
-#include <windows.h>
-#include <DirectXMath.h>
-
-#include <vector>
-
-#include "d3dx12.h"
-#include "imgui.h"
-
-#pragma comment(lib, "d3d12.lib")
-#pragma comment(lib, "dxgi.lib")
-
-#define VHR(hr) if (FAILED(hr)) { assert(0); }
-#define SAFE_RELEASE(obj) if ((obj)) { (obj)->Release(); (obj) = nullptr; }
-
-using namespace DirectX;
-// vim: set ts=4 sw=4 expandtab:
+#pragma once
+
+#if !defined(_WIN32) && !defined(DEMO_HEADLESS)
+#define DEMO_HEADLESS
+#endif
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <direct.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define DEMO_IO_URING
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#if !defined(DEMO_HEADLESS)
+#include <dxgi1_4.h>
+#include <d3d12.h>
+#include <DirectXMath.h>
+#else
+#include "D3D12Headless.h"
+#endif
+
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define DEMO_SSE2
+#include <emmintrin.h>
+#include <immintrin.h> // SSE4.1 and AVX2, only in code picked by Lib::GetCpuFeatures() at run time
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define DEMO_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Compiles a function for an instruction set beyond the build's baseline. MSVC needs no option for
+// the intrinsics, GCC and Clang need it per function.
+#if defined(__GNUC__)
+#define DEMO_TARGET(Isa) __attribute__((target(Isa)))
+#else
+#define DEMO_TARGET(Isa)
+#endif
+
+#if !defined(DEMO_HEADLESS)
+#include "d3dx12.h"
+#endif
+#include "imgui.h"
+
+#if !defined(DEMO_HEADLESS)
+#pragma comment(lib, "d3d12.lib")
+#pragma comment(lib, "dxgi.lib")
+#endif
+
+#define VHR(hr) if (FAILED(hr)) { assert(0); }
+#define SAFE_RELEASE(obj) if ((obj)) { (obj)->Release(); (obj) = nullptr; }
+
+#if !defined(DEMO_HEADLESS)
+using namespace DirectX;
+#endif
+// vim: set ts=4 sw=4 expandtab:
@@ -114,6 +114,7 @@ typedef int ImGuiTreeNodeFlags;     // -> enum ImGuiTreeNodeFlags_   // Flags: f
 typedef int ImGuiWindowFlags;       // -> enum ImGuiWindowFlags_     // Flags: for Begin*()
 typedef int (*ImGuiInputTextCallback)(ImGuiInputTextCallbackData *data);
 typedef void (*ImGuiSizeCallback)(ImGuiSizeCallbackData* data);
+typedef void (*ImFontAtlasBuildTask)(void* task_data, unsigned int begin, unsigned int end);
 
 // Scalar data types
 typedef signed int          ImS32;  // 32-bit signed integer == int
@@ -1895,6 +1896,7 @@ struct ImFontAtlas
     ImTextureID                 TexID;              // User data to refer to the texture once it has been uploaded to user's graphic systems. It is passed back to you during rendering via the ImDrawCmd structure.
     int                         TexDesiredWidth;    // Texture width desired by user before Build(). Must be a power-of-two. If have many glyphs your graphics API have texture size restrictions you may want to increase texture width to decrease height.
     int                         TexGlyphPadding;    // Padding between glyphs within texture in pixels. Defaults to 1.
+    void                        (*ParallelFor)(unsigned int count, ImFontAtlasBuildTask task, void* task_data); // Optional: run task over [0, count) in sub-ranges, possibly on several threads, and return when all of them are done. Build() rasterizes glyphs through it. The result is the same as without it.
 
     // [Internal]
     // NB: Access texture data via GetTexData*() calls! Which will setup a default font for you.
@@ -122,8 +122,10 @@ namespace IMGUI_STB_NAMESPACE
 
 #ifndef STB_TRUETYPE_IMPLEMENTATION                         // in case the user already have an implementation in the _same_ compilation unit (e.g. unity builds)
 #ifndef IMGUI_DISABLE_STB_TRUETYPE_IMPLEMENTATION
-#define STBTT_malloc(x,u)   ((void)(u), ImGui::MemAlloc(x))
-#define STBTT_free(x,u)     ((void)(u), ImGui::MemFree(x))
+// Glyphs may be rasterized on several threads (ImFontAtlas::ParallelFor) and ImGui::MemAlloc() counts allocations in the
+// context without synchronization, so the rasterizer's scratch memory comes straight from malloc().
+#define STBTT_malloc(x,u)   ((void)(u), malloc(x))
+#define STBTT_free(x,u)     ((void)(u), free(x))
 #define STBTT_assert(x)     IM_ASSERT(x)
 #define STBTT_fmod(x,y)     ImFmod(x,y)
 #define STBTT_sqrt(x)       ImSqrt(x)
@@ -1396,6 +1398,7 @@ ImFontAtlas::ImFontAtlas()
     TexID = NULL;
     TexDesiredWidth = 0;
     TexGlyphPadding = 1;
+    ParallelFor = NULL;
 
     TexPixelsAlpha8 = NULL;
     TexPixelsRGBA32 = NULL;
@@ -1703,6 +1706,43 @@ void    ImFontAtlasBuildMultiplyRectAlpha8(const unsigned char table[256], unsig
             data[i] = table[data[i]];
 }
 
+// Glyphs are rendered in chunks of up to FONT_ATLAS_RENDER_CHUNK_SIZE consecutive codepoints of one range. Chunks write
+// to disjoint rectangles of the texture, so they can be rendered in any order and on any thread.
+#define FONT_ATLAS_RENDER_CHUNK_SIZE 32
+
+struct ImFontBuildRenderChunk
+{
+    const stbtt_fontinfo*   FontInfo;
+    stbtt_pack_range        Range;
+    stbrp_rect*             Rects;
+    float                   RasterizerMultiply;
+};
+
+struct ImFontBuildRenderData
+{
+    const stbtt_pack_context*   Spc;
+    ImFontBuildRenderChunk*     Chunks;
+};
+
+static void ImFontAtlasBuildRenderChunks(void* task_data, unsigned int begin, unsigned int end)
+{
+    const ImFontBuildRenderData* data = (const ImFontBuildRenderData*)task_data;
+    for (unsigned int chunk_i = begin; chunk_i < end; chunk_i++)
+    {
+        ImFontBuildRenderChunk& chunk = data->Chunks[chunk_i];
+        stbtt_pack_context spc = *data->Spc; // stbtt_PackFontRangesRenderIntoRects() changes the oversampling while it runs
+        stbtt_PackFontRangesRenderIntoRects(&spc, chunk.FontInfo, &chunk.Range, 1, chunk.Rects);
+        if (chunk.RasterizerMultiply != 1.0f)
+        {
+            unsigned char multiply_table[256];
+            ImFontAtlasBuildMultiplyCalcLookupTable(multiply_table, chunk.RasterizerMultiply);
+            for (const stbrp_rect* r = chunk.Rects; r != chunk.Rects + chunk.Range.num_chars; r++)
+                if (r->was_packed)
+                    ImFontAtlasBuildMultiplyRectAlpha8(multiply_table, spc.pixels, r->x, r->y, r->w, r->h, spc.stride_in_bytes);
+        }
+    }
+}
+
 bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
 {
     IM_ASSERT(atlas->ConfigData.Size > 0);
@@ -1843,23 +1883,43 @@ bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
     spc.pixels = atlas->TexPixelsAlpha8;
     spc.height = atlas->TexHeight;
 
-    // Second pass: render font characters
+    // Second pass: render font characters, in chunks (see ImFontAtlasBuildRenderChunks)
+    int chunks_count = 0;
+    for (int range_i = 0; range_i < total_ranges_count; range_i++)
+        chunks_count += (buf_ranges[range_i].num_chars + FONT_ATLAS_RENDER_CHUNK_SIZE - 1) / FONT_ATLAS_RENDER_CHUNK_SIZE;
+    ImFontBuildRenderChunk* chunks = (ImFontBuildRenderChunk*)ImGui::MemAlloc(chunks_count * sizeof(ImFontBuildRenderChunk));
+    int chunk_n = 0;
     for (int input_i = 0; input_i < atlas->ConfigData.Size; input_i++)
     {
         ImFontConfig& cfg = atlas->ConfigData[input_i];
         ImFontTempBuildData& tmp = tmp_array[input_i];
-        stbtt_PackSetOversampling(&spc, cfg.OversampleH, cfg.OversampleV);
-        stbtt_PackFontRangesRenderIntoRects(&spc, &tmp.FontInfo, tmp.Ranges, tmp.RangesCount, tmp.Rects);
-        if (cfg.RasterizerMultiply != 1.0f)
+        int rect_i = 0;
+        for (int range_i = 0; range_i < tmp.RangesCount; range_i++)
         {
-            unsigned char multiply_table[256];
-            ImFontAtlasBuildMultiplyCalcLookupTable(multiply_table, cfg.RasterizerMultiply);
-            for (const stbrp_rect* r = tmp.Rects; r != tmp.Rects + tmp.RectsCount; r++)
-                if (r->was_packed)
-                    ImFontAtlasBuildMultiplyRectAlpha8(multiply_table, spc.pixels, r->x, r->y, r->w, r->h, spc.stride_in_bytes);
+            const stbtt_pack_range& range = tmp.Ranges[range_i];
+            for (int char_i = 0; char_i < range.num_chars; char_i += FONT_ATLAS_RENDER_CHUNK_SIZE, chunk_n++)
+            {
+                ImFontBuildRenderChunk& chunk = chunks[chunk_n];
+                chunk.FontInfo = &tmp.FontInfo;
+                chunk.Range = range;
+                chunk.Range.first_unicode_codepoint_in_range += char_i;
+                chunk.Range.num_chars = ImMin(range.num_chars - char_i, FONT_ATLAS_RENDER_CHUNK_SIZE);
+                chunk.Range.chardata_for_range += char_i;
+                chunk.Rects = tmp.Rects + rect_i + char_i;
+                chunk.RasterizerMultiply = cfg.RasterizerMultiply;
+            }
+            rect_i += range.num_chars;
         }
         tmp.Rects = NULL;
     }
+    IM_ASSERT(chunk_n == chunks_count);
+
+    ImFontBuildRenderData render_data = { &spc, chunks };
+    if (atlas->ParallelFor)
+        atlas->ParallelFor((unsigned int)chunks_count, ImFontAtlasBuildRenderChunks, &render_data);
+    else
+        ImFontAtlasBuildRenderChunks(&render_data, 0, (unsigned int)chunks_count);
+    ImGui::MemFree(chunks);
 
     // End packing
     stbtt_PackEnd(&spc);
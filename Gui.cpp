@@ -1,263 +1,687 @@
-namespace Gui
-{
-namespace Priv
-{
-
-struct TFrameResources
-{
-    ID3D12Resource* VertexBuffer;
-    void* VertexBufferCpuAddress;
-    unsigned VertexBufferSize;
-    D3D12_VERTEX_BUFFER_VIEW VertexBufferView;
-
-    ID3D12Resource* IndexBuffer;
-    void* IndexBufferCpuAddress;
-    unsigned IndexBufferSize;
-    D3D12_INDEX_BUFFER_VIEW IndexBufferView;
-};
-
-static TFrameResources GFrameResources[2];
-static ID3D12RootSignature* GRootSignature;
-static ID3D12PipelineState* GPipelineState;
-static ID3D12Resource* GFontTexture;
-static D3D12_CPU_DESCRIPTOR_HANDLE GFontTextureDescriptor;
-
-} // namespace Priv
-
-static void
-Initialize()
-{
-    ImGuiIO& Io = ImGui::GetIO();
-    Io.KeyMap[ImGuiKey_Tab] = VK_TAB;
-    Io.KeyMap[ImGuiKey_LeftArrow] = VK_LEFT;
-    Io.KeyMap[ImGuiKey_RightArrow] = VK_RIGHT;
-    Io.KeyMap[ImGuiKey_UpArrow] = VK_UP;
-    Io.KeyMap[ImGuiKey_DownArrow] = VK_DOWN;
-    Io.KeyMap[ImGuiKey_PageUp] = VK_PRIOR;
-    Io.KeyMap[ImGuiKey_PageDown] = VK_NEXT;
-    Io.KeyMap[ImGuiKey_Home] = VK_HOME;
-    Io.KeyMap[ImGuiKey_End] = VK_END;
-    Io.KeyMap[ImGuiKey_Delete] = VK_DELETE;
-    Io.KeyMap[ImGuiKey_Backspace] = VK_BACK;
-    Io.KeyMap[ImGuiKey_Enter] = VK_RETURN;
-    Io.KeyMap[ImGuiKey_Escape] = VK_ESCAPE;
-    Io.KeyMap[ImGuiKey_A] = 'A';
-    Io.KeyMap[ImGuiKey_C] = 'C';
-    Io.KeyMap[ImGuiKey_V] = 'V';
-    Io.KeyMap[ImGuiKey_X] = 'X';
-    Io.KeyMap[ImGuiKey_Y] = 'Y';
-    Io.KeyMap[ImGuiKey_Z] = 'Z';
-    Io.ImeWindowHandle = Dx::GWindow;
-    Io.RenderDrawListsFn = nullptr;
-    Io.DisplaySize = ImVec2((float)Dx::GResolution[0], (float)Dx::GResolution[1]);
-    ImGui::GetStyle().WindowRounding = 0.0f;
-
-    uint8_t* Pixels;
-    int Width, Height;
-    ImGui::GetIO().Fonts->AddFontFromFileTTF("Data/Roboto-Medium.ttf", 18.0f);
-    ImGui::GetIO().Fonts->GetTexDataAsRGBA32(&Pixels, &Width, &Height);
-
-    const auto TextureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, (UINT64)Width, Height);
-    VHR(Dx::GDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE,
-                                             &TextureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
-                                             IID_PPV_ARGS(&Priv::GFontTexture)));
-
-    ID3D12Resource* IntermediateBuffer = nullptr;
-    {
-        uint64_t BufferSize;
-        Dx::GDevice->GetCopyableFootprints(&TextureDesc, 0, 1, 0, nullptr, nullptr, nullptr, &BufferSize);
-
-        const auto BufferDesc = CD3DX12_RESOURCE_DESC::Buffer(BufferSize);
-        VHR(Dx::GDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE,
-                                                 &BufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-                                                 IID_PPV_ARGS(&IntermediateBuffer)));
-
-        Dx::GIntermediateResources.push_back(IntermediateBuffer);
-    }
-
-    D3D12_SUBRESOURCE_DATA TextureData = { Pixels, (LONG_PTR)(Width * 4) };
-    UpdateSubresources<1>(Dx::GCmdList, Priv::GFontTexture, IntermediateBuffer, 0, 0, 1, &TextureData);
-
-    Dx::GCmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(Priv::GFontTexture,
-                                                                           D3D12_RESOURCE_STATE_COPY_DEST,
-                                                                           D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-    D3D12_SHADER_RESOURCE_VIEW_DESC SrvDesc = {};
-    SrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    SrvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    SrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    SrvDesc.Texture2D.MipLevels = 1;
-
-    Dx::AllocateDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1, Priv::GFontTextureDescriptor);
-    Dx::GDevice->CreateShaderResourceView(Priv::GFontTexture, &SrvDesc, Priv::GFontTextureDescriptor);
-
-
-    D3D12_INPUT_ELEMENT_DESC InputElements[] =
-    {
-        { "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-    };
-
-    std::vector<uint8_t> CsoVs = Lib::LoadFile("Data/Shaders/Gui.vs.cso");
-    std::vector<uint8_t> CsoPs = Lib::LoadFile("Data/Shaders/Gui.ps.cso");
-
-    D3D12_GRAPHICS_PIPELINE_STATE_DESC PsoDesc = {};
-    PsoDesc.InputLayout = { InputElements, (unsigned)std::size(InputElements) };
-    PsoDesc.VS = { CsoVs.data(), CsoVs.size() };
-    PsoDesc.PS = { CsoPs.data(), CsoPs.size() };
-    PsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
-    PsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
-    PsoDesc.BlendState.RenderTarget[0].BlendEnable = TRUE;
-    PsoDesc.BlendState.RenderTarget[0].SrcBlend = D3D12_BLEND_SRC_ALPHA;
-    PsoDesc.BlendState.RenderTarget[0].DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
-    PsoDesc.BlendState.RenderTarget[0].BlendOp = D3D12_BLEND_OP_ADD;
-    PsoDesc.BlendState.RenderTarget[0].SrcBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA;
-    PsoDesc.BlendState.RenderTarget[0].DestBlendAlpha = D3D12_BLEND_ZERO;
-    PsoDesc.BlendState.RenderTarget[0].BlendOpAlpha = D3D12_BLEND_OP_ADD;
-    PsoDesc.BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
-    PsoDesc.SampleMask = UINT_MAX;
-    PsoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-    PsoDesc.NumRenderTargets = 1;
-    PsoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-    PsoDesc.SampleDesc.Count = 1;
-
-    VHR(Dx::GDevice->CreateGraphicsPipelineState(&PsoDesc, IID_PPV_ARGS(&Priv::GPipelineState)));
-    VHR(Dx::GDevice->CreateRootSignature(0, CsoVs.data(), CsoVs.size(), IID_PPV_ARGS(&Priv::GRootSignature)));
-}
-
-static void
-Shutdown()
-{
-    // @Incomplete: Release all resources.
-}
-
-static void
-Update(float DeltaTime)
-{
-    ImGuiIO& Io = ImGui::GetIO();
-    Io.KeyCtrl = (GetKeyState(VK_CONTROL) & 0x8000) != 0;
-    Io.KeyShift = (GetKeyState(VK_SHIFT) & 0x8000) != 0;
-    Io.KeyAlt = (GetKeyState(VK_MENU) & 0x8000) != 0;
-    Io.DeltaTime = DeltaTime;
-}
-
-static void
-Render()
-{
-    ImDrawData* DrawData = ImGui::GetDrawData();
-    if (!DrawData || DrawData->TotalVtxCount == 0)
-        return;
-
-    ImGuiIO& Io = ImGui::GetIO();
-    Priv::TFrameResources& Frame = Priv::GFrameResources[Dx::GFrameIndex];
-
-    const int ViewportWidth = (int)(Io.DisplaySize.x * Io.DisplayFramebufferScale.x);
-    const int ViewportHeight = (int)(Io.DisplaySize.y * Io.DisplayFramebufferScale.y);
-    DrawData->ScaleClipRects(Io.DisplayFramebufferScale);
-
-    // create/resize vertex buffer
-    if (Frame.VertexBufferSize == 0 || Frame.VertexBufferSize < DrawData->TotalVtxCount * sizeof(ImDrawVert))
-    {
-        SAFE_RELEASE(Frame.VertexBuffer);
-        VHR(Dx::GDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE,
-                                                 &CD3DX12_RESOURCE_DESC::Buffer(DrawData->TotalVtxCount * sizeof(ImDrawVert)),
-                                                 D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-                                                 IID_PPV_ARGS(&Frame.VertexBuffer)));
-
-        VHR(Frame.VertexBuffer->Map(0, &CD3DX12_RANGE(0, 0), &Frame.VertexBufferCpuAddress));
-
-        Frame.VertexBufferSize = DrawData->TotalVtxCount * sizeof(ImDrawVert);
-
-        Frame.VertexBufferView.BufferLocation = Frame.VertexBuffer->GetGPUVirtualAddress();
-        Frame.VertexBufferView.StrideInBytes = sizeof(ImDrawVert);
-        Frame.VertexBufferView.SizeInBytes = DrawData->TotalVtxCount * sizeof(ImDrawVert);
-    }
-
-    // create/resize index buffer
-    if (Frame.IndexBufferSize == 0 || Frame.IndexBufferSize < DrawData->TotalIdxCount * sizeof(ImDrawIdx))
-    {
-        SAFE_RELEASE(Frame.IndexBuffer);
-        VHR(Dx::GDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE,
-                                                 &CD3DX12_RESOURCE_DESC::Buffer(DrawData->TotalIdxCount * sizeof(ImDrawIdx)),
-                                                 D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-                                                 IID_PPV_ARGS(&Frame.IndexBuffer)));
-
-        VHR(Frame.IndexBuffer->Map(0, &CD3DX12_RANGE(0, 0), &Frame.IndexBufferCpuAddress));
-
-        Frame.IndexBufferSize = DrawData->TotalIdxCount * sizeof(ImDrawIdx);
-
-        Frame.IndexBufferView.BufferLocation = Frame.IndexBuffer->GetGPUVirtualAddress();
-        Frame.IndexBufferView.Format = sizeof(ImDrawIdx) == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
-        Frame.IndexBufferView.SizeInBytes = DrawData->TotalIdxCount * sizeof(ImDrawIdx);
-    }
-
-    // update vertex and index buffers
-    {
-        ImDrawVert* VertexPtr = (ImDrawVert*)Frame.VertexBufferCpuAddress;
-        ImDrawIdx* IndexPtr = (ImDrawIdx*)Frame.IndexBufferCpuAddress;
-
-        for (unsigned N = 0; N < (unsigned)DrawData->CmdListsCount; ++N)
-        {
-            ImDrawList* DrawList = DrawData->CmdLists[N];
-            memcpy(VertexPtr, &DrawList->VtxBuffer[0], DrawList->VtxBuffer.size() * sizeof(ImDrawVert));
-            memcpy(IndexPtr, &DrawList->IdxBuffer[0], DrawList->IdxBuffer.size() * sizeof(ImDrawIdx));
-            VertexPtr += DrawList->VtxBuffer.size();
-            IndexPtr += DrawList->IdxBuffer.size();
-        }
-    }
-
-    D3D12_GPU_VIRTUAL_ADDRESS ConstantBufferGpuAddress;
-    void* ConstantBufferCpuAddress = Dx::AllocateGpuUploadMemory(64, ConstantBufferGpuAddress);
-
-    // update constant buffer
-    {
-        XMMATRIX M = XMMatrixTranspose(XMMatrixOrthographicOffCenterLH(0.0f, (float)ViewportWidth,
-                                                                       (float)ViewportHeight, 0.0f,
-                                                                       0.0f, 1.0f));
-        XMFLOAT4X4A F;
-        XMStoreFloat4x4A(&F, M);
-        memcpy(ConstantBufferCpuAddress, &F, sizeof(F));
-    }
-
-    D3D12_VIEWPORT Viewport = { 0.0f, 0.0f, (float)ViewportWidth, (float)ViewportHeight, 0.0f, 1.0f };
-    Dx::GCmdList->RSSetViewports(1, &Viewport);
-
-    Dx::GCmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    Dx::GCmdList->SetPipelineState(Priv::GPipelineState);
-
-    Dx::GCmdList->SetGraphicsRootSignature(Priv::GRootSignature);
-    Dx::GCmdList->SetGraphicsRootConstantBufferView(0, ConstantBufferGpuAddress);
-    Dx::GCmdList->SetGraphicsRootDescriptorTable(1, Dx::CopyDescriptorsToGpu(1, Priv::GFontTextureDescriptor));
-
-    Dx::GCmdList->IASetVertexBuffers(0, 1, &Frame.VertexBufferView);
-    Dx::GCmdList->IASetIndexBuffer(&Frame.IndexBufferView);
-
-
-    int VertexOffset = 0;
-    unsigned IndexOffset = 0;
-    for (unsigned N = 0; N < (unsigned)DrawData->CmdListsCount; ++N)
-    {
-        ImDrawList* DrawList = DrawData->CmdLists[N];
-
-        for (unsigned CmdIndex = 0; CmdIndex < (uint32_t)DrawList->CmdBuffer.size(); ++CmdIndex)
-        {
-            ImDrawCmd* Cmd = &DrawList->CmdBuffer[CmdIndex];
-
-            if (Cmd->UserCallback)
-            {
-                Cmd->UserCallback(DrawList, Cmd);
-            }
-            else
-            {
-                D3D12_RECT R = { (LONG)Cmd->ClipRect.x, (LONG)Cmd->ClipRect.y, (LONG)Cmd->ClipRect.z, (LONG)Cmd->ClipRect.w };
-                Dx::GCmdList->RSSetScissorRects(1, &R);
-                Dx::GCmdList->DrawIndexedInstanced(Cmd->ElemCount, 1, IndexOffset, VertexOffset, 0);
-            }
-            IndexOffset += Cmd->ElemCount;
-        }
-        VertexOffset += DrawList->VtxBuffer.size();
-    }
-}
-
-} // namespace Gui
-// vim: set ts=4 sw=4 expandtab:
+namespace Gui
+{
+namespace Priv
+{
+
+// Vertex copies into upload memory, in pieces of at most KCopyChunkSize bytes so that workers get
+// similar amounts of work. Below KMinParallelCopySize in total waking the workers costs more than it
+// saves.
+struct TCopy
+{
+    void* Destination;
+    const void* Source;
+    unsigned Size;
+};
+
+static const unsigned KCopyChunkSize = 64 * 1024;
+static const unsigned KMinParallelCopySize = 256 * 1024;
+static std::vector<TCopy> GCopies;
+
+static TGeometryStats GGeometryStats;
+static ID3D12RootSignature* GRootSignature;
+static ID3D12PipelineState* GPipelineState;
+static ID3D12Resource* GFontTexture;
+static D3D12_CPU_DESCRIPTOR_HANDLE GFontTextureDescriptor;
+static uint32_t GFontTextureIndex;
+static std::vector<TDraw> GDraws;
+static bool GAssetsRequested;
+static Load::TAsset GCsoVs;
+static Load::TAsset GCsoPs;
+
+// Commands with more indices than this are not tested against the run's clip rect; the vertex scan
+// would cost more than the draw call it saves.
+static const unsigned KMaxClipTestElemCount = 6 * 64;
+
+// True when clipping the command's geometry to either rect is a no-op, so it can share a scissor
+// rect with the current run.
+static bool
+IsInsideClipRects(const ImDrawList* DrawList, const ImDrawIdx* Indices, unsigned ElemCount,
+                  const ImVec4& ClipA, const ImVec4& ClipB)
+{
+    // Compare against the truncated values that end up in the scissor rect.
+    const float MinX = (float)(LONG)std::max(ClipA.x, ClipB.x);
+    const float MinY = (float)(LONG)std::max(ClipA.y, ClipB.y);
+    const float MaxX = (float)(LONG)std::min(ClipA.z, ClipB.z);
+    const float MaxY = (float)(LONG)std::min(ClipA.w, ClipB.w);
+
+    const ImDrawVert* Vertices = DrawList->VtxBuffer.Data;
+    for (unsigned Index = 0; Index < ElemCount; ++Index)
+    {
+        const ImVec2& Pos = Vertices[Indices[Index]].pos;
+        if (Pos.x < MinX || Pos.y < MinY || Pos.x > MaxX || Pos.y > MaxY)
+            return false;
+    }
+    return true;
+}
+
+template<typename TIndex> static void
+RebaseIndices(TIndex* __restrict OutIndices, const ImDrawIdx* __restrict Indices, unsigned Count, unsigned VertexBase)
+{
+    if (VertexBase == 0 && sizeof(TIndex) == sizeof(ImDrawIdx))
+    {
+        memcpy(OutIndices, Indices, Count * sizeof(TIndex));
+        return;
+    }
+    for (unsigned Index = 0; Index < Count; ++Index)
+        OutIndices[Index] = (TIndex)(Indices[Index] + VertexBase);
+}
+
+template<typename TIndex> static void
+MergeDrawCommands(const ImDrawData* DrawData, TIndex* OutIndices, std::vector<TDraw>& OutDraws)
+{
+    OutDraws.clear();
+
+    unsigned VertexBase = 0;
+    unsigned IndexBase = 0;
+    bool RunOpen = false;
+
+    for (unsigned N = 0; N < (unsigned)DrawData->CmdListsCount; ++N)
+    {
+        ImDrawList* DrawList = DrawData->CmdLists[N];
+        const ImDrawIdx* Indices = DrawList->IdxBuffer.Data;
+
+        // Rebase into the global vertex space so that merged runs need no BaseVertexLocation.
+        RebaseIndices(OutIndices + IndexBase, Indices, DrawList->IdxBuffer.size(), VertexBase);
+
+        for (unsigned CmdIndex = 0; CmdIndex < (unsigned)DrawList->CmdBuffer.size(); ++CmdIndex)
+        {
+            const ImDrawCmd* DrawCmd = &DrawList->CmdBuffer[CmdIndex];
+
+            if (DrawCmd->UserCallback)
+            {
+                OutDraws.push_back({ DrawCmd->ClipRect, DrawCmd->TextureId, IndexBase, 0, DrawList, DrawCmd });
+                RunOpen = false;
+            }
+            else if (DrawCmd->ElemCount > 0)
+            {
+                TDraw* Run = RunOpen ? &OutDraws.back() : nullptr;
+                const bool SameClipRect = Run && memcmp(&Run->ClipRect, &DrawCmd->ClipRect, sizeof(ImVec4)) == 0;
+
+                if (Run && Run->TextureId == DrawCmd->TextureId &&
+                    (SameClipRect ||
+                     (DrawCmd->ElemCount <= KMaxClipTestElemCount &&
+                      IsInsideClipRects(DrawList, Indices, DrawCmd->ElemCount, Run->ClipRect, DrawCmd->ClipRect))))
+                {
+                    Run->ElemCount += DrawCmd->ElemCount;
+                }
+                else
+                {
+                    OutDraws.push_back({ DrawCmd->ClipRect, DrawCmd->TextureId, IndexBase, DrawCmd->ElemCount,
+                                         nullptr, nullptr });
+                    RunOpen = true;
+                }
+            }
+            Indices += DrawCmd->ElemCount;
+            IndexBase += DrawCmd->ElemCount;
+        }
+        VertexBase += DrawList->VtxBuffer.size();
+    }
+}
+
+static void
+RunCopies(void* Context, unsigned Begin, unsigned End)
+{
+    const TCopy* Copies = (const TCopy*)Context;
+    for (unsigned Index = Begin; Index < End; ++Index)
+        Lib::StreamCopy(Copies[Index].Destination, Copies[Index].Source, Copies[Index].Size);
+}
+
+// Font atlas cache file: TFontCacheHeader, GlyphCount ImFontGlyph, CustomRectCount TFontCacheRect, then
+// the Alpha8 pixels, LZ4 compressed when PixelsSize is below TexWidth * TexHeight. Native endianness;
+// a cache written by another ImGui version or build setting just misses.
+static const uint32_t KFontCacheMagic = 0x544e4644; // "DFNT"
+static const uint32_t KFontCacheVersion = 1;
+static const char* const KFontCacheDirectory = "Cache";
+
+struct TFontCacheHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint64_t Key;
+    int32_t TexWidth;
+    int32_t TexHeight;
+    ImVec2 TexUvScale;
+    ImVec2 TexUvWhitePixel;
+    int32_t CustomRectIds[IM_ARRAYSIZE(ImFontAtlas::CustomRectIds)];
+    float FontSize;
+    float Ascent;
+    float Descent;
+    ImVec2 DisplayOffset;
+    uint32_t FallbackChar;
+    int32_t MetricsTotalSurface;
+    uint32_t GlyphCount;
+    uint32_t CustomRectCount;
+    uint32_t PixelsSize;
+};
+
+// ImFontAtlas::CustomRect without the font pointer; a custom glyph always belongs to the only font.
+struct TFontCacheRect
+{
+    uint32_t Id;
+    uint16_t Width;
+    uint16_t Height;
+    uint16_t X;
+    uint16_t Y;
+    float GlyphAdvanceX;
+    ImVec2 GlyphOffset;
+    uint32_t HasFont;
+};
+
+// FNV-1a.
+static uint64_t
+HashBytes(uint64_t Hash, const void* Data, size_t Size)
+{
+    const uint8_t* Bytes = (const uint8_t*)Data;
+    for (size_t Index = 0; Index < Size; ++Index)
+        Hash = (Hash ^ Bytes[Index]) * 0x100000001b3ull;
+    return Hash;
+}
+
+// Hashes the font and every input that changes the built atlas. Fields are hashed one by one since
+// ImFontConfig has padding and pointers.
+static uint64_t
+GetFontCacheKey(ImFontAtlas* Atlas, const void* TtfData, size_t TtfSize, const ImFontConfig& Config)
+{
+    const uint32_t Versions[2] = { KFontCacheVersion, IMGUI_VERSION_NUM };
+    uint64_t Hash = HashBytes(0xcbf29ce484222325ull, Versions, sizeof(Versions));
+    Hash = HashBytes(Hash, TtfData, TtfSize);
+
+    Hash = HashBytes(Hash, &Atlas->Flags, sizeof(Atlas->Flags));
+    Hash = HashBytes(Hash, &Atlas->TexDesiredWidth, sizeof(Atlas->TexDesiredWidth));
+    Hash = HashBytes(Hash, &Atlas->TexGlyphPadding, sizeof(Atlas->TexGlyphPadding));
+
+    Hash = HashBytes(Hash, &Config.FontNo, sizeof(Config.FontNo));
+    Hash = HashBytes(Hash, &Config.SizePixels, sizeof(Config.SizePixels));
+    Hash = HashBytes(Hash, &Config.OversampleH, sizeof(Config.OversampleH));
+    Hash = HashBytes(Hash, &Config.OversampleV, sizeof(Config.OversampleV));
+    Hash = HashBytes(Hash, &Config.PixelSnapH, sizeof(Config.PixelSnapH));
+    Hash = HashBytes(Hash, &Config.GlyphExtraSpacing, sizeof(Config.GlyphExtraSpacing));
+    Hash = HashBytes(Hash, &Config.GlyphOffset, sizeof(Config.GlyphOffset));
+    Hash = HashBytes(Hash, &Config.GlyphMinAdvanceX, sizeof(Config.GlyphMinAdvanceX));
+    Hash = HashBytes(Hash, &Config.GlyphMaxAdvanceX, sizeof(Config.GlyphMaxAdvanceX));
+    Hash = HashBytes(Hash, &Config.RasterizerFlags, sizeof(Config.RasterizerFlags));
+    Hash = HashBytes(Hash, &Config.RasterizerMultiply, sizeof(Config.RasterizerMultiply));
+
+    const ImWchar* Ranges = Config.GlyphRanges ? Config.GlyphRanges : Atlas->GetGlyphRangesDefault();
+    for (; *Ranges; Ranges += 2)
+        Hash = HashBytes(Hash, Ranges, 2 * sizeof(ImWchar));
+    return Hash;
+}
+
+// Restores the atlas Build() produced from the cache file; leaves Atlas untouched on a miss.
+static bool
+LoadFontCache(ImFontAtlas* Atlas, const char* FileName, uint64_t Key)
+{
+    Lib::TMappedFile File = Lib::MapFile(FileName);
+    if (!File.Data)
+        return false;
+
+    TFontCacheHeader Header = {};
+    if (File.Size >= sizeof(Header))
+        memcpy(&Header, File.Data, sizeof(Header));
+
+    const size_t PixelCount = (size_t)Header.TexWidth * (size_t)Header.TexHeight;
+    const size_t TablesSize = Header.GlyphCount * sizeof(ImFontGlyph) + Header.CustomRectCount * sizeof(TFontCacheRect);
+    if (Header.Magic != KFontCacheMagic || Header.Version != KFontCacheVersion || Header.Key != Key ||
+        Header.TexWidth <= 0 || Header.TexHeight <= 0 || Header.GlyphCount == 0 || Header.PixelsSize > PixelCount ||
+        File.Size != sizeof(Header) + TablesSize + Header.PixelsSize)
+    {
+        Lib::UnmapFile(File);
+        return false;
+    }
+
+    const uint8_t* Glyphs = File.Data + sizeof(Header);
+    const uint8_t* Rects = Glyphs + Header.GlyphCount * sizeof(ImFontGlyph);
+    const uint8_t* Pixels = Rects + Header.CustomRectCount * sizeof(TFontCacheRect);
+
+    uint8_t* TexPixels = (uint8_t*)ImGui::MemAlloc(PixelCount);
+    if (Header.PixelsSize == PixelCount)
+        memcpy(TexPixels, Pixels, PixelCount);
+    else if (!Pak::DecompressLz4(Pixels, Header.PixelsSize, TexPixels, PixelCount))
+    {
+        ImGui::MemFree(TexPixels);
+        Lib::UnmapFile(File);
+        return false;
+    }
+
+    ImFont* Font = IM_NEW(ImFont);
+    Atlas->Fonts.push_back(Font);
+    Font->ContainerAtlas = Atlas;
+    Font->FontSize = Header.FontSize;
+    Font->Ascent = Header.Ascent;
+    Font->Descent = Header.Descent;
+    Font->DisplayOffset = Header.DisplayOffset;
+    Font->FallbackChar = (ImWchar)Header.FallbackChar;
+    Font->MetricsTotalSurface = Header.MetricsTotalSurface;
+    Font->Glyphs.resize((int)Header.GlyphCount);
+    memcpy(Font->Glyphs.Data, Glyphs, Header.GlyphCount * sizeof(ImFontGlyph));
+    Font->BuildLookupTable();
+
+    Atlas->CustomRects.resize((int)Header.CustomRectCount);
+    for (unsigned Index = 0; Index < Header.CustomRectCount; ++Index)
+    {
+        TFontCacheRect Cached;
+        memcpy(&Cached, Rects + Index * sizeof(Cached), sizeof(Cached));
+
+        ImFontAtlas::CustomRect& Rect = Atlas->CustomRects[Index];
+        Rect.ID = Cached.Id;
+        Rect.Width = Cached.Width;
+        Rect.Height = Cached.Height;
+        Rect.X = Cached.X;
+        Rect.Y = Cached.Y;
+        Rect.GlyphAdvanceX = Cached.GlyphAdvanceX;
+        Rect.GlyphOffset = Cached.GlyphOffset;
+        Rect.Font = Cached.HasFont ? Font : nullptr;
+    }
+    for (unsigned Index = 0; Index < (unsigned)IM_ARRAYSIZE(Atlas->CustomRectIds); ++Index)
+        Atlas->CustomRectIds[Index] = Header.CustomRectIds[Index];
+
+    Atlas->TexWidth = Header.TexWidth;
+    Atlas->TexHeight = Header.TexHeight;
+    Atlas->TexUvScale = Header.TexUvScale;
+    Atlas->TexUvWhitePixel = Header.TexUvWhitePixel;
+    Atlas->TexPixelsAlpha8 = TexPixels;
+
+    Lib::UnmapFile(File);
+    return true;
+}
+
+// Writes to a temporary file first, so that a reader never maps a partial cache.
+static void
+SaveFontCache(const ImFontAtlas* Atlas, const char* FileName, uint64_t Key)
+{
+    const ImFont* Font = Atlas->Fonts[0];
+    const size_t PixelCount = (size_t)Atlas->TexWidth * (size_t)Atlas->TexHeight;
+
+    std::vector<uint8_t> Compressed(PixelCount);
+    const size_t CompressedSize = Pak::CompressLz4(Atlas->TexPixelsAlpha8, PixelCount, Compressed.data(),
+                                                   PixelCount - 1);
+
+    TFontCacheHeader Header = {};
+    Header.Magic = KFontCacheMagic;
+    Header.Version = KFontCacheVersion;
+    Header.Key = Key;
+    Header.TexWidth = Atlas->TexWidth;
+    Header.TexHeight = Atlas->TexHeight;
+    Header.TexUvScale = Atlas->TexUvScale;
+    Header.TexUvWhitePixel = Atlas->TexUvWhitePixel;
+    for (unsigned Index = 0; Index < (unsigned)IM_ARRAYSIZE(Atlas->CustomRectIds); ++Index)
+        Header.CustomRectIds[Index] = Atlas->CustomRectIds[Index];
+    Header.FontSize = Font->FontSize;
+    Header.Ascent = Font->Ascent;
+    Header.Descent = Font->Descent;
+    Header.DisplayOffset = Font->DisplayOffset;
+    Header.FallbackChar = Font->FallbackChar;
+    Header.MetricsTotalSurface = Font->MetricsTotalSurface;
+    Header.GlyphCount = (uint32_t)Font->Glyphs.Size;
+    Header.CustomRectCount = (uint32_t)Atlas->CustomRects.Size;
+    Header.PixelsSize = (uint32_t)(CompressedSize ? CompressedSize : PixelCount);
+
+    // Copied field by field, so that the padding after Codepoint is written as zeros.
+    std::vector<ImFontGlyph> Glyphs(Font->Glyphs.Size);
+    for (unsigned Index = 0; Index < Header.GlyphCount; ++Index)
+    {
+        const ImFontGlyph& Glyph = Font->Glyphs[Index];
+        Glyphs[Index].Codepoint = Glyph.Codepoint;
+        Glyphs[Index].AdvanceX = Glyph.AdvanceX;
+        Glyphs[Index].X0 = Glyph.X0;
+        Glyphs[Index].Y0 = Glyph.Y0;
+        Glyphs[Index].X1 = Glyph.X1;
+        Glyphs[Index].Y1 = Glyph.Y1;
+        Glyphs[Index].U0 = Glyph.U0;
+        Glyphs[Index].V0 = Glyph.V0;
+        Glyphs[Index].U1 = Glyph.U1;
+        Glyphs[Index].V1 = Glyph.V1;
+    }
+
+    std::vector<TFontCacheRect> Rects(Atlas->CustomRects.Size);
+    for (unsigned Index = 0; Index < Header.CustomRectCount; ++Index)
+    {
+        const ImFontAtlas::CustomRect& Rect = Atlas->CustomRects[Index];
+        assert(!Rect.Font || Rect.Font == Font);
+        Rects[Index] = { Rect.ID, Rect.Width, Rect.Height, Rect.X, Rect.Y, Rect.GlyphAdvanceX, Rect.GlyphOffset,
+                         Rect.Font != nullptr };
+    }
+
+    char TempFileName[300];
+    snprintf(TempFileName, sizeof(TempFileName), "%s.tmp", FileName);
+    FILE* File = fopen(TempFileName, "wb");
+    if (!File)
+        return;
+
+    fwrite(&Header, sizeof(Header), 1, File);
+    fwrite(Glyphs.data(), sizeof(ImFontGlyph), Glyphs.size(), File);
+    fwrite(Rects.data(), sizeof(TFontCacheRect), Rects.size(), File);
+    fwrite(CompressedSize ? Compressed.data() : Atlas->TexPixelsAlpha8, 1, Header.PixelsSize, File);
+    bool Succeeded = ferror(File) == 0;
+    Succeeded = fclose(File) == 0 && Succeeded;
+
+    // Another process may have written the same cache in the meantime; either copy is fine.
+    if (!Succeeded || rename(TempFileName, FileName) != 0)
+        remove(TempFileName);
+}
+
+// Runs on a job thread. The main thread doesn't use ImGui until Initialize() has waited for this.
+static void
+DecodeFont(Load::TAsset& Asset)
+{
+    ImFontAtlas* Atlas = (ImFontAtlas*)Asset.Context;
+    ImFontConfig FontConfig;
+    FontConfig.SizePixels = 18.0f;
+    BuildFontAtlas(Atlas, Asset.Data, Asset.Size, FontConfig, KFontCacheDirectory);
+    Atlas->ClearInputData();
+}
+
+static void
+CheckAsset(Load::TAsset& Asset)
+{
+    assert(!Asset.Failed);
+}
+
+// Keeps the file contents in the TAsset pointed to by Context.
+static void
+KeepAsset(Load::TAsset& Asset)
+{
+    assert(!Asset.Failed);
+    *(Load::TAsset*)Asset.Context = Asset;
+    Asset.Data = nullptr;
+}
+
+} // namespace Priv
+
+// One job per chunk of glyphs; a chunk is up to 32 glyphs of one range.
+static void
+ParallelForFontAtlas(unsigned Count, ImFontAtlasBuildTask Task, void* TaskData)
+{
+    Jobs::ParallelFor(Count, 1, Task, TaskData);
+}
+
+static bool
+BuildFontAtlas(ImFontAtlas* Atlas, const void* TtfData, size_t TtfSize, const ImFontConfig& Config,
+               const char* CacheDirectory)
+{
+    assert(Atlas->Fonts.empty() && !Config.MergeMode);
+    const uint64_t Key = Priv::GetFontCacheKey(Atlas, TtfData, TtfSize, Config);
+
+    char FileName[260];
+    snprintf(FileName, sizeof(FileName), "%s/Font-%016llx.bin", CacheDirectory, (unsigned long long)Key);
+    if (Priv::LoadFontCache(Atlas, FileName, Key))
+        return true;
+
+    ImFontConfig FontConfig = Config;
+    FontConfig.FontDataOwnedByAtlas = false;
+    Atlas->AddFontFromMemoryTTF((void*)TtfData, (int)TtfSize, Config.SizePixels, &FontConfig);
+    Atlas->ParallelFor = ParallelForFontAtlas;
+    if (Atlas->Build() && Lib::MakeDirectory(CacheDirectory))
+        Priv::SaveFontCache(Atlas, FileName, Key);
+    return false;
+}
+
+static void
+MergeDrawCommands(const ImDrawData* DrawData, void* OutIndices, unsigned IndexSize, std::vector<TDraw>& OutDraws)
+{
+    if (IndexSize == 2)
+        Priv::MergeDrawCommands(DrawData, (uint16_t*)OutIndices, OutDraws);
+    else
+        Priv::MergeDrawCommands(DrawData, (uint32_t*)OutIndices, OutDraws);
+}
+
+// Copies the vertices of all draw lists, back to back, to OutVertices.
+static void
+CopyVertices(const ImDrawData* DrawData, ImDrawVert* OutVertices)
+{
+    std::vector<Priv::TCopy>& Copies = Priv::GCopies;
+    Copies.clear();
+
+    uint8_t* Destination = (uint8_t*)OutVertices;
+    for (unsigned N = 0; N < (unsigned)DrawData->CmdListsCount; ++N)
+    {
+        const ImDrawList* DrawList = DrawData->CmdLists[N];
+        const uint8_t* Source = (const uint8_t*)DrawList->VtxBuffer.Data;
+        size_t Remaining = DrawList->VtxBuffer.size() * sizeof(ImDrawVert);
+
+        while (Remaining > 0)
+        {
+            const unsigned Size = (unsigned)std::min(Remaining, (size_t)Priv::KCopyChunkSize);
+            Copies.push_back({ Destination, Source, Size });
+            Destination += Size;
+            Source += Size;
+            Remaining -= Size;
+        }
+    }
+
+    if (DrawData->TotalVtxCount * sizeof(ImDrawVert) < Priv::KMinParallelCopySize)
+        Priv::RunCopies(Copies.data(), 0, (unsigned)Copies.size());
+    else
+        Jobs::ParallelFor((unsigned)Copies.size(), 1, Priv::RunCopies, Copies.data());
+}
+
+// Starts loading the font and the shaders; Initialize() waits for them.
+static void
+RequestAssets()
+{
+    Load::Request("Data/Roboto-Medium.ttf", Priv::DecodeFont, Priv::CheckAsset, ImGui::GetIO().Fonts);
+#if !defined(DEMO_HEADLESS)
+    Load::Request("Data/Shaders/Gui.vs.cso", nullptr, Priv::KeepAsset, &Priv::GCsoVs);
+    Load::Request("Data/Shaders/Gui.ps.cso", nullptr, Priv::KeepAsset, &Priv::GCsoPs);
+#endif
+    Priv::GAssetsRequested = true;
+}
+
+static void
+Initialize()
+{
+    ImGuiIO& Io = ImGui::GetIO();
+    Io.RenderDrawListsFn = nullptr;
+    Io.DisplaySize = ImVec2((float)Dx::GResolution[0], (float)Dx::GResolution[1]);
+    ImGui::GetStyle().WindowRounding = 0.0f;
+
+    Priv::GGeometryStats = {};
+
+    uint8_t* Pixels;
+    int Width, Height;
+    // The atlas was built by BuildFontAtlas(); this returns its pixels. The texture holds only the
+    // coverage (R8); the view reads it as (1, 1, 1, coverage), which is what the RGBA32 expansion of
+    // the atlas would contain, at a quarter of the memory and upload size.
+    if (!Priv::GAssetsRequested)
+        RequestAssets();
+    Load::Flush();
+    Priv::GAssetsRequested = false;
+    assert(Io.Fonts->IsBuilt());
+    Io.Fonts->GetTexDataAsAlpha8(&Pixels, &Width, &Height);
+
+    Dx::AllocateDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1, Priv::GFontTextureDescriptor);
+
+#if !defined(DEMO_HEADLESS)
+    const auto TextureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8_UNORM, (UINT64)Width, Height);
+    VHR(Dx::GDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE,
+                                             &TextureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+                                             IID_PPV_ARGS(&Priv::GFontTexture)));
+
+    ID3D12Resource* IntermediateBuffer = nullptr;
+    {
+        uint64_t BufferSize;
+        Dx::GDevice->GetCopyableFootprints(&TextureDesc, 0, 1, 0, nullptr, nullptr, nullptr, &BufferSize);
+
+        const auto BufferDesc = CD3DX12_RESOURCE_DESC::Buffer(BufferSize);
+        VHR(Dx::GDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE,
+                                                 &BufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+                                                 IID_PPV_ARGS(&IntermediateBuffer)));
+
+        Dx::GIntermediateResources.push_back(IntermediateBuffer);
+    }
+
+    D3D12_SUBRESOURCE_DATA TextureData = { Pixels, (LONG_PTR)Width };
+    UpdateSubresources<1>(Dx::GCmdList.Native, Priv::GFontTexture, IntermediateBuffer, 0, 0, 1, &TextureData);
+
+    Cmd::ResourceBarrier(Dx::GCmdList, Priv::GFontTexture, D3D12_RESOURCE_STATE_COPY_DEST,
+                         D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    D3D12_SHADER_RESOURCE_VIEW_DESC SrvDesc = {};
+    SrvDesc.Shader4ComponentMapping = D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(
+        D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_1, D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_1,
+        D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_1, D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0);
+    SrvDesc.Format = DXGI_FORMAT_R8_UNORM;
+    SrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    SrvDesc.Texture2D.MipLevels = 1;
+
+    Dx::GDevice->CreateShaderResourceView(Priv::GFontTexture, &SrvDesc, Priv::GFontTextureDescriptor);
+#endif
+
+    // ImTextureID is the bindless index of the texture; the pixel shader gets it as a root constant.
+    Priv::GFontTextureIndex = Dx::AllocateBindlessDescriptor(Priv::GFontTextureDescriptor);
+    Io.Fonts->TexID = (ImTextureID)(intptr_t)Priv::GFontTextureIndex;
+
+#if !defined(DEMO_HEADLESS)
+    D3D12_INPUT_ELEMENT_DESC InputElements[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    };
+
+    const Load::TAsset& CsoVs = Priv::GCsoVs;
+    const Load::TAsset& CsoPs = Priv::GCsoPs;
+    assert(CsoVs.Data && CsoPs.Data);
+
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC PsoDesc = {};
+    PsoDesc.InputLayout = { InputElements, (unsigned)std::size(InputElements) };
+    PsoDesc.VS = { CsoVs.Data, CsoVs.Size };
+    PsoDesc.PS = { CsoPs.Data, CsoPs.Size };
+    PsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
+    PsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+    PsoDesc.BlendState.RenderTarget[0].BlendEnable = TRUE;
+    PsoDesc.BlendState.RenderTarget[0].SrcBlend = D3D12_BLEND_SRC_ALPHA;
+    PsoDesc.BlendState.RenderTarget[0].DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+    PsoDesc.BlendState.RenderTarget[0].BlendOp = D3D12_BLEND_OP_ADD;
+    PsoDesc.BlendState.RenderTarget[0].SrcBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA;
+    PsoDesc.BlendState.RenderTarget[0].DestBlendAlpha = D3D12_BLEND_ZERO;
+    PsoDesc.BlendState.RenderTarget[0].BlendOpAlpha = D3D12_BLEND_OP_ADD;
+    PsoDesc.BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+    PsoDesc.SampleMask = UINT_MAX;
+    PsoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    PsoDesc.NumRenderTargets = 1;
+    PsoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+    PsoDesc.SampleDesc.Count = 1;
+
+    VHR(Dx::GDevice->CreateGraphicsPipelineState(&PsoDesc, IID_PPV_ARGS(&Priv::GPipelineState)));
+    VHR(Dx::GDevice->CreateRootSignature(0, CsoVs.Data, CsoVs.Size, IID_PPV_ARGS(&Priv::GRootSignature)));
+
+    if (!Priv::GCsoVs.Mapped)
+        free(Priv::GCsoVs.Data);
+    if (!Priv::GCsoPs.Mapped)
+        free(Priv::GCsoPs.Data);
+    Priv::GCsoVs = {};
+    Priv::GCsoPs = {};
+#endif
+}
+
+static void
+Shutdown()
+{
+    // @Incomplete: Release all resources.
+    Dx::FreeBindlessDescriptor(Priv::GFontTextureIndex);
+    Dx::FreeDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, Priv::GFontTextureDescriptor, 1);
+}
+
+static void
+Update(float DeltaTime)
+{
+    PROF_ZONE("Gui::Update");
+    ImGuiIO& Io = ImGui::GetIO();
+    Io.DeltaTime = DeltaTime;
+}
+
+static void
+Render()
+{
+    PROF_ZONE("Gui::Render");
+    ImDrawData* DrawData = ImGui::GetDrawData();
+    if (!DrawData || DrawData->TotalVtxCount == 0)
+        return;
+
+    ImGuiIO& Io = ImGui::GetIO();
+    Cmd::TCommandList& CmdList = Dx::GCmdList;
+
+    const int ViewportWidth = (int)(Io.DisplaySize.x * Io.DisplayFramebufferScale.x);
+    const int ViewportHeight = (int)(Io.DisplaySize.y * Io.DisplayFramebufferScale.y);
+
+    // Merged draws index one global vertex space, which needs 32-bit indices past 64K vertices.
+    const unsigned IndexSize = DrawData->TotalVtxCount > 0xffff ? 4 : 2;
+    const unsigned VertexBufferSize = DrawData->TotalVtxCount * sizeof(ImDrawVert);
+    const unsigned IndexBufferSize = DrawData->TotalIdxCount * IndexSize;
+
+    // Vertices and indices live in the upload ring for one frame, at their exact sizes.
+    TGeometryStats& Stats = Priv::GGeometryStats;
+    Stats.VertexSize = VertexBufferSize;
+    Stats.IndexSize = IndexBufferSize;
+
+    D3D12_VERTEX_BUFFER_VIEW VertexBufferView;
+    void* VertexBufferCpuAddress = Dx::AllocateGpuUploadMemory(VertexBufferSize, VertexBufferView.BufferLocation);
+    VertexBufferView.SizeInBytes = VertexBufferSize;
+    VertexBufferView.StrideInBytes = sizeof(ImDrawVert);
+
+    D3D12_INDEX_BUFFER_VIEW IndexBufferView;
+    void* IndexBufferCpuAddress = Dx::AllocateGpuUploadMemory(IndexBufferSize, IndexBufferView.BufferLocation);
+    IndexBufferView.SizeInBytes = IndexBufferSize;
+    IndexBufferView.Format = IndexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+    // update vertex buffer, merge draw commands and write rebased indices
+    CopyVertices(DrawData, (ImDrawVert*)VertexBufferCpuAddress);
+    MergeDrawCommands(DrawData, IndexBufferCpuAddress, IndexSize, Priv::GDraws);
+
+    D3D12_GPU_VIRTUAL_ADDRESS ConstantBufferGpuAddress;
+    void* ConstantBufferCpuAddress = Dx::AllocateGpuUploadMemory(64, ConstantBufferGpuAddress);
+
+    // update constant buffer (transposed orthographic projection, same as XMMatrixOrthographicOffCenterLH)
+    {
+        const float L = 0.0f, R = (float)ViewportWidth, T = 0.0f, B = (float)ViewportHeight;
+        const float Matrix[4][4] =
+        {
+            { 2.0f / (R - L), 0.0f, 0.0f, (R + L) / (L - R) },
+            { 0.0f, 2.0f / (T - B), 0.0f, (T + B) / (B - T) },
+            { 0.0f, 0.0f, 1.0f, 0.0f },
+            { 0.0f, 0.0f, 0.0f, 1.0f },
+        };
+        memcpy(ConstantBufferCpuAddress, Matrix, sizeof(Matrix));
+    }
+
+    D3D12_VIEWPORT Viewport = { 0.0f, 0.0f, (float)ViewportWidth, (float)ViewportHeight, 0.0f, 1.0f };
+    Cmd::RSSetViewports(CmdList, Viewport);
+
+    Cmd::IASetPrimitiveTopology(CmdList, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    Cmd::SetPipelineState(CmdList, Priv::GPipelineState);
+
+    Cmd::SetGraphicsRootSignature(CmdList, Priv::GRootSignature);
+    Cmd::SetGraphicsRootConstantBufferView(CmdList, 0, ConstantBufferGpuAddress);
+    Cmd::SetGraphicsRootDescriptorTable(CmdList, 1, Dx::GetBindlessTable());
+
+    Cmd::IASetVertexBuffers(CmdList, 0, VertexBufferView);
+    Cmd::IASetIndexBuffer(CmdList, IndexBufferView);
+
+
+    const ImVec2 Scale = Io.DisplayFramebufferScale;
+    for (const TDraw& Draw : Priv::GDraws)
+    {
+        if (Draw.CallbackCmd)
+        {
+            Draw.CallbackCmd->UserCallback(Draw.CallbackList, Draw.CallbackCmd);
+        }
+        else
+        {
+            D3D12_RECT R = { (LONG)(Draw.ClipRect.x * Scale.x), (LONG)(Draw.ClipRect.y * Scale.y),
+                             (LONG)(Draw.ClipRect.z * Scale.x), (LONG)(Draw.ClipRect.w * Scale.y) };
+            Cmd::RSSetScissorRects(CmdList, R);
+            Cmd::SetGraphicsRoot32BitConstant(CmdList, 2, (uint32_t)(intptr_t)Draw.TextureId, 0);
+            Cmd::DrawIndexedInstanced(CmdList, Draw.ElemCount, 1, Draw.IndexOffset, 0, 0);
+        }
+    }
+}
+
+static const TGeometryStats&
+GetGeometryStats()
+{
+    return Priv::GGeometryStats;
+}
+
+} // namespace Gui
+// vim: set ts=4 sw=4 expandtab:
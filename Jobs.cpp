@@ -0,0 +1,455 @@
+namespace Jobs
+{
+namespace Priv
+{
+
+static const unsigned KDequeCapacity = 4096; // power of two
+static const unsigned KSpinCount = 64;
+
+// Deque slots are read by thieves while the owner may be writing them; a thief that read a torn slot
+// fails its CAS on Top and drops what it read.
+struct TSlot
+{
+    std::atomic<TJobFunc> Func;
+    std::atomic<void*> Context;
+    std::atomic<unsigned> Begin;
+    std::atomic<unsigned> End;
+    std::atomic<TCounter*> Counter;
+};
+
+// Chase-Lev work-stealing deque: the owner pushes and takes at Bottom, other threads steal at Top.
+struct TDeque
+{
+    alignas(64) std::atomic<int64_t> Top;
+    alignas(64) std::atomic<int64_t> Bottom;
+    alignas(64) TSlot Slots[KDequeCapacity];
+};
+
+struct TThread
+{
+    TDeque Deque;
+    std::thread Thread;
+    uint32_t Random;
+
+    // Written by the owner only.
+    alignas(64) std::atomic<uint64_t> JobCount;
+    std::atomic<uint64_t> StealCount;
+    std::atomic<uint64_t> InlineCount;
+    std::atomic<uint64_t> SleepCount;
+};
+
+// Jobs held back by RunAfter() until their dependency counter reaches zero.
+struct TPendingBatch
+{
+    TCounter* Dependency;
+    TCounter* Counter;
+    std::vector<TJob> Jobs;
+};
+
+static TThread* GThreads[KMaxThreads];
+static unsigned GThreadCount;
+static thread_local int GThreadIndex = -1;
+
+// Sleeping workers wait for GEpoch to change; it only changes under GSleepMutex.
+static std::mutex GSleepMutex;
+static std::condition_variable GSleepWake;
+static std::atomic<uint64_t> GEpoch;
+static std::atomic<unsigned> GSleepingCount;
+static bool GExit;
+
+static std::mutex GPendingMutex;
+static std::atomic<unsigned> GPendingCount;
+static std::vector<TPendingBatch> GPending;
+
+static inline void
+Increment(std::atomic<uint64_t>& Counter)
+{
+    Counter.store(Counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+static inline void
+Pause()
+{
+#if defined(DEMO_SSE2)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+static bool
+Push(TDeque& Deque, const TJob& Job, TCounter* Counter)
+{
+    const int64_t Bottom = Deque.Bottom.load(std::memory_order_relaxed);
+    const int64_t Top = Deque.Top.load(std::memory_order_acquire);
+    if (Bottom - Top >= (int64_t)KDequeCapacity)
+        return false;
+
+    TSlot& Slot = Deque.Slots[Bottom & (KDequeCapacity - 1)];
+    Slot.Func.store(Job.Func, std::memory_order_relaxed);
+    Slot.Context.store(Job.Context, std::memory_order_relaxed);
+    Slot.Begin.store(Job.Begin, std::memory_order_relaxed);
+    Slot.End.store(Job.End, std::memory_order_relaxed);
+    Slot.Counter.store(Counter, std::memory_order_relaxed);
+    Deque.Bottom.store(Bottom + 1, std::memory_order_release);
+    return true;
+}
+
+static inline void
+ReadSlot(const TSlot& Slot, TJob& OutJob, TCounter*& OutCounter)
+{
+    OutJob.Func = Slot.Func.load(std::memory_order_relaxed);
+    OutJob.Context = Slot.Context.load(std::memory_order_relaxed);
+    OutJob.Begin = Slot.Begin.load(std::memory_order_relaxed);
+    OutJob.End = Slot.End.load(std::memory_order_relaxed);
+    OutCounter = Slot.Counter.load(std::memory_order_relaxed);
+}
+
+static bool
+Take(TDeque& Deque, TJob& OutJob, TCounter*& OutCounter)
+{
+    const int64_t Bottom = Deque.Bottom.load(std::memory_order_relaxed) - 1;
+    Deque.Bottom.store(Bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t Top = Deque.Top.load(std::memory_order_relaxed);
+
+    if (Top > Bottom)
+    {
+        Deque.Bottom.store(Bottom + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    ReadSlot(Deque.Slots[Bottom & (KDequeCapacity - 1)], OutJob, OutCounter);
+    if (Top < Bottom)
+        return true;
+
+    // Last job: race the thieves for it.
+    const bool Won = Deque.Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst,
+                                                       std::memory_order_relaxed);
+    Deque.Bottom.store(Bottom + 1, std::memory_order_relaxed);
+    return Won;
+}
+
+static bool
+Steal(TDeque& Deque, TJob& OutJob, TCounter*& OutCounter)
+{
+    int64_t Top = Deque.Top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t Bottom = Deque.Bottom.load(std::memory_order_acquire);
+    if (Top >= Bottom)
+        return false;
+
+    ReadSlot(Deque.Slots[Top & (KDequeCapacity - 1)], OutJob, OutCounter);
+    return Deque.Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+// Own deque first, then one pass over the others starting at a random victim.
+static bool
+FindJob(unsigned ThreadIndex, TJob& OutJob, TCounter*& OutCounter)
+{
+    TThread& Thread = *GThreads[ThreadIndex];
+    if (Take(Thread.Deque, OutJob, OutCounter))
+        return true;
+
+    if (GThreadCount < 2)
+        return false;
+
+    Thread.Random = Thread.Random * 1664525 + 1013904223;
+    const unsigned First = (Thread.Random >> 8) % GThreadCount;
+    for (unsigned Offset = 0; Offset < GThreadCount; ++Offset)
+    {
+        const unsigned Victim = (First + Offset) % GThreadCount;
+        if (Victim != ThreadIndex && Steal(GThreads[Victim]->Deque, OutJob, OutCounter))
+        {
+            Increment(Thread.StealCount);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+Wake(unsigned JobCount)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (GSleepingCount.load(std::memory_order_relaxed) == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> Lock(GSleepMutex);
+        GEpoch.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (JobCount == 1)
+        GSleepWake.notify_one();
+    else
+        GSleepWake.notify_all();
+}
+
+static void Submit(const TJob* Jobs, unsigned Count, TCounter* Counter);
+
+// Called by the thread that brought Counter to zero.
+static void
+ReleasePending(TCounter* Counter)
+{
+    std::vector<TPendingBatch> Ready;
+    {
+        std::lock_guard<std::mutex> Lock(GPendingMutex);
+        for (size_t Index = 0; Index < GPending.size();)
+        {
+            if (GPending[Index].Dependency == Counter)
+            {
+                Ready.push_back(std::move(GPending[Index]));
+                GPending[Index] = std::move(GPending.back());
+                GPending.pop_back();
+                GPendingCount.fetch_sub(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                ++Index;
+            }
+        }
+    }
+    for (const TPendingBatch& Batch : Ready)
+        Submit(Batch.Jobs.data(), (unsigned)Batch.Jobs.size(), Batch.Counter);
+}
+
+static void
+Execute(unsigned ThreadIndex, const TJob& Job, TCounter* Counter)
+{
+    Job.Func(Job.Context, Job.Begin, Job.End);
+    Increment(GThreads[ThreadIndex]->JobCount);
+
+    if (Counter && Counter->Value.fetch_sub(1, std::memory_order_seq_cst) == 1 &&
+        GPendingCount.load(std::memory_order_seq_cst) > 0)
+        ReleasePending(Counter);
+}
+
+// Pushes jobs whose counter was already incremented; a job that does not fit runs right away.
+static void
+Submit(const TJob* Jobs, unsigned Count, TCounter* Counter)
+{
+    assert(GThreadIndex >= 0 && (unsigned)GThreadIndex < GThreadCount);
+    TThread& Thread = *GThreads[GThreadIndex];
+
+    unsigned PushedCount = 0;
+    for (unsigned Index = 0; Index < Count; ++Index)
+    {
+        if (Push(Thread.Deque, Jobs[Index], Counter))
+        {
+            PushedCount++;
+        }
+        else
+        {
+            Increment(Thread.InlineCount);
+            Execute(GThreadIndex, Jobs[Index], Counter);
+        }
+    }
+    if (PushedCount)
+        Wake(PushedCount);
+}
+
+static void
+RunWorker(unsigned ThreadIndex)
+{
+    GThreadIndex = (int)ThreadIndex;
+    TThread& Thread = *GThreads[ThreadIndex];
+
+    TJob Job;
+    TCounter* Counter;
+    for (;;)
+    {
+        bool Found = false;
+        for (unsigned Spin = 0; Spin < KSpinCount && !Found; ++Spin)
+        {
+            Found = FindJob(ThreadIndex, Job, Counter);
+            if (!Found)
+                Pause();
+        }
+
+        if (!Found)
+        {
+            // Announce the sleep before the last look, so that a concurrent Wake() either sees us
+            // sleeping or its jobs are found here.
+            const uint64_t Epoch = GEpoch.load(std::memory_order_relaxed);
+            GSleepingCount.fetch_add(1, std::memory_order_seq_cst);
+            Found = FindJob(ThreadIndex, Job, Counter);
+            if (!Found)
+            {
+                Increment(Thread.SleepCount);
+                std::unique_lock<std::mutex> Lock(GSleepMutex);
+                GSleepWake.wait(Lock, [&]() { return GExit || GEpoch.load(std::memory_order_relaxed) != Epoch; });
+            }
+            GSleepingCount.fetch_sub(1, std::memory_order_relaxed);
+
+            if (!Found)
+            {
+                if (GExit)
+                    return;
+                continue;
+            }
+        }
+        Execute(ThreadIndex, Job, Counter);
+    }
+}
+
+} // namespace Priv
+
+// One worker per hardware thread besides the main thread.
+static unsigned
+GetDefaultWorkerCount()
+{
+    const unsigned ThreadCount = std::thread::hardware_concurrency();
+    return ThreadCount > 1 ? std::min(ThreadCount, KMaxThreads) - 1 : 0;
+}
+
+// The calling thread becomes thread 0, which takes part in Wait() and ParallelFor().
+static void
+Initialize(unsigned WorkerCount)
+{
+    assert(Priv::GThreadCount == 0 && WorkerCount < KMaxThreads);
+
+    Priv::GExit = false;
+    Priv::GThreadCount = WorkerCount + 1;
+    for (unsigned Index = 0; Index < Priv::GThreadCount; ++Index)
+    {
+        Priv::GThreads[Index] = new Priv::TThread();
+        Priv::GThreads[Index]->Random = 0x9e3779b9 * (Index + 1);
+    }
+
+    Priv::GThreadIndex = 0;
+    for (unsigned Index = 1; Index < Priv::GThreadCount; ++Index)
+        Priv::GThreads[Index]->Thread = std::thread(Priv::RunWorker, Index);
+}
+
+static void
+Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> Lock(Priv::GSleepMutex);
+        Priv::GExit = true;
+        Priv::GEpoch.fetch_add(1, std::memory_order_relaxed);
+    }
+    Priv::GSleepWake.notify_all();
+
+    // Workers that are still running may steal from any deque, so none is freed before all have exited.
+    for (unsigned Index = 1; Index < Priv::GThreadCount; ++Index)
+        Priv::GThreads[Index]->Thread.join();
+    for (unsigned Index = 0; Index < Priv::GThreadCount; ++Index)
+    {
+        delete Priv::GThreads[Index];
+        Priv::GThreads[Index] = nullptr;
+    }
+    Priv::GThreadCount = 0;
+    Priv::GThreadIndex = -1;
+    assert(Priv::GPending.empty());
+}
+
+static unsigned
+GetWorkerCount()
+{
+    return Priv::GThreadCount > 0 ? Priv::GThreadCount - 1 : 0;
+}
+
+static unsigned
+GetThreadIndex()
+{
+    assert(Priv::GThreadIndex >= 0);
+    return (unsigned)Priv::GThreadIndex;
+}
+
+// Jobs are copied; Counter (if any) is incremented by Count and drops back as they finish.
+static void
+Run(const TJob* Jobs, unsigned Count, TCounter* Counter)
+{
+    if (Counter)
+        Counter->Value.fetch_add(Count, std::memory_order_relaxed);
+    Priv::Submit(Jobs, Count, Counter);
+}
+
+// Like Run(), but the jobs are not started before Dependency reaches zero. Dependency has to be
+// counting its jobs already: run a pipeline front to back.
+static void
+RunAfter(TCounter* Dependency, const TJob* Jobs, unsigned Count, TCounter* Counter)
+{
+    if (Counter)
+        Counter->Value.fetch_add(Count, std::memory_order_relaxed);
+
+    {
+        // Either the thread that zeroes Dependency sees GPendingCount > 0 and finds the batch, or the
+        // check below sees zero.
+        std::lock_guard<std::mutex> Lock(Priv::GPendingMutex);
+        Priv::GPendingCount.fetch_add(1, std::memory_order_seq_cst);
+        if (Dependency->Value.load(std::memory_order_seq_cst) != 0)
+        {
+            Priv::GPending.push_back({ Dependency, Counter, std::vector<TJob>(Jobs, Jobs + Count) });
+            return;
+        }
+        Priv::GPendingCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+    Priv::Submit(Jobs, Count, Counter);
+}
+
+// Runs jobs (own first, then stolen ones) until Counter reaches zero.
+static void
+Wait(TCounter* Counter)
+{
+    const unsigned ThreadIndex = GetThreadIndex();
+
+    TJob Job;
+    TCounter* JobCounter;
+    while (Counter->Value.load(std::memory_order_acquire) != 0)
+    {
+        if (Priv::FindJob(ThreadIndex, Job, JobCounter))
+            Priv::Execute(ThreadIndex, Job, JobCounter);
+        else
+            Priv::Pause();
+    }
+}
+
+// Splits [0, Count) into jobs of Grain items and waits for them. Runs inline without workers.
+static void
+ParallelFor(unsigned Count, unsigned Grain, TJobFunc Func, void* Context)
+{
+    assert(Grain > 0);
+    if (Count == 0)
+        return;
+
+    if (Priv::GThreadCount < 2 || Count <= Grain)
+    {
+        Func(Context, 0, Count);
+        return;
+    }
+
+    TCounter Counter = {};
+    TJob Jobs[64];
+    unsigned JobCount = 0;
+    for (unsigned Begin = 0; Begin < Count; Begin += Grain)
+    {
+        Jobs[JobCount++] = { Func, Context, Begin, std::min(Begin + Grain, Count) };
+        if (JobCount == std::size(Jobs))
+        {
+            Run(Jobs, JobCount, &Counter);
+            JobCount = 0;
+        }
+    }
+    Run(Jobs, JobCount, &Counter);
+    Wait(&Counter);
+}
+
+static TStats
+GetStats()
+{
+    TStats Stats = {};
+    for (unsigned Index = 0; Index < Priv::GThreadCount; ++Index)
+    {
+        const Priv::TThread& Thread = *Priv::GThreads[Index];
+        Stats.JobCount += Thread.JobCount.load(std::memory_order_relaxed);
+        Stats.StealCount += Thread.StealCount.load(std::memory_order_relaxed);
+        Stats.InlineCount += Thread.InlineCount.load(std::memory_order_relaxed);
+        Stats.SleepCount += Thread.SleepCount.load(std::memory_order_relaxed);
+    }
+    return Stats;
+}
+
+} // namespace Jobs
+// vim: set ts=4 sw=4 expandtab:
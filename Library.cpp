@@ -1,161 +1,192 @@
-namespace Lib
-{
-namespace Priv
-{
-
-static LRESULT CALLBACK
-ProcessWindowMessage(HWND Window, UINT Message, WPARAM WParam, LPARAM LParam)
-{
-    ImGuiIO& Io = ImGui::GetIO();
-
-    switch (Message)
-    {
-    case WM_LBUTTONDOWN:
-        Io.MouseDown[0] = true;
-        return 0;
-    case WM_LBUTTONUP:
-        Io.MouseDown[0] = false;
-        return 0;
-    case WM_RBUTTONDOWN:
-        Io.MouseDown[1] = true;
-        return 0;
-    case WM_RBUTTONUP:
-        Io.MouseDown[1] = false;
-        return 0;
-    case WM_MBUTTONDOWN:
-        Io.MouseDown[2] = true;
-        return 0;
-    case WM_MBUTTONUP:
-        Io.MouseDown[2] = false;
-        return 0;
-    case WM_MOUSEWHEEL:
-        Io.MouseWheel += GET_WHEEL_DELTA_WPARAM(WParam) > 0 ? 1.0f : -1.0f;
-        return 0;
-    case WM_MOUSEMOVE:
-        Io.MousePos.x = (signed short)(LParam);
-        Io.MousePos.y = (signed short)(LParam >> 16);
-        return 0;
-    case WM_DESTROY:
-        PostQuitMessage(0);
-        return 0;
-    case WM_KEYDOWN:
-        {
-            if (WParam < 256)
-            {
-                Io.KeysDown[WParam] = true;
-                if (WParam == VK_ESCAPE)
-                    PostQuitMessage(0);
-                return 0;
-            }
-        }
-        break;
-    case WM_KEYUP:
-        {
-            if (WParam < 256)
-            {
-                Io.KeysDown[WParam] = false;
-                return 0;
-            }
-        }
-        break;
-    case WM_CHAR:
-        {
-            if (WParam > 0 && WParam < 0x10000)
-            {
-                Io.AddInputCharacter((unsigned short)WParam);
-                return 0;
-            }
-        }
-        break;
-    }
-    return DefWindowProc(Window, Message, WParam, LParam);
-}
-
-} // namespace Priv
-
-static std::vector<uint8_t>
-LoadFile(const char* FileName)
-{
-    FILE* File = fopen(FileName, "rb");
-    assert(File);
-    fseek(File, 0, SEEK_END);
-    long Size = ftell(File);
-    assert(Size != -1);
-    std::vector<uint8_t> Content(Size);
-    fseek(File, 0, SEEK_SET);
-    fread(&Content[0], 1, Content.size(), File);
-    fclose(File);
-    return Content;
-}
-
-static double
-GetTime()
-{
-    static LARGE_INTEGER StartCounter;
-    static LARGE_INTEGER Frequency;
-    if (StartCounter.QuadPart == 0)
-    {
-        QueryPerformanceFrequency(&Frequency);
-        QueryPerformanceCounter(&StartCounter);
-    }
-    LARGE_INTEGER Counter;
-    QueryPerformanceCounter(&Counter);
-    return (Counter.QuadPart - StartCounter.QuadPart) / (double)Frequency.QuadPart;
-}
-
-static void
-UpdateFrameStats(HWND Window, const char* Name, double& OutTime, float& OutDeltaTime)
-{
-    static double PreviousTime = -1.0;
-    static double HeaderRefreshTime = 0.0;
-    static unsigned FrameCount = 0;
-
-    if (PreviousTime < 0.0)
-    {
-        PreviousTime = GetTime();
-        HeaderRefreshTime = PreviousTime;
-    }
-
-    OutTime = GetTime();
-    OutDeltaTime = (float)(OutTime - PreviousTime);
-    PreviousTime = OutTime;
-
-    if ((OutTime - HeaderRefreshTime) >= 1.0)
-    {
-        const double FramesPerSecond = FrameCount / (OutTime - HeaderRefreshTime);
-        const double MilliSeconds = (1.0 / FramesPerSecond) * 1000.0;
-        char Header[256];
-        snprintf(Header, sizeof(Header), "[%.1f fps  %.3f ms] %s", FramesPerSecond, MilliSeconds, Name);
-        SetWindowText(Window, Header);
-        HeaderRefreshTime = OutTime;
-        FrameCount = 0;
-    }
-    FrameCount++;
-}
-
-static HWND
-InitializeWindow(const char* Name, unsigned Width, unsigned Height)
-{
-    WNDCLASS WinClass = {};
-    WinClass.lpfnWndProc = Priv::ProcessWindowMessage;
-    WinClass.hInstance = GetModuleHandle(nullptr);
-    WinClass.hCursor = LoadCursor(nullptr, IDC_ARROW);
-    WinClass.lpszClassName = Name;
-    if (!RegisterClass(&WinClass))
-        assert(0);
-
-    RECT Rect = { 0, 0, (LONG)Width, (LONG)Height };
-    if (!AdjustWindowRect(&Rect, WS_OVERLAPPED | WS_SYSMENU | WS_CAPTION | WS_MINIMIZEBOX, 0))
-        assert(0);
-
-    HWND Window = CreateWindowEx(
-        0, Name, Name, WS_OVERLAPPED | WS_SYSMENU | WS_CAPTION | WS_MINIMIZEBOX | WS_VISIBLE,
-        CW_USEDEFAULT, CW_USEDEFAULT,
-        Rect.right - Rect.left, Rect.bottom - Rect.top,
-        nullptr, nullptr, nullptr, 0);
-    assert(Window);
-    return Window;
-}
-
-} // namespace Lib
-// vim: set ts=4 sw=4 expandtab:
+namespace Lib
+{
+
+static TMappedFile
+MapFile(const char* FileName)
+{
+    TMappedFile Mapped = {};
+#if defined(_WIN32)
+    HANDLE File = CreateFileA(FileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (File == INVALID_HANDLE_VALUE)
+        return Mapped;
+
+    LARGE_INTEGER Size;
+    if (GetFileSizeEx(File, &Size) && Size.QuadPart > 0)
+    {
+        // The view keeps the mapping and the file open.
+        HANDLE Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (Mapping)
+        {
+            Mapped.Data = (const uint8_t*)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+            Mapped.Size = Mapped.Data ? (size_t)Size.QuadPart : 0;
+            CloseHandle(Mapping);
+        }
+    }
+    CloseHandle(File);
+#else
+    const int File = open(FileName, O_RDONLY);
+    if (File < 0)
+        return Mapped;
+
+    struct stat Stat;
+    if (fstat(File, &Stat) == 0 && Stat.st_size > 0)
+    {
+        void* Data = mmap(nullptr, (size_t)Stat.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+        if (Data != MAP_FAILED)
+        {
+            Mapped.Data = (const uint8_t*)Data;
+            Mapped.Size = (size_t)Stat.st_size;
+        }
+    }
+    close(File);
+#endif
+    return Mapped;
+}
+
+static void
+UnmapFile(TMappedFile& File)
+{
+    if (!File.Data)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(File.Data);
+#else
+    munmap((void*)File.Data, File.Size);
+#endif
+    File = {};
+}
+
+static bool
+MakeDirectory(const char* Path)
+{
+#if defined(_WIN32)
+    return CreateDirectoryA(Path, nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    return mkdir(Path, 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+static double
+GetTime()
+{
+#if defined(_WIN32)
+    static LARGE_INTEGER StartCounter;
+    static LARGE_INTEGER Frequency;
+    if (StartCounter.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&Frequency);
+        QueryPerformanceCounter(&StartCounter);
+    }
+    LARGE_INTEGER Counter;
+    QueryPerformanceCounter(&Counter);
+    return (Counter.QuadPart - StartCounter.QuadPart) / (double)Frequency.QuadPart;
+#else
+    static timespec StartCounter;
+    if (StartCounter.tv_sec == 0 && StartCounter.tv_nsec == 0)
+        clock_gettime(CLOCK_MONOTONIC, &StartCounter);
+
+    timespec Counter;
+    clock_gettime(CLOCK_MONOTONIC, &Counter);
+    return (double)(Counter.tv_sec - StartCounter.tv_sec) + (Counter.tv_nsec - StartCounter.tv_nsec) * 1e-9;
+#endif
+}
+
+static void
+StreamCopy(void* Destination, const void* Source, size_t Size)
+{
+#if defined(DEMO_SSE2)
+    uint8_t* Dst = (uint8_t*)Destination;
+    const uint8_t* Src = (const uint8_t*)Source;
+
+    const size_t Head = std::min(Size, (size_t)(-(uintptr_t)Dst & 15));
+    memcpy(Dst, Src, Head);
+    Dst += Head;
+    Src += Head;
+    Size -= Head;
+
+    for (; Size >= 64; Size -= 64, Dst += 64, Src += 64)
+    {
+        const __m128i A = _mm_loadu_si128((const __m128i*)Src + 0);
+        const __m128i B = _mm_loadu_si128((const __m128i*)Src + 1);
+        const __m128i C = _mm_loadu_si128((const __m128i*)Src + 2);
+        const __m128i D = _mm_loadu_si128((const __m128i*)Src + 3);
+        _mm_stream_si128((__m128i*)Dst + 0, A);
+        _mm_stream_si128((__m128i*)Dst + 1, B);
+        _mm_stream_si128((__m128i*)Dst + 2, C);
+        _mm_stream_si128((__m128i*)Dst + 3, D);
+    }
+    for (; Size >= 16; Size -= 16, Dst += 16, Src += 16)
+        _mm_stream_si128((__m128i*)Dst, _mm_loadu_si128((const __m128i*)Src));
+
+    memcpy(Dst, Src, Size);
+    _mm_sfence();
+#else
+    memcpy(Destination, Source, Size);
+#endif
+}
+
+static uint32_t
+GetCpuFeatures()
+{
+    uint32_t Features = 0;
+#if defined(DEMO_SSE2) && defined(_MSC_VER)
+    int Info[4];
+    __cpuid(Info, 0);
+    const int LeafCount = Info[0];
+    __cpuid(Info, 1);
+    if (Info[2] & (1 << 19))
+        Features |= KCpuSse41;
+    // AVX needs OSXSAVE and the OS saving the XMM and YMM state.
+    const bool Avx = (Info[2] & (1 << 27)) && (Info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+    if (Avx && LeafCount >= 7)
+    {
+        __cpuidex(Info, 7, 0);
+        if (Info[1] & (1 << 5))
+            Features |= KCpuAvx2;
+    }
+#elif defined(DEMO_SSE2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1"))
+        Features |= KCpuSse41;
+    if (__builtin_cpu_supports("avx2"))
+        Features |= KCpuAvx2;
+#endif
+#if defined(DEMO_NEON)
+    Features |= KCpuNeon; // part of AArch64
+#endif
+    return Features;
+}
+
+static void
+UpdateFrameStats(Plat::TWindow Window, const char* Name, double& OutTime, float& OutDeltaTime)
+{
+    static double PreviousTime = -1.0;
+    static double HeaderRefreshTime = 0.0;
+    static unsigned FrameCount = 0;
+
+    if (PreviousTime < 0.0)
+    {
+        PreviousTime = Plat::GetFrameTime();
+        HeaderRefreshTime = PreviousTime;
+    }
+
+    OutTime = Plat::GetFrameTime();
+    OutDeltaTime = (float)(OutTime - PreviousTime);
+    PreviousTime = OutTime;
+
+    if ((OutTime - HeaderRefreshTime) >= 1.0)
+    {
+        const double FramesPerSecond = FrameCount / (OutTime - HeaderRefreshTime);
+        const double MilliSeconds = (1.0 / FramesPerSecond) * 1000.0;
+        char Header[256];
+        snprintf(Header, sizeof(Header), "[%.1f fps  %.3f ms] %s", FramesPerSecond, MilliSeconds, Name);
+        Plat::SetWindowTitle(Window, Header);
+        HeaderRefreshTime = OutTime;
+        FrameCount = 0;
+    }
+    FrameCount++;
+}
+
+} // namespace Lib
+// vim: set ts=4 sw=4 expandtab:
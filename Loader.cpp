@@ -0,0 +1,608 @@
+namespace Load
+{
+namespace Priv
+{
+
+static const unsigned KBatchSize = 32;
+static const unsigned KReaderThreadCount = 4;
+
+struct TEntry
+{
+    TAsset Asset;
+    TDecodeFunc Decode;
+    TCompleteFunc Complete;
+    const Pak::TEntry* PakEntry; // compressed in the archive; its decode job decompresses it first
+};
+
+// Entries read together and decoded by one set of jobs; completed in order once Counter drops to zero.
+struct TDecodeBatch
+{
+    std::vector<TEntry*> Entries;
+    Jobs::TCounter Counter;
+};
+
+// GQueue (requests not yet taken by an I/O thread), GRead (read, not yet handed to decode jobs),
+// GUnreadCount (requests not in GRead yet) and GStats are guarded by GMutex.
+static std::mutex GMutex;
+static std::condition_variable GQueueWake;
+static std::condition_variable GReadWake;
+static std::vector<TEntry*> GQueue;
+static std::vector<TEntry*> GRead;
+static unsigned GUnreadCount;
+static TStats GStats;
+static bool GExit;
+static std::vector<std::thread> GIoThreads;
+
+// Read-only while mounted.
+static Pak::TArchive GArchive;
+
+// main thread only
+static std::vector<TDecodeBatch*> GDecoding;
+static std::vector<Jobs::TJob> GDecodeJobs;
+static unsigned GPendingCount;
+
+#if defined(DEMO_IO_URING)
+
+// The submission and completion rings shared with the kernel (see io_uring(7)); only the I/O thread
+// uses them.
+struct TUring
+{
+    int Fd;
+    unsigned* SqHead;
+    unsigned* SqTail;
+    unsigned* SqArray;
+    unsigned SqMask;
+    unsigned* CqHead;
+    unsigned* CqTail;
+    unsigned CqMask;
+    io_uring_sqe* Sqes;
+    io_uring_cqe* Cqes;
+    void* SqRing;
+    size_t SqRingSize;
+    void* CqRing;
+    size_t CqRingSize;
+    size_t SqesSize;
+};
+
+static TUring GUring; // Initialize() sets Fd to -1 before creating it
+
+static void
+DestroyUring()
+{
+    TUring& Ring = GUring;
+    if (Ring.Fd < 0)
+        return;
+
+    munmap(Ring.Sqes, Ring.SqesSize);
+    if (Ring.CqRing != Ring.SqRing)
+        munmap(Ring.CqRing, Ring.CqRingSize);
+    munmap(Ring.SqRing, Ring.SqRingSize);
+    close(Ring.Fd);
+    Ring = {};
+    Ring.Fd = -1;
+}
+
+static bool
+CreateUring()
+{
+    TUring& Ring = GUring;
+    io_uring_params Params = {};
+    Ring = {};
+    Ring.Fd = (int)syscall(__NR_io_uring_setup, KBatchSize, &Params);
+    if (Ring.Fd < 0)
+        return false;
+
+    Ring.SqRingSize = Params.sq_off.array + Params.sq_entries * sizeof(unsigned);
+    Ring.CqRingSize = Params.cq_off.cqes + Params.cq_entries * sizeof(io_uring_cqe);
+    if (Params.features & IORING_FEAT_SINGLE_MMAP)
+        Ring.SqRingSize = Ring.CqRingSize = std::max(Ring.SqRingSize, Ring.CqRingSize);
+
+    Ring.SqRing = mmap(nullptr, Ring.SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Ring.Fd,
+                       IORING_OFF_SQ_RING);
+    Ring.CqRing = Ring.SqRing;
+    if (Ring.SqRing != MAP_FAILED && !(Params.features & IORING_FEAT_SINGLE_MMAP))
+        Ring.CqRing = mmap(nullptr, Ring.CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Ring.Fd,
+                           IORING_OFF_CQ_RING);
+    Ring.SqesSize = Params.sq_entries * sizeof(io_uring_sqe);
+    Ring.Sqes = (io_uring_sqe*)mmap(nullptr, Ring.SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                    Ring.Fd, IORING_OFF_SQES);
+
+    if (Ring.SqRing == MAP_FAILED || Ring.CqRing == MAP_FAILED || Ring.Sqes == MAP_FAILED)
+    {
+        if (Ring.Sqes != MAP_FAILED)
+            munmap(Ring.Sqes, Ring.SqesSize);
+        if (Ring.CqRing != MAP_FAILED && Ring.CqRing != Ring.SqRing)
+            munmap(Ring.CqRing, Ring.CqRingSize);
+        if (Ring.SqRing != MAP_FAILED)
+            munmap(Ring.SqRing, Ring.SqRingSize);
+        close(Ring.Fd);
+        Ring = {};
+        Ring.Fd = -1;
+        return false;
+    }
+
+    uint8_t* Sq = (uint8_t*)Ring.SqRing;
+    uint8_t* Cq = (uint8_t*)Ring.CqRing;
+    Ring.SqHead = (unsigned*)(Sq + Params.sq_off.head);
+    Ring.SqTail = (unsigned*)(Sq + Params.sq_off.tail);
+    Ring.SqArray = (unsigned*)(Sq + Params.sq_off.array);
+    Ring.SqMask = *(unsigned*)(Sq + Params.sq_off.ring_mask);
+    Ring.CqHead = (unsigned*)(Cq + Params.cq_off.head);
+    Ring.CqTail = (unsigned*)(Cq + Params.cq_off.tail);
+    Ring.CqMask = *(unsigned*)(Cq + Params.cq_off.ring_mask);
+    Ring.Cqes = (io_uring_cqe*)(Cq + Params.cq_off.cqes);
+    return true;
+}
+
+#endif
+
+static void
+FailAsset(TAsset& Asset)
+{
+    free(Asset.Data);
+    Asset.Data = nullptr;
+    Asset.Size = 0;
+    Asset.Failed = true;
+}
+
+// Opens the file and allocates Data for all of it; on Linux leaves the descriptor in OutFile for the
+// reads. Returns false (with the asset failed) if the file can't be opened.
+#if defined(_WIN32)
+static bool
+OpenAsset(TAsset& Asset, HANDLE& OutFile)
+{
+    OutFile = CreateFileA(Asset.FileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                          FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER Size;
+    if (OutFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(OutFile, &Size))
+    {
+        if (OutFile != INVALID_HANDLE_VALUE)
+            CloseHandle(OutFile);
+        FailAsset(Asset);
+        return false;
+    }
+    Asset.Size = (size_t)Size.QuadPart;
+    Asset.Data = (uint8_t*)malloc(std::max(Asset.Size, (size_t)1));
+    return true;
+}
+#else
+static bool
+OpenAsset(TAsset& Asset, int& OutFile)
+{
+    OutFile = open(Asset.FileName, O_RDONLY);
+    struct stat Stat;
+    if (OutFile < 0 || fstat(OutFile, &Stat) != 0)
+    {
+        if (OutFile >= 0)
+            close(OutFile);
+        FailAsset(Asset);
+        return false;
+    }
+    Asset.Size = (size_t)Stat.st_size;
+    Asset.Data = (uint8_t*)malloc(std::max(Asset.Size, (size_t)1));
+    return true;
+}
+#endif
+
+// Blocking read of a whole file, what the reader threads do.
+static void
+ReadAsset(TAsset& Asset)
+{
+#if defined(_WIN32)
+    HANDLE File;
+    if (!OpenAsset(Asset, File))
+        return;
+
+    size_t Done = 0;
+    while (Done < Asset.Size)
+    {
+        DWORD Read = 0;
+        const DWORD Chunk = (DWORD)std::min(Asset.Size - Done, (size_t)1 << 30);
+        if (!::ReadFile(File, Asset.Data + Done, Chunk, &Read, nullptr) || Read == 0)
+            break;
+        Done += Read;
+    }
+    CloseHandle(File);
+#else
+    int File;
+    if (!OpenAsset(Asset, File))
+        return;
+
+    size_t Done = 0;
+    while (Done < Asset.Size)
+    {
+        const ssize_t Read = pread(File, Asset.Data + Done, Asset.Size - Done, (off_t)Done);
+        if (Read < 0 && errno == EINTR)
+            continue;
+        if (Read <= 0)
+            break;
+        Done += (size_t)Read;
+    }
+    close(File);
+#endif
+    if (Done != Asset.Size)
+        FailAsset(Asset);
+}
+
+#if defined(DEMO_IO_URING)
+
+// Reads a batch of files with one io_uring submission (plus more for short reads). A kernel without
+// IORING_OP_READ fails the reads with EINVAL; those files are read the blocking way.
+static void
+ReadBatchUring(TEntry** Entries, unsigned Count)
+{
+    TUring& Ring = GUring;
+    int Files[KBatchSize];
+    size_t Done[KBatchSize];
+
+    assert(Count <= KBatchSize);
+    for (unsigned Index = 0; Index < Count; ++Index)
+    {
+        Done[Index] = 0;
+        if (!OpenAsset(Entries[Index]->Asset, Files[Index]))
+            Files[Index] = -1;
+    }
+
+    for (;;)
+    {
+        unsigned Submitted = 0;
+        unsigned Tail = *Ring.SqTail;
+        for (unsigned Index = 0; Index < Count; ++Index)
+        {
+            TAsset& Asset = Entries[Index]->Asset;
+            if (Files[Index] < 0 || Done[Index] == Asset.Size)
+                continue;
+
+            const unsigned Slot = Tail & Ring.SqMask;
+            io_uring_sqe& Sqe = Ring.Sqes[Slot];
+            memset(&Sqe, 0, sizeof(Sqe));
+            Sqe.opcode = IORING_OP_READ;
+            Sqe.fd = Files[Index];
+            Sqe.addr = (uint64_t)(uintptr_t)(Asset.Data + Done[Index]);
+            Sqe.len = (unsigned)std::min(Asset.Size - Done[Index], (size_t)1 << 30);
+            Sqe.off = Done[Index];
+            Sqe.user_data = Index;
+            Ring.SqArray[Slot] = Slot;
+            Tail++;
+            Submitted++;
+        }
+        if (Submitted == 0)
+            break;
+        __atomic_store_n(Ring.SqTail, Tail, __ATOMIC_RELEASE);
+
+        int Result;
+        do
+        {
+            Result = (int)syscall(__NR_io_uring_enter, Ring.Fd, Submitted, Submitted, IORING_ENTER_GETEVENTS,
+                                  nullptr, 0);
+        } while (Result < 0 && errno == EINTR);
+
+        unsigned Completed = 0;
+        while (Completed < Submitted && Result >= 0)
+        {
+            unsigned Head = *Ring.CqHead;
+            const unsigned CqTail = __atomic_load_n(Ring.CqTail, __ATOMIC_ACQUIRE);
+            for (; Head != CqTail; ++Head, ++Completed)
+            {
+                const io_uring_cqe& Cqe = Ring.Cqes[Head & Ring.CqMask];
+                const unsigned Index = (unsigned)Cqe.user_data;
+                if (Cqe.res > 0)
+                {
+                    Done[Index] += (size_t)Cqe.res;
+                }
+                else if (Cqe.res == -EINVAL || Cqe.res == -EOPNOTSUPP)
+                {
+                    close(Files[Index]);
+                    Files[Index] = -1;
+                    FailAsset(Entries[Index]->Asset);
+                    Entries[Index]->Asset.Failed = false;
+                    ReadAsset(Entries[Index]->Asset);
+                }
+                else
+                {
+                    close(Files[Index]);
+                    Files[Index] = -1;
+                    FailAsset(Entries[Index]->Asset);
+                }
+            }
+            __atomic_store_n(Ring.CqHead, Head, __ATOMIC_RELEASE);
+            if (Completed < Submitted)
+            {
+                do
+                {
+                    Result = (int)syscall(__NR_io_uring_enter, Ring.Fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                } while (Result < 0 && errno == EINTR);
+            }
+        }
+        if (Result < 0)
+        {
+            // The ring is unusable; finish the batch with blocking reads.
+            for (unsigned Index = 0; Index < Count; ++Index)
+            {
+                if (Files[Index] < 0)
+                    continue;
+                close(Files[Index]);
+                Files[Index] = -1;
+                FailAsset(Entries[Index]->Asset);
+                Entries[Index]->Asset.Failed = false;
+                ReadAsset(Entries[Index]->Asset);
+            }
+            break;
+        }
+    }
+
+    for (unsigned Index = 0; Index < Count; ++Index)
+    {
+        if (Files[Index] >= 0)
+            close(Files[Index]);
+    }
+}
+
+#endif
+
+// With io_uring there is one I/O thread taking up to KBatchSize requests at a time, otherwise
+// KReaderThreadCount threads each reading one file at a time.
+static void
+RunIoThread(bool UseUring)
+{
+    std::vector<TEntry*> Batch;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> Lock(GMutex);
+            while (!GExit && GQueue.empty())
+                GQueueWake.wait(Lock);
+            if (GQueue.empty())
+                return;
+
+            const size_t Count = std::min(GQueue.size(), (size_t)(UseUring ? KBatchSize : 1));
+            Batch.assign(GQueue.begin(), GQueue.begin() + Count);
+            GQueue.erase(GQueue.begin(), GQueue.begin() + Count);
+        }
+
+#if defined(DEMO_IO_URING)
+        if (UseUring)
+            ReadBatchUring(Batch.data(), (unsigned)Batch.size());
+        else
+#endif
+        {
+            for (TEntry* Entry : Batch)
+                ReadAsset(Entry->Asset);
+        }
+
+        {
+            std::lock_guard<std::mutex> Lock(GMutex);
+            GStats.BatchCount++;
+            for (TEntry* Entry : Batch)
+                GStats.ByteCount += Entry->Asset.Size;
+            GRead.insert(GRead.end(), Batch.begin(), Batch.end());
+            GUnreadCount -= (unsigned)Batch.size();
+        }
+        GReadWake.notify_all();
+    }
+}
+
+// Decompresses an entry of the mounted archive from its mapping.
+static void
+ExtractAsset(TEntry& Entry)
+{
+    TAsset& Asset = Entry.Asset;
+    Asset.Size = (size_t)Entry.PakEntry->OriginalSize;
+    Asset.Data = (uint8_t*)malloc(std::max(Asset.Size, (size_t)1));
+    if (!Pak::Decompress(GArchive, *Entry.PakEntry, Asset.Data))
+        FailAsset(Asset);
+}
+
+// Whether the entry needs a decode job: to decompress it, or to run its Decode.
+static inline bool
+NeedsDecodeJob(const TEntry& Entry)
+{
+    return Entry.PakEntry || (Entry.Decode && !Entry.Asset.Failed);
+}
+
+static void
+DecodeAssets(void* Context, unsigned Begin, unsigned End)
+{
+    TDecodeBatch& Batch = *(TDecodeBatch*)Context;
+    for (unsigned Index = Begin; Index < End; ++Index)
+    {
+        TEntry& Entry = *Batch.Entries[Index];
+        if (Entry.PakEntry)
+            ExtractAsset(Entry);
+        if (Entry.Decode && !Entry.Asset.Failed)
+            Entry.Decode(Entry.Asset);
+    }
+}
+
+} // namespace Priv
+
+static void
+Initialize(bool AllowIoUring)
+{
+    assert(Priv::GIoThreads.empty());
+    Priv::GExit = false;
+    Priv::GStats = {};
+    Priv::GPendingCount = 0;
+    Priv::GUnreadCount = 0;
+
+#if defined(DEMO_IO_URING)
+    Priv::GUring = {};
+    Priv::GUring.Fd = -1;
+    Priv::GStats.IoUring = AllowIoUring && Priv::CreateUring();
+#endif
+    const unsigned ThreadCount = Priv::GStats.IoUring ? 1 : Priv::KReaderThreadCount;
+    for (unsigned Index = 0; Index < ThreadCount; ++Index)
+        Priv::GIoThreads.push_back(std::thread(Priv::RunIoThread, Priv::GStats.IoUring));
+}
+
+// Completes what was requested, then stops the I/O threads.
+static void
+Shutdown()
+{
+    Flush();
+    {
+        std::lock_guard<std::mutex> Lock(Priv::GMutex);
+        Priv::GExit = true;
+    }
+    Priv::GQueueWake.notify_all();
+
+    for (std::thread& Thread : Priv::GIoThreads)
+        Thread.join();
+    Priv::GIoThreads.clear();
+    Pak::Close(Priv::GArchive);
+#if defined(DEMO_IO_URING)
+    Priv::DestroyUring();
+#endif
+}
+
+static void
+Request(const char* FileName, TDecodeFunc Decode, TCompleteFunc Complete, void* Context)
+{
+    Priv::TEntry* Entry = new Priv::TEntry();
+    snprintf(Entry->Asset.FileName, sizeof(Entry->Asset.FileName), "%s", FileName);
+    Entry->Asset.Context = Context;
+    Entry->Decode = Decode;
+    Entry->Complete = Complete;
+
+    const Pak::TEntry* PakEntry = Priv::GArchive.EntryCount ? Pak::Find(Priv::GArchive, FileName) : nullptr;
+    if (PakEntry && !(PakEntry->Flags & Pak::KEntryLz4))
+    {
+        Entry->Asset.Data = (uint8_t*)Pak::GetBlob(Priv::GArchive, *PakEntry);
+        Entry->Asset.Size = (size_t)PakEntry->Size;
+        Entry->Asset.Mapped = true;
+    }
+    else
+    {
+        Entry->PakEntry = PakEntry;
+    }
+
+    Priv::GPendingCount++;
+    {
+        std::lock_guard<std::mutex> Lock(Priv::GMutex);
+        Priv::GStats.RequestCount++;
+        Priv::GStats.ArchiveCount += PakEntry != nullptr;
+        if (PakEntry)
+        {
+            Priv::GRead.push_back(Entry);
+        }
+        else
+        {
+            Priv::GQueue.push_back(Entry);
+            Priv::GUnreadCount++;
+        }
+    }
+    if (!PakEntry)
+        Priv::GQueueWake.notify_one();
+}
+
+static bool
+MountArchive(const char* FileName)
+{
+    assert(Priv::GArchive.EntryCount == 0 && Priv::GPendingCount == 0);
+    return Pak::Open(FileName, Priv::GArchive);
+}
+
+static void
+Update()
+{
+    Priv::TDecodeBatch* Batch = nullptr;
+    {
+        std::lock_guard<std::mutex> Lock(Priv::GMutex);
+        if (!Priv::GRead.empty())
+        {
+            Batch = new Priv::TDecodeBatch();
+            Batch->Entries.swap(Priv::GRead);
+        }
+    }
+
+    if (Batch)
+    {
+        std::vector<Jobs::TJob>& DecodeJobs = Priv::GDecodeJobs;
+        DecodeJobs.clear();
+        for (unsigned Index = 0; Index < (unsigned)Batch->Entries.size(); ++Index)
+        {
+            if (Priv::NeedsDecodeJob(*Batch->Entries[Index]))
+                DecodeJobs.push_back({ Priv::DecodeAssets, Batch, Index, Index + 1 });
+        }
+        // Without workers nobody would run the jobs before the main thread waits; decode right away.
+        if (Jobs::GetWorkerCount() == 0)
+            Priv::DecodeAssets(Batch, 0, (unsigned)Batch->Entries.size());
+        else if (!DecodeJobs.empty())
+            Jobs::Run(DecodeJobs.data(), (unsigned)DecodeJobs.size(), &Batch->Counter);
+        Priv::GDecoding.push_back(Batch);
+    }
+
+    unsigned CompleteCount = 0;
+    while (!Priv::GDecoding.empty() && Priv::GDecoding[0]->Counter.Value.load(std::memory_order_acquire) == 0)
+    {
+        Priv::TDecodeBatch* Decoded = Priv::GDecoding[0];
+        Priv::GDecoding.erase(Priv::GDecoding.begin());
+
+        for (Priv::TEntry* Entry : Decoded->Entries)
+        {
+            if (Entry->Complete)
+                Entry->Complete(Entry->Asset);
+            if (!Entry->Asset.Mapped)
+                free(Entry->Asset.Data);
+            delete Entry;
+        }
+        CompleteCount += (unsigned)Decoded->Entries.size();
+        delete Decoded;
+    }
+
+    if (CompleteCount)
+    {
+        Priv::GPendingCount -= CompleteCount;
+        std::lock_guard<std::mutex> Lock(Priv::GMutex);
+        Priv::GStats.CompleteCount += CompleteCount;
+    }
+}
+
+static void
+WaitForReads()
+{
+    {
+        std::unique_lock<std::mutex> Lock(Priv::GMutex);
+        while (Priv::GUnreadCount)
+            Priv::GReadWake.wait(Lock);
+    }
+    Update();
+}
+
+static void
+Flush()
+{
+    for (;;)
+    {
+        Update();
+        if (Priv::GPendingCount == 0)
+            break;
+
+        if (!Priv::GDecoding.empty())
+        {
+            Jobs::Wait(&Priv::GDecoding[0]->Counter);
+        }
+        else
+        {
+            std::unique_lock<std::mutex> Lock(Priv::GMutex);
+            while (Priv::GRead.empty())
+                Priv::GReadWake.wait(Lock);
+        }
+    }
+}
+
+static unsigned
+GetPendingCount()
+{
+    return Priv::GPendingCount;
+}
+
+static TStats
+GetStats()
+{
+    std::lock_guard<std::mutex> Lock(Priv::GMutex);
+    return Priv::GStats;
+}
+
+} // namespace Load
+// vim: set ts=4 sw=4 expandtab:
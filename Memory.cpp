@@ -0,0 +1,254 @@
+namespace Mem
+{
+namespace Priv
+{
+
+static inline uint64_t
+AlignUp(uint64_t Value, uint64_t Alignment)
+{
+    return (Value + Alignment - 1) / Alignment * Alignment;
+}
+
+// Smallest size class (power of two) that holds Count.
+static inline unsigned
+GetSizeClass(unsigned Count)
+{
+    unsigned SizeClass = 0;
+    while ((1u << SizeClass) < Count)
+        SizeClass++;
+    return SizeClass;
+}
+
+// Splits [Index, Index + Count) into power-of-two blocks and puts them on the free lists.
+static void
+PushFreeRange(TPagedAllocator& Allocator, uint32_t Index, unsigned Count)
+{
+    Allocator.Stats.FreeCount += Count;
+    for (unsigned SizeClass = 0; Count > 0; ++SizeClass)
+    {
+        if (Count & (1u << SizeClass))
+        {
+            Allocator.FreeLists[SizeClass].push_back(Index);
+            Index += 1u << SizeClass;
+            Count &= ~(1u << SizeClass);
+        }
+    }
+}
+
+} // namespace Priv
+
+static void
+InitializeRing(TRingAllocator& Ring, uint64_t Capacity, const TRingFence& Fence)
+{
+    memset(&Ring, 0, sizeof(Ring));
+    Ring.Capacity = Capacity;
+    Ring.Fence = Fence;
+}
+
+// Pops every frame the GPU has finished with. With Wait set and nothing to pop, blocks on the
+// oldest frame still in flight. Returns false when there was nothing left to retire.
+static bool
+RetireRing(TRingAllocator& Ring, bool Wait)
+{
+    if (Ring.FrameCount == 0)
+        return false;
+
+    uint64_t Completed = Ring.Fence.GetCompletedValue(Ring.Fence.Context);
+    if (Wait && Completed < Ring.Frames[Ring.FrameFirst].FenceValue)
+    {
+        Ring.Fence.WaitForValue(Ring.Fence.Context, Ring.Frames[Ring.FrameFirst].FenceValue);
+        Completed = Ring.Fence.GetCompletedValue(Ring.Fence.Context);
+        Ring.Stats.WaitCount++;
+    }
+
+    bool Retired = false;
+    while (Ring.FrameCount > 0 && Ring.Frames[Ring.FrameFirst].FenceValue <= Completed)
+    {
+        Ring.Tail = Ring.Frames[Ring.FrameFirst].End;
+        Ring.FrameFirst = (Ring.FrameFirst + 1) % KMaxRingFrames;
+        Ring.FrameCount--;
+        Retired = true;
+    }
+    return Retired;
+}
+
+// Head and Tail grow monotonically; the physical offset is Head % Capacity. An allocation never
+// straddles the end of the buffer, the remainder is skipped instead.
+static bool
+AllocateRing(TRingAllocator& Ring, uint64_t Size, uint64_t Alignment, uint64_t& OutOffset)
+{
+    assert(Size > 0 && Alignment > 0 && (Ring.Capacity % Alignment) == 0);
+
+    if (Size > Ring.Capacity)
+    {
+        Ring.Stats.FailedCount++;
+        return false;
+    }
+
+    for (;;)
+    {
+        uint64_t Offset = Priv::AlignUp(Ring.Head, Alignment);
+        const bool Wraps = (Offset % Ring.Capacity) + Size > Ring.Capacity;
+        if (Wraps)
+            Offset = Priv::AlignUp(Offset, Ring.Capacity);
+
+        if (Offset + Size - Ring.Tail <= Ring.Capacity)
+        {
+            if (Wraps)
+                Ring.Stats.WrapCount++;
+
+            Ring.Stats.FrameBytes += Offset + Size - Ring.Head;
+            Ring.Head = Offset + Size;
+            Ring.Stats.HighWaterMark = std::max(Ring.Stats.HighWaterMark, Ring.Head - Ring.Tail);
+            OutOffset = Offset % Ring.Capacity;
+            return true;
+        }
+
+        // Not enough retired space: the current frame alone does not fit when nothing is in flight.
+        if (!RetireRing(Ring, false) && !RetireRing(Ring, true))
+        {
+            Ring.Stats.FailedCount++;
+            return false;
+        }
+    }
+}
+
+// Marks the end of the allocations made for the work that signals FenceValue.
+static void
+EndRingFrame(TRingAllocator& Ring, uint64_t FenceValue)
+{
+    if (Ring.FrameCount == KMaxRingFrames)
+        RetireRing(Ring, true);
+
+    const unsigned Index = (Ring.FrameFirst + Ring.FrameCount) % KMaxRingFrames;
+    Ring.Frames[Index].FenceValue = FenceValue;
+    Ring.Frames[Index].End = Ring.Head;
+    Ring.FrameCount++;
+
+    Ring.Stats.LastFrameBytes = Ring.Stats.FrameBytes;
+    Ring.Stats.PeakFrameBytes = std::max(Ring.Stats.PeakFrameBytes, Ring.Stats.FrameBytes);
+    Ring.Stats.FrameBytes = 0;
+
+    RetireRing(Ring, false);
+}
+
+static void
+InitializePaged(TPagedAllocator& Allocator, unsigned PageSize, unsigned MaxPageCount)
+{
+    assert(PageSize > 0 && (PageSize & (PageSize - 1)) == 0 && PageSize < (1u << KMaxSizeClasses));
+
+    Allocator.PageSize = PageSize;
+    Allocator.MaxPageCount = MaxPageCount;
+    Allocator.Cursor = 0;
+    for (unsigned SizeClass = 0; SizeClass < KMaxSizeClasses; ++SizeClass)
+        Allocator.FreeLists[SizeClass].clear();
+    Allocator.Pending.clear();
+    Allocator.PendingFirst = 0;
+    memset(&Allocator.Stats, 0, sizeof(Allocator.Stats));
+}
+
+// Exact size class first, then a split of the smallest larger free block, then fresh space in the
+// last page, then a new page. Free blocks are never coalesced.
+static bool
+AllocatePaged(TPagedAllocator& Allocator, unsigned Count, uint32_t& OutIndex)
+{
+    assert(Count > 0);
+    TPagedStats& Stats = Allocator.Stats;
+
+    const unsigned SizeClass = Priv::GetSizeClass(Count);
+    const unsigned BlockSize = 1u << SizeClass;
+    if (BlockSize > Allocator.PageSize)
+    {
+        Stats.FailedCount++;
+        return false;
+    }
+
+    bool Found = false;
+    for (unsigned Class = SizeClass; Class < KMaxSizeClasses && !Found; ++Class)
+    {
+        std::vector<uint32_t>& FreeList = Allocator.FreeLists[Class];
+        if (FreeList.empty())
+            continue;
+
+        OutIndex = FreeList.back();
+        FreeList.pop_back();
+        Stats.FreeCount -= 1u << Class;
+
+        // The tail of a larger block goes back as one block of each size between the two classes.
+        if (Class > SizeClass)
+            Priv::PushFreeRange(Allocator, OutIndex + BlockSize, (1u << Class) - BlockSize);
+        Found = true;
+    }
+
+    if (!Found)
+    {
+        const uint32_t PageEnd = Stats.PageCount * Allocator.PageSize;
+        if (Allocator.Cursor + BlockSize > PageEnd)
+        {
+            if (Allocator.MaxPageCount != 0 && Stats.PageCount == Allocator.MaxPageCount)
+            {
+                Stats.FailedCount++;
+                return false;
+            }
+            Priv::PushFreeRange(Allocator, Allocator.Cursor, PageEnd - Allocator.Cursor);
+            Allocator.Cursor = PageEnd;
+            Stats.PageCount++;
+        }
+        OutIndex = Allocator.Cursor;
+        Allocator.Cursor += BlockSize;
+    }
+
+    Stats.LiveCount += Count;
+    Stats.ReservedCount += BlockSize;
+    Stats.AllocationCount++;
+    return true;
+}
+
+static void
+FreePaged(TPagedAllocator& Allocator, uint32_t Index, unsigned Count)
+{
+    const unsigned SizeClass = Priv::GetSizeClass(Count);
+    Allocator.FreeLists[SizeClass].push_back(Index);
+
+    TPagedStats& Stats = Allocator.Stats;
+    Stats.LiveCount -= Count;
+    Stats.ReservedCount -= 1u << SizeClass;
+    Stats.FreeCount += 1u << SizeClass;
+}
+
+// The block stays reserved until RetirePaged sees FenceValue completed. Fence values must not
+// decrease between calls.
+static void
+DeferFreePaged(TPagedAllocator& Allocator, uint32_t Index, unsigned Count, uint64_t FenceValue)
+{
+    assert(Allocator.Pending.size() == Allocator.PendingFirst || Allocator.Pending.back().FenceValue <= FenceValue);
+
+    Allocator.Pending.push_back({ FenceValue, Index, Count });
+    Allocator.Stats.PendingCount += Count;
+}
+
+static void
+RetirePaged(TPagedAllocator& Allocator, uint64_t CompletedValue)
+{
+    std::vector<TPagedAllocator::TPendingFree>& Pending = Allocator.Pending;
+    while (Allocator.PendingFirst < Pending.size() && Pending[Allocator.PendingFirst].FenceValue <= CompletedValue)
+    {
+        const TPagedAllocator::TPendingFree& Free = Pending[Allocator.PendingFirst++];
+        FreePaged(Allocator, Free.Index, Free.Count);
+        Allocator.Stats.PendingCount -= Free.Count;
+    }
+
+    if (Allocator.PendingFirst == Pending.size())
+    {
+        Pending.clear();
+        Allocator.PendingFirst = 0;
+    }
+    else if (Allocator.PendingFirst > 64 && Allocator.PendingFirst * 2 > Pending.size())
+    {
+        Pending.erase(Pending.begin(), Pending.begin() + Allocator.PendingFirst);
+        Allocator.PendingFirst = 0;
+    }
+}
+
+} // namespace Mem
+// vim: set ts=4 sw=4 expandtab:
@@ -0,0 +1,117 @@
+#include "Demo.cpp"
+
+// demo_pack [--compress] <directory> <archive>
+// Packs every file under the directory. Entries are named by their path as given on the command line,
+// so "demo_pack Data Data.pak" (run from the repository root) stores "Data/Shaders/Gui.vs.cso", which is
+// the name the demo asks for. They are stored as is unless --compress is given: the demo reads stored
+// entries straight from the mapping, which loads faster than decompressing them.
+
+namespace PackTool
+{
+
+static void
+ListFiles(const std::string& Directory, std::vector<std::string>& OutFiles)
+{
+#if defined(_WIN32)
+    WIN32_FIND_DATAA Found;
+    HANDLE Find = FindFirstFileA((Directory + "/*").c_str(), &Found);
+    if (Find == INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        const std::string Name = Found.cFileName;
+        if (Name == "." || Name == "..")
+            continue;
+        if (Found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            ListFiles(Directory + "/" + Name, OutFiles);
+        else
+            OutFiles.push_back(Directory + "/" + Name);
+    } while (FindNextFileA(Find, &Found));
+    FindClose(Find);
+#else
+    DIR* Dir = opendir(Directory.c_str());
+    if (!Dir)
+        return;
+    while (const dirent* Entry = readdir(Dir))
+    {
+        const std::string Name = Entry->d_name;
+        if (Name == "." || Name == "..")
+            continue;
+
+        const std::string Path = Directory + "/" + Name;
+        struct stat Stat;
+        if (stat(Path.c_str(), &Stat) != 0)
+            continue;
+        if (S_ISDIR(Stat.st_mode))
+            ListFiles(Path, OutFiles);
+        else if (S_ISREG(Stat.st_mode))
+            OutFiles.push_back(Path);
+    }
+    closedir(Dir);
+#endif
+}
+
+} // namespace PackTool
+
+int
+main(int Argc, char** Argv)
+{
+    bool Compress = false;
+    const char* Arguments[2] = {};
+    unsigned ArgumentCount = 0;
+    for (int Index = 1; Index < Argc; ++Index)
+    {
+        if (strcmp(Argv[Index], "--compress") == 0)
+            Compress = true;
+        else if (ArgumentCount < 2)
+            Arguments[ArgumentCount++] = Argv[Index];
+    }
+    if (ArgumentCount != 2)
+    {
+        fprintf(stderr, "usage: demo_pack [--compress] <directory> <archive>\n");
+        return 2;
+    }
+
+    std::string Directory = Arguments[0];
+    while (Directory.size() > 1 && (Directory.back() == '/' || Directory.back() == '\\'))
+        Directory.pop_back();
+
+    std::vector<std::string> Files;
+    PackTool::ListFiles(Directory, Files);
+    std::sort(Files.begin(), Files.end());
+
+    std::vector<const char*> Names;
+    for (const std::string& File : Files)
+    {
+        // The archive itself may live in the packed directory.
+        if (File != Arguments[1])
+            Names.push_back(File.c_str());
+    }
+
+    if (!Pak::Build(Arguments[1], Names.data(), (unsigned)Names.size(), Compress))
+    {
+        fprintf(stderr, "demo_pack: can't build %s\n", Arguments[1]);
+        return 1;
+    }
+
+    Pak::TArchive Archive;
+    if (!Pak::Open(Arguments[1], Archive))
+    {
+        fprintf(stderr, "demo_pack: %s doesn't open\n", Arguments[1]);
+        return 1;
+    }
+    uint64_t OriginalSize = 0, StoredSize = 0;
+    unsigned CompressedCount = 0;
+    for (unsigned Index = 0; Index < Archive.EntryCount; ++Index)
+    {
+        OriginalSize += Archive.Entries[Index].OriginalSize;
+        StoredSize += Archive.Entries[Index].Size;
+        CompressedCount += (Archive.Entries[Index].Flags & Pak::KEntryLz4) != 0;
+    }
+    printf("%s: %u files (%u compressed), %llu -> %llu bytes, archive %llu bytes\n", Arguments[1], Archive.EntryCount,
+           CompressedCount, (unsigned long long)OriginalSize, (unsigned long long)StoredSize,
+           (unsigned long long)Archive.File.Size);
+    Pak::Close(Archive);
+    return 0;
+}
+// vim: set ts=4 sw=4 expandtab:
@@ -0,0 +1,118 @@
+namespace Plat
+{
+namespace Priv
+{
+
+static THeadlessWindow GWindow;
+static THeadlessScript GScript;
+static unsigned GScriptCursor;
+static unsigned GFrame;
+static double GTime;
+
+static void
+ApplyScriptEvent(const TScriptEvent& Event)
+{
+    ImGuiIO& Io = ImGui::GetIO();
+
+    switch (Event.Type)
+    {
+    case KScriptMouseMove:
+        Io.MousePos = ImVec2(Event.X, Event.Y);
+        break;
+    case KScriptMouseDown:
+        Io.MouseDown[Event.Value] = true;
+        break;
+    case KScriptMouseUp:
+        Io.MouseDown[Event.Value] = false;
+        break;
+    case KScriptMouseWheel:
+        Io.MouseWheel += Event.Value > 0 ? 1.0f : -1.0f;
+        break;
+    case KScriptKeyDown:
+        Io.KeysDown[Event.Value] = true;
+        break;
+    case KScriptKeyUp:
+        Io.KeysDown[Event.Value] = false;
+        break;
+    case KScriptChar:
+        Io.AddInputCharacter((unsigned short)Event.Value);
+        break;
+    case KScriptQuit:
+        break;
+    }
+}
+
+} // namespace Priv
+
+static void
+SetHeadlessScript(const THeadlessScript& Script)
+{
+    Priv::GScript = Script;
+    if (Priv::GScript.TimeStep <= 0.0)
+        Priv::GScript.TimeStep = 1.0 / 60.0;
+
+    // GTime keeps running across scripts: Lib::UpdateFrameStats() expects a monotonic clock.
+    Priv::GScriptCursor = 0;
+    Priv::GFrame = 0;
+}
+
+static THeadlessWindow*
+Initialize(const char* Name, unsigned Width, unsigned Height)
+{
+    if (Priv::GScript.TimeStep <= 0.0)
+        Priv::GScript.TimeStep = 1.0 / 60.0;
+
+    Priv::GWindow.Width = Width;
+    Priv::GWindow.Height = Height;
+
+    // Scripted key events use ImGuiKey_ values directly. Window settings are not persisted so that
+    // every headless run starts from the same state.
+    ImGuiIO& Io = ImGui::GetIO();
+    Io.IniFilename = nullptr;
+    for (int Key = 0; Key < ImGuiKey_COUNT; ++Key)
+        Io.KeyMap[Key] = Key;
+
+    return &Priv::GWindow;
+}
+
+static void
+Shutdown()
+{
+}
+
+static bool
+ProcessEvents()
+{
+    if (Priv::GScript.FrameCount != 0 && Priv::GFrame >= Priv::GScript.FrameCount)
+        return false;
+
+    while (Priv::GScriptCursor < Priv::GScript.EventCount)
+    {
+        const TScriptEvent& Event = Priv::GScript.Events[Priv::GScriptCursor];
+        if (Event.Frame > Priv::GFrame)
+            break;
+        if (Event.Type == KScriptQuit)
+            return false;
+
+        Priv::ApplyScriptEvent(Event);
+        Priv::GScriptCursor++;
+    }
+
+    Priv::GTime += Priv::GScript.TimeStep;
+    Priv::GFrame++;
+    return true;
+}
+
+static double
+GetFrameTime()
+{
+    return Priv::GTime;
+}
+
+static void
+SetWindowTitle(THeadlessWindow*, const char*)
+{
+}
+
+} // namespace Plat
+// vim: set ts=4 sw=4 expandtab:
@@ -0,0 +1,159 @@
+namespace Plat
+{
+namespace Priv
+{
+
+static LRESULT CALLBACK
+ProcessWindowMessage(HWND Window, UINT Message, WPARAM WParam, LPARAM LParam)
+{
+    ImGuiIO& Io = ImGui::GetIO();
+
+    switch (Message)
+    {
+    case WM_LBUTTONDOWN:
+        Io.MouseDown[0] = true;
+        return 0;
+    case WM_LBUTTONUP:
+        Io.MouseDown[0] = false;
+        return 0;
+    case WM_RBUTTONDOWN:
+        Io.MouseDown[1] = true;
+        return 0;
+    case WM_RBUTTONUP:
+        Io.MouseDown[1] = false;
+        return 0;
+    case WM_MBUTTONDOWN:
+        Io.MouseDown[2] = true;
+        return 0;
+    case WM_MBUTTONUP:
+        Io.MouseDown[2] = false;
+        return 0;
+    case WM_MOUSEWHEEL:
+        Io.MouseWheel += GET_WHEEL_DELTA_WPARAM(WParam) > 0 ? 1.0f : -1.0f;
+        return 0;
+    case WM_MOUSEMOVE:
+        Io.MousePos.x = (signed short)(LParam);
+        Io.MousePos.y = (signed short)(LParam >> 16);
+        return 0;
+    case WM_DESTROY:
+        PostQuitMessage(0);
+        return 0;
+    case WM_KEYDOWN:
+        {
+            if (WParam < 256)
+            {
+                Io.KeysDown[WParam] = true;
+                if (WParam == VK_ESCAPE)
+                    PostQuitMessage(0);
+                return 0;
+            }
+        }
+        break;
+    case WM_KEYUP:
+        {
+            if (WParam < 256)
+            {
+                Io.KeysDown[WParam] = false;
+                return 0;
+            }
+        }
+        break;
+    case WM_CHAR:
+        {
+            if (WParam > 0 && WParam < 0x10000)
+            {
+                Io.AddInputCharacter((unsigned short)WParam);
+                return 0;
+            }
+        }
+        break;
+    }
+    return DefWindowProc(Window, Message, WParam, LParam);
+}
+
+} // namespace Priv
+
+static HWND
+Initialize(const char* Name, unsigned Width, unsigned Height)
+{
+    WNDCLASS WinClass = {};
+    WinClass.lpfnWndProc = Priv::ProcessWindowMessage;
+    WinClass.hInstance = GetModuleHandle(nullptr);
+    WinClass.hCursor = LoadCursor(nullptr, IDC_ARROW);
+    WinClass.lpszClassName = Name;
+    if (!RegisterClass(&WinClass))
+        assert(0);
+
+    RECT Rect = { 0, 0, (LONG)Width, (LONG)Height };
+    if (!AdjustWindowRect(&Rect, WS_OVERLAPPED | WS_SYSMENU | WS_CAPTION | WS_MINIMIZEBOX, 0))
+        assert(0);
+
+    HWND Window = CreateWindowEx(
+        0, Name, Name, WS_OVERLAPPED | WS_SYSMENU | WS_CAPTION | WS_MINIMIZEBOX | WS_VISIBLE,
+        CW_USEDEFAULT, CW_USEDEFAULT,
+        Rect.right - Rect.left, Rect.bottom - Rect.top,
+        nullptr, nullptr, nullptr, 0);
+    assert(Window);
+
+    ImGuiIO& Io = ImGui::GetIO();
+    Io.KeyMap[ImGuiKey_Tab] = VK_TAB;
+    Io.KeyMap[ImGuiKey_LeftArrow] = VK_LEFT;
+    Io.KeyMap[ImGuiKey_RightArrow] = VK_RIGHT;
+    Io.KeyMap[ImGuiKey_UpArrow] = VK_UP;
+    Io.KeyMap[ImGuiKey_DownArrow] = VK_DOWN;
+    Io.KeyMap[ImGuiKey_PageUp] = VK_PRIOR;
+    Io.KeyMap[ImGuiKey_PageDown] = VK_NEXT;
+    Io.KeyMap[ImGuiKey_Home] = VK_HOME;
+    Io.KeyMap[ImGuiKey_End] = VK_END;
+    Io.KeyMap[ImGuiKey_Delete] = VK_DELETE;
+    Io.KeyMap[ImGuiKey_Backspace] = VK_BACK;
+    Io.KeyMap[ImGuiKey_Enter] = VK_RETURN;
+    Io.KeyMap[ImGuiKey_Escape] = VK_ESCAPE;
+    Io.KeyMap[ImGuiKey_A] = 'A';
+    Io.KeyMap[ImGuiKey_C] = 'C';
+    Io.KeyMap[ImGuiKey_V] = 'V';
+    Io.KeyMap[ImGuiKey_X] = 'X';
+    Io.KeyMap[ImGuiKey_Y] = 'Y';
+    Io.KeyMap[ImGuiKey_Z] = 'Z';
+    Io.ImeWindowHandle = Window;
+
+    return Window;
+}
+
+static void
+Shutdown()
+{
+}
+
+static bool
+ProcessEvents()
+{
+    MSG Message = {};
+    while (PeekMessage(&Message, 0, 0, 0, PM_REMOVE))
+    {
+        DispatchMessage(&Message);
+        if (Message.message == WM_QUIT)
+            return false;
+    }
+
+    ImGuiIO& Io = ImGui::GetIO();
+    Io.KeyCtrl = (GetKeyState(VK_CONTROL) & 0x8000) != 0;
+    Io.KeyShift = (GetKeyState(VK_SHIFT) & 0x8000) != 0;
+    Io.KeyAlt = (GetKeyState(VK_MENU) & 0x8000) != 0;
+    return true;
+}
+
+static double
+GetFrameTime()
+{
+    return Lib::GetTime();
+}
+
+static void
+SetWindowTitle(HWND Window, const char* Title)
+{
+    SetWindowText(Window, Title);
+}
+
+} // namespace Plat
+// vim: set ts=4 sw=4 expandtab:
@@ -0,0 +1,342 @@
+namespace Prof
+{
+namespace Priv
+{
+
+struct TEvent
+{
+    uint64_t Time;
+    uint32_t ZoneId;
+    uint32_t IsEnd;
+};
+
+static const unsigned KThreadEventCount = 16384; // power of two
+
+// Single producer (the owning thread), single consumer (EndFrame on the main thread).
+struct TThreadBuffer
+{
+    std::atomic<uint64_t> Head;
+    std::atomic<uint64_t> Tail;
+    std::atomic<uint64_t> DroppedCount;
+    TEvent Events[KThreadEventCount];
+
+    // consumer state
+    std::vector<TEvent> OpenZones;
+};
+
+// Zone as shown in the flame view.
+struct TZoneRecord
+{
+    uint64_t Start;
+    uint64_t End;
+    uint32_t ZoneId;
+    uint16_t Depth;
+    uint16_t Thread;
+};
+
+struct TZoneHistory
+{
+    float Times[KHistoryFrameCount]; // seconds
+    unsigned Count;
+    unsigned Next;
+};
+
+static const char* GZoneNames[KMaxZones];
+static std::atomic<unsigned> GZoneCount;
+
+static std::atomic<TThreadBuffer*> GThreadBuffers[KMaxThreads];
+static std::atomic<unsigned> GThreadCount;
+static thread_local TThreadBuffer* GThreadBuffer;
+
+// Consumer side, main thread only.
+static std::vector<TZoneRecord> GRecords;      // zones that ended during the current frame
+static std::vector<TZoneRecord> GFrameRecords; // zones of the last complete frame
+static uint64_t GFrameStart;
+static uint64_t GFrameEnd;
+static uint64_t GFrameTimes[KMaxZones];
+static TZoneHistory GHistory[KMaxZones];
+
+#if defined(_WIN32)
+static double GTicksToNanoseconds;
+#endif
+
+static TThreadBuffer*
+GetThreadBuffer()
+{
+    if (GThreadBuffer)
+        return GThreadBuffer;
+
+    const unsigned Index = GThreadCount.fetch_add(1);
+    if (Index >= KMaxThreads)
+        return nullptr;
+
+    TThreadBuffer* Buffer = new TThreadBuffer();
+    GThreadBuffers[Index].store(Buffer, std::memory_order_release);
+    GThreadBuffer = Buffer;
+    return Buffer;
+}
+
+static inline void
+Record(unsigned ZoneId, uint32_t IsEnd)
+{
+    TThreadBuffer* Buffer = GThreadBuffer ? GThreadBuffer : GetThreadBuffer();
+    if (!Buffer)
+        return;
+
+    const uint64_t Head = Buffer->Head.load(std::memory_order_relaxed);
+    if (Head - Buffer->Tail.load(std::memory_order_acquire) >= KThreadEventCount)
+    {
+        Buffer->DroppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    TEvent& Event = Buffer->Events[Head & (KThreadEventCount - 1)];
+    Event.Time = GetTimestamp();
+    Event.ZoneId = ZoneId;
+    Event.IsEnd = IsEnd;
+    Buffer->Head.store(Head + 1, std::memory_order_release);
+}
+
+// Matches begin/end pairs of one thread; zones still open at the end of the frame carry over.
+static void
+ConsumeThreadBuffer(TThreadBuffer& Buffer, unsigned Thread)
+{
+    const uint64_t Head = Buffer.Head.load(std::memory_order_acquire);
+    uint64_t Tail = Buffer.Tail.load(std::memory_order_relaxed);
+
+    for (; Tail < Head; ++Tail)
+    {
+        const TEvent& Event = Buffer.Events[Tail & (KThreadEventCount - 1)];
+        if (!Event.IsEnd)
+        {
+            Buffer.OpenZones.push_back(Event);
+            continue;
+        }
+
+        // An end without its begin (dropped on overflow) is ignored.
+        while (!Buffer.OpenZones.empty() && Buffer.OpenZones.back().ZoneId != Event.ZoneId)
+            Buffer.OpenZones.pop_back();
+        if (Buffer.OpenZones.empty())
+            continue;
+
+        const TEvent Begin = Buffer.OpenZones.back();
+        Buffer.OpenZones.pop_back();
+
+        TZoneRecord Record;
+        Record.Start = Begin.Time;
+        Record.End = Event.Time;
+        Record.ZoneId = Event.ZoneId;
+        Record.Depth = (uint16_t)Buffer.OpenZones.size();
+        Record.Thread = (uint16_t)Thread;
+        GRecords.push_back(Record);
+        GFrameTimes[Event.ZoneId] += Event.Time - Begin.Time;
+    }
+    Buffer.Tail.store(Tail, std::memory_order_release);
+}
+
+static ImU32
+GetZoneColor(unsigned ZoneId)
+{
+    const uint32_t Hash = (ZoneId + 1) * 2654435761u;
+    return IM_COL32(96 + (Hash & 0x7f), 96 + ((Hash >> 8) & 0x7f), 96 + ((Hash >> 16) & 0x7f), 255);
+}
+
+} // namespace Priv
+
+static uint64_t
+GetTimestamp()
+{
+#if defined(_WIN32)
+    if (Priv::GTicksToNanoseconds == 0.0)
+    {
+        LARGE_INTEGER Frequency;
+        QueryPerformanceFrequency(&Frequency);
+        Priv::GTicksToNanoseconds = 1e9 / Frequency.QuadPart;
+    }
+    LARGE_INTEGER Counter;
+    QueryPerformanceCounter(&Counter);
+    return (uint64_t)(Counter.QuadPart * Priv::GTicksToNanoseconds);
+#else
+    timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (uint64_t)Time.tv_sec * 1000000000ull + (uint64_t)Time.tv_nsec;
+#endif
+}
+
+// Called once per call site (PROF_ZONE keeps the id in a function-local static).
+static unsigned
+RegisterZone(const char* Name)
+{
+    const unsigned ZoneId = Priv::GZoneCount.fetch_add(1);
+    assert(ZoneId < KMaxZones);
+    Priv::GZoneNames[ZoneId] = Name;
+    return ZoneId;
+}
+
+static void
+BeginZone(unsigned ZoneId)
+{
+    Priv::Record(ZoneId, 0);
+}
+
+static void
+EndZone(unsigned ZoneId)
+{
+    Priv::Record(ZoneId, 1);
+}
+
+// Collects the events of all threads and closes the frame. Main thread, once per frame.
+static void
+EndFrame()
+{
+    const uint64_t Now = GetTimestamp();
+
+    const unsigned ThreadCount = std::min(Priv::GThreadCount.load(std::memory_order_acquire), KMaxThreads);
+    for (unsigned Thread = 0; Thread < ThreadCount; ++Thread)
+    {
+        if (Priv::TThreadBuffer* Buffer = Priv::GThreadBuffers[Thread].load(std::memory_order_acquire))
+            Priv::ConsumeThreadBuffer(*Buffer, Thread);
+    }
+
+    const unsigned ZoneCount = std::min(Priv::GZoneCount.load(), KMaxZones);
+    for (unsigned ZoneId = 0; ZoneId < ZoneCount; ++ZoneId)
+    {
+        if (Priv::GFrameTimes[ZoneId] == 0)
+            continue;
+
+        Priv::TZoneHistory& History = Priv::GHistory[ZoneId];
+        History.Times[History.Next] = (float)(Priv::GFrameTimes[ZoneId] * 1e-9);
+        History.Next = (History.Next + 1) % KHistoryFrameCount;
+        History.Count = std::min(History.Count + 1, KHistoryFrameCount);
+        Priv::GFrameTimes[ZoneId] = 0;
+    }
+
+    Priv::GFrameRecords.swap(Priv::GRecords);
+    Priv::GRecords.clear();
+    Priv::GFrameStart = Priv::GFrameEnd;
+    Priv::GFrameEnd = Now;
+}
+
+static unsigned
+GetZoneCount()
+{
+    return std::min(Priv::GZoneCount.load(), KMaxZones);
+}
+
+static bool
+GetZoneStats(unsigned ZoneId, TZoneStats& OutStats)
+{
+    if (ZoneId >= GetZoneCount() || Priv::GHistory[ZoneId].Count == 0)
+        return false;
+
+    const Priv::TZoneHistory& History = Priv::GHistory[ZoneId];
+    float Sorted[KHistoryFrameCount];
+    memcpy(Sorted, History.Times, History.Count * sizeof(float));
+    std::sort(Sorted, Sorted + History.Count);
+
+    double Sum = 0.0;
+    for (unsigned Index = 0; Index < History.Count; ++Index)
+        Sum += Sorted[Index];
+
+    OutStats.Name = Priv::GZoneNames[ZoneId];
+    OutStats.FrameCount = History.Count;
+    OutStats.Last = History.Times[(History.Next + KHistoryFrameCount - 1) % KHistoryFrameCount];
+    OutStats.Min = Sorted[0];
+    OutStats.Avg = Sum / History.Count;
+    OutStats.P99 = Sorted[(History.Count * 99) / 100];
+    return true;
+}
+
+// Flame graph of the last frame (one band per thread, one row per nesting level) and the zone table.
+static void
+ShowWindow()
+{
+    ImGui::SetNextWindowSize(ImVec2(720.0f, 420.0f), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Profiler"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    const std::vector<Priv::TZoneRecord>& Records = Priv::GFrameRecords;
+    const double FrameLength = (double)(Priv::GFrameEnd - Priv::GFrameStart);
+
+    unsigned RowCount = 0;
+    unsigned ThreadRows[KMaxThreads] = {};
+    for (const Priv::TZoneRecord& Record : Records)
+        ThreadRows[Record.Thread] = std::max(ThreadRows[Record.Thread], (unsigned)Record.Depth + 1);
+    unsigned ThreadFirstRow[KMaxThreads];
+    for (unsigned Thread = 0; Thread < KMaxThreads; ++Thread)
+    {
+        ThreadFirstRow[Thread] = RowCount;
+        RowCount += ThreadRows[Thread];
+    }
+
+    ImGui::Text("Frame %.3f ms, %u zones", FrameLength * 1e-6, (unsigned)Records.size());
+
+    const float RowHeight = ImGui::GetTextLineHeight() + 4.0f;
+    const ImVec2 Origin = ImGui::GetCursorScreenPos();
+    const float Width = std::max(ImGui::GetContentRegionAvailWidth(), 64.0f);
+    ImGui::InvisibleButton("Flame", ImVec2(Width, std::max(RowCount, 1u) * RowHeight));
+
+    if (FrameLength > 0.0)
+    {
+        ImDrawList* DrawList = ImGui::GetWindowDrawList();
+        const float Scale = (float)(Width / FrameLength);
+        const ImVec2 Mouse = ImGui::GetIO().MousePos;
+
+        for (const Priv::TZoneRecord& Record : Records)
+        {
+            // Zones begun in the previous frame are clamped to its end.
+            const double Start = Record.Start > Priv::GFrameStart ? (double)(Record.Start - Priv::GFrameStart) : 0.0;
+            const double End = Record.End > Priv::GFrameStart ? (double)(Record.End - Priv::GFrameStart) : 0.0;
+            const ImVec2 Min(Origin.x + (float)(Start * Scale),
+                             Origin.y + (ThreadFirstRow[Record.Thread] + Record.Depth) * RowHeight);
+            const ImVec2 Max(std::max(Origin.x + (float)(End * Scale), Min.x + 1.0f), Min.y + RowHeight - 1.0f);
+
+            DrawList->AddRectFilled(Min, Max, Priv::GetZoneColor(Record.ZoneId));
+
+            const char* Name = Priv::GZoneNames[Record.ZoneId];
+            if (Max.x - Min.x > ImGui::CalcTextSize(Name).x + 4.0f)
+                DrawList->AddText(ImVec2(Min.x + 2.0f, Min.y + 2.0f), IM_COL32_BLACK, Name);
+
+            if (Mouse.x >= Min.x && Mouse.x < Max.x && Mouse.y >= Min.y && Mouse.y < Max.y)
+                ImGui::SetTooltip("%s: %.3f ms", Name, (Record.End - Record.Start) * 1e-6);
+        }
+    }
+
+    ImGui::Separator();
+    ImGui::Columns(5, "ProfilerZones");
+    ImGui::Text("Zone");
+    ImGui::NextColumn();
+    ImGui::Text("Last ms");
+    ImGui::NextColumn();
+    ImGui::Text("Min ms");
+    ImGui::NextColumn();
+    ImGui::Text("Avg ms");
+    ImGui::NextColumn();
+    ImGui::Text("P99 ms");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for (unsigned ZoneId = 0; ZoneId < GetZoneCount(); ++ZoneId)
+    {
+        TZoneStats Stats;
+        if (!GetZoneStats(ZoneId, Stats))
+            continue;
+        ImGui::Text("%s", Stats.Name);
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", Stats.Last * 1000.0);
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", Stats.Min * 1000.0);
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", Stats.Avg * 1000.0);
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", Stats.P99 * 1000.0);
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    ImGui::End();
+}
+
+} // namespace Prof
+// vim: set ts=4 sw=4 expandtab:
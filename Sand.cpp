@@ -0,0 +1,1292 @@
+namespace Sand
+{
+namespace Priv
+{
+
+static const uint64_t KBytes01 = 0x0101010101010101ull;
+static const uint8_t KSolidBit = 0x02; // set in sand and stone, clear in empty cells and water
+
+// Material colours (RGBA8 as stored in memory); the shade bits scale them by 0.84 - 1.14.
+static const uint32_t KMaterialColors[KMaterialCount] =
+{
+    0xff201a18, // KEmpty
+    0xffd06e2a, // KWater
+    0xff7ac4e6, // KSand
+    0xff64686c, // KStone
+};
+
+// A destination is open to a moving cell when none of these bits are set in it: sand sinks into empty
+// cells and water, water only flows into empty cells. Cells that already moved in the step are never
+// displaced.
+static const uint8_t KSandBlockers = KMovedBit | (KMaterialMask & ~KWater);
+static const uint8_t KWaterBlockers = KMovedBit | KMaterialMask;
+
+// DisplayCanvas pass, the texture of the cells it shows and the palette that colours them.
+static ID3D12RootSignature* GRootSignature;
+static ID3D12PipelineState* GPipelineState;
+static ID3D12Resource* GTexture;
+static ID3D12Resource* GPaletteTexture;
+static D3D12_CPU_DESCRIPTOR_HANDLE GTextureDescriptors; // the cells, then the palette
+static uint32_t GTextureIndex;
+static uint32_t GPaletteTextureIndex;
+static unsigned GTextureSize[2];
+static bool GAssetsRequested;
+static Load::TAsset GCsoVs;
+static Load::TAsset GCsoPs;
+static TUploadStats GUploadStats;
+
+static inline uint64_t
+Load8(const uint8_t* Address)
+{
+    uint64_t Value;
+    memcpy(&Value, Address, sizeof(Value));
+    return Value;
+}
+
+static inline void
+Store8(uint8_t* Address, uint64_t Value)
+{
+    memcpy(Address, &Value, sizeof(Value));
+}
+
+// Nonzero when a byte of Value is zero; the bytes must not have their top bit set.
+static inline uint64_t
+HasZeroByte(uint64_t Value)
+{
+    return (Value - KBytes01) & ~Value & (KBytes01 * 0x80);
+}
+
+// Per-cell random numbers depend only on the position and the step, never on the update order.
+static inline uint32_t
+Hash(uint32_t X, uint32_t Y, uint32_t Seed)
+{
+    uint32_t Value = (X * 0x8da6b343u) ^ (Y * 0xd8163841u) ^ (Seed * 0xcb1ab31fu);
+    Value ^= Value >> 15;
+    Value *= 0x2c1b3c6du;
+    Value ^= Value >> 12;
+    return Value;
+}
+
+static inline uint8_t
+MakeCell(unsigned X, unsigned Y, EMaterial Material)
+{
+    if (Material == KEmpty)
+        return 0;
+    return (uint8_t)(Material | (((Hash(X, Y, Material) >> 8) << KShadeShift) & KShadeMask));
+}
+
+static inline bool
+IsEmpty(const TRect& Rect)
+{
+    return Rect.X0 >= Rect.X1 || Rect.Y0 >= Rect.Y1;
+}
+
+static inline TRect
+Union(const TRect& A, const TRect& B)
+{
+    if (IsEmpty(A))
+        return B;
+    if (IsEmpty(B))
+        return A;
+    return { std::min(A.X0, B.X0), std::min(A.Y0, B.Y0), std::max(A.X1, B.X1), std::max(A.Y1, B.Y1) };
+}
+
+static inline TRect
+Intersect(const TRect& A, const TRect& B)
+{
+    return { std::max(A.X0, B.X0), std::max(A.Y0, B.Y0), std::min(A.X1, B.X1), std::min(A.Y1, B.Y1) };
+}
+
+static inline TRect
+GetChunkRect(const TCanvas& Canvas, unsigned ChunkX, unsigned ChunkY)
+{
+    return { (int)(ChunkX * KChunkSize), (int)(ChunkY * KChunkSize),
+             (int)std::min((ChunkX + 1) * KChunkSize, Canvas.Width),
+             (int)std::min((ChunkY + 1) * KChunkSize, Canvas.Height) };
+}
+
+// The cells an update of the chunk reads: moves go down or to the side by one cell.
+static inline TRect
+GetReadRect(const TCanvas& Canvas, unsigned ChunkX, unsigned ChunkY)
+{
+    const TRect Rect = GetChunkRect(Canvas, ChunkX, ChunkY);
+    return { Rect.X0 - 1, Rect.Y0, Rect.X1 + 1, Rect.Y1 + 1 };
+}
+
+// Swaps the cell at From with the one at To and marks what moved. An empty cell stays unmarked, so
+// that another cell can move into it in the same step.
+static inline void
+Move(uint8_t* From, uint8_t* To)
+{
+    const uint8_t Displaced = *To;
+    *To = *From | KMovedBit;
+    *From = Displaced ? (uint8_t)(Displaced | KMovedBit) : 0;
+}
+
+// False when none of the 8 cells at X can move: sand when nothing below it (diagonals included) is
+// empty or water, water when there is no empty cell below it or next to it. Cells past the end of the
+// chunk only make it return true more often.
+static inline bool
+CanMove(const uint8_t* Row, unsigned Pitch, int X)
+{
+    const uint64_t Materials = KBytes01 * KMaterialMask;
+    const uint64_t Cells = Load8(Row + X) & Materials;
+    if (Cells == 0)
+        return false;
+
+    const uint64_t BelowLeft = Load8(Row + Pitch + X - 1) & Materials;
+    const uint64_t BelowRight = Load8(Row + Pitch + X + 1) & Materials;
+    if (HasZeroByte(Cells ^ (KBytes01 * KSand)) && (~(BelowLeft & BelowRight) & (KBytes01 * KSolidBit)))
+        return true;
+
+    return HasZeroByte(Cells ^ (KBytes01 * KWater)) &&
+        (HasZeroByte(BelowLeft) || HasZeroByte(BelowRight) || HasZeroByte(Load8(Row + X - 1) & Materials) ||
+         HasZeroByte(Load8(Row + X + 1) & Materials));
+}
+
+// Bit N is set when the 8 cells at X0 + 8 N may move.
+static inline unsigned
+GetMovableBlocks(const uint8_t* Row, unsigned Pitch, int X0, int X1)
+{
+    unsigned Blocks = 0;
+    for (int X = X0, Block = 0; X < X1; X += 8, ++Block)
+        Blocks |= (unsigned)CanMove(Row, Pitch, X) << Block;
+    return Blocks;
+}
+
+// First half of a row update: every cell of the given blocks that can falls straight down. Cells
+// only move within their column here, so the result doesn't depend on the order of the columns.
+static unsigned
+FallRow(uint8_t* Row, unsigned Pitch, int X0, int X1, unsigned Blocks, unsigned& MovedBlocks)
+{
+    uint8_t* Below = Row + Pitch;
+    unsigned MoveCount = 0;
+
+    for (int X = X0, Block = 0; Blocks; X += 8, ++Block, Blocks >>= 1)
+    {
+        if ((Blocks & 1) == 0)
+            continue;
+        const unsigned Count = MoveCount;
+        const int End = std::min(X + 8, X1);
+        for (int Cell = X; Cell < End; ++Cell)
+        {
+            const uint8_t Material = Row[Cell] & (KMaterialMask | KMovedBit);
+            if ((Material == KSand && (Below[Cell] & KSandBlockers) == 0) ||
+                (Material == KWater && (Below[Cell] & KWaterBlockers) == 0))
+            {
+                Move(Row + Cell, Below + Cell);
+                MoveCount++;
+            }
+        }
+        if (MoveCount != Count)
+            MovedBlocks |= 1u << Block;
+    }
+    return MoveCount;
+}
+
+// Sand and water that couldn't fall slide diagonally down, to a random side first; water that can't
+// do that either flows sideways.
+static unsigned
+SlideCell(uint8_t* Row, unsigned Pitch, int X, unsigned Y, uint32_t Seed)
+{
+    const uint8_t Material = Row[X] & (KMaterialMask | KMovedBit);
+    if (Material != KSand && Material != KWater)
+        return 0;
+
+    uint8_t* Below = Row + Pitch;
+    const uint8_t Blockers = Material == KSand ? KSandBlockers : KWaterBlockers;
+    const int Side = (Hash((uint32_t)X, Y, Seed) & 1) ? 1 : -1;
+
+    if ((Below[X + Side] & Blockers) == 0)
+    {
+        Move(Row + X, Below + X + Side);
+        return 1;
+    }
+    if ((Below[X - Side] & Blockers) == 0)
+    {
+        Move(Row + X, Below + X - Side);
+        return 1;
+    }
+    if (Material == KWater)
+    {
+        if ((Row[X + Side] & KWaterBlockers) == 0)
+        {
+            Move(Row + X, Row + X + Side);
+            return 1;
+        }
+        if ((Row[X - Side] & KWaterBlockers) == 0)
+        {
+            Move(Row + X, Row + X - Side);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Second half of a row update, over the given blocks in the given direction. A cell moving ahead of
+// the sweep is marked, so it isn't visited again. Moves can make the next block movable. Sets the bits
+// of the blocks with moves in MovedBlocks.
+static unsigned
+SlideRow(uint8_t* Row, unsigned Pitch, int X0, int X1, unsigned Blocks, unsigned Y, uint32_t Seed,
+         bool LeftToRight, unsigned& MovedBlocks)
+{
+    unsigned MoveCount = 0;
+
+    if (LeftToRight)
+    {
+        for (int X = X0, Block = 0; X < X1 && Blocks; X += 8, ++Block, Blocks >>= 1)
+        {
+            if ((Blocks & 1) == 0 || !CanMove(Row, Pitch, X))
+                continue;
+            const unsigned Count = MoveCount;
+            const int End = std::min(X + 8, X1);
+            for (int Cell = X; Cell < End; ++Cell)
+                MoveCount += SlideCell(Row, Pitch, Cell, Y, Seed);
+            if (MoveCount != Count)
+            {
+                MovedBlocks |= 1u << Block;
+                Blocks |= 2;
+            }
+        }
+    }
+    else
+    {
+        for (int Block = (X1 - X0 - 1) / 8; Block >= 0; --Block)
+        {
+            const int X = X0 + 8 * Block;
+            if (((Blocks >> Block) & 1) == 0 || !CanMove(Row, Pitch, X))
+                continue;
+            const unsigned Count = MoveCount;
+            for (int Cell = std::min(X + 8, X1) - 1; Cell >= X; --Cell)
+                MoveCount += SlideCell(Row, Pitch, Cell, Y, Seed);
+            if (MoveCount == Count)
+                continue;
+            MovedBlocks |= 1u << Block;
+            if (Block > 0)
+                Blocks |= 1u << (Block - 1);
+        }
+    }
+    return MoveCount;
+}
+
+// The SIMD kernels: a row update in two passes over the cells, 16 or 32 at a time. The first applies
+// all falls (which stay within their column), the second finds the cells that can slide afterwards.
+// SlideCells() then moves those in the sweep order, as SlideRow() would.
+
+static inline bool
+CanFall(uint8_t Cell, uint8_t Below)
+{
+    const uint8_t Material = Cell & (KMaterialMask | KMovedBit);
+    return (Material == KSand && (Below & KSandBlockers) == 0) || (Material == KWater && (Below & KWaterBlockers) == 0);
+}
+
+static inline bool
+CanSlide(const uint8_t* Row, unsigned Pitch, int X)
+{
+    const uint8_t Material = Row[X] & (KMaterialMask | KMovedBit);
+    const uint8_t* Below = Row + Pitch;
+    if (Material == KSand)
+        return (Below[X - 1] & KSandBlockers) == 0 || (Below[X + 1] & KSandBlockers) == 0;
+    if (Material == KWater)
+    {
+        return (Below[X - 1] & KWaterBlockers) == 0 || (Below[X + 1] & KWaterBlockers) == 0 ||
+               (Row[X - 1] & KWaterBlockers) == 0 || (Row[X + 1] & KWaterBlockers) == 0;
+    }
+    return false;
+}
+
+// The cells [X, X1) that don't fill a vector; bit N of the result is the cell X0 + N.
+static uint64_t
+FallCells(uint8_t* Row, unsigned Pitch, int X0, int X, int X1)
+{
+    uint8_t* Below = Row + Pitch;
+    uint64_t Falls = 0;
+    for (; X < X1; ++X)
+    {
+        if (CanFall(Row[X], Below[X]))
+        {
+            Move(Row + X, Below + X);
+            Falls |= 1ull << (X - X0);
+        }
+    }
+    return Falls;
+}
+
+static uint64_t
+FindSlidingCells(const uint8_t* Row, unsigned Pitch, int X0, int X, int X1)
+{
+    uint64_t Slides = 0;
+    for (; X < X1; ++X)
+        Slides |= (uint64_t)CanSlide(Row, Pitch, X) << (X - X0);
+    return Slides;
+}
+
+static inline unsigned
+CountBits(uint64_t Value)
+{
+    Value = Value - ((Value >> 1) & 0x5555555555555555ull);
+    Value = (Value & 0x3333333333333333ull) + ((Value >> 2) & 0x3333333333333333ull);
+    Value = (Value + (Value >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (unsigned)((Value * KBytes01) >> 56);
+}
+
+static inline unsigned
+FindLowestBit(uint64_t Value)
+{
+#if defined(_MSC_VER)
+    unsigned long Index;
+    _BitScanForward64(&Index, Value);
+    return (unsigned)Index;
+#else
+    return (unsigned)__builtin_ctzll(Value);
+#endif
+}
+
+static inline unsigned
+FindHighestBit(uint64_t Value)
+{
+#if defined(_MSC_VER)
+    unsigned long Index;
+    _BitScanReverse64(&Index, Value);
+    return (unsigned)Index;
+#else
+    return 63 - (unsigned)__builtin_clzll(Value);
+#endif
+}
+
+// Bit N is set when one of the cells X0 + 8 N ... X0 + 8 N + 7 is set in Cells.
+static inline unsigned
+GetBlocks(uint64_t Cells)
+{
+    unsigned Blocks = 0;
+    for (unsigned Block = 0; Cells; ++Block, Cells >>= 8)
+        Blocks |= (unsigned)((Cells & 0xff) != 0) << Block;
+    return Blocks;
+}
+
+// Moves the cells of Slides (bits from X0) that still can when the sweep gets to them. A cell that
+// moves leaves an empty cell behind at most, which only the next cell of the sweep can flow into;
+// the others can only lose places to go.
+static unsigned
+SlideCells(uint8_t* Row, unsigned Pitch, int X0, int X1, uint64_t Slides, unsigned Y, uint32_t Seed,
+           bool LeftToRight, uint64_t& Moved)
+{
+    const unsigned Width = (unsigned)(X1 - X0);
+    unsigned MoveCount = 0;
+    while (Slides)
+    {
+        const unsigned Index = LeftToRight ? FindLowestBit(Slides) : FindHighestBit(Slides);
+        Slides &= ~(1ull << Index);
+        if (SlideCell(Row, Pitch, X0 + (int)Index, Y, Seed) == 0)
+            continue;
+
+        MoveCount++;
+        Moved |= 1ull << Index;
+        if (LeftToRight && Index + 1 < Width)
+            Slides |= 1ull << (Index + 1);
+        else if (!LeftToRight && Index > 0)
+            Slides |= 1ull << (Index - 1);
+    }
+    return MoveCount;
+}
+
+// Applies the falls of the cells [X0, X1) and returns them; OutSlides gets the cells that may slide
+// after them. Bit N is the cell X0 + N.
+typedef uint64_t (*TFallRowFunc)(uint8_t* Row, unsigned Pitch, int X0, int X1, uint64_t& OutSlides);
+
+#if defined(DEMO_SSE2)
+static inline DEMO_TARGET("sse4.1") __m128i
+TestClearSse41(__m128i Cells, uint8_t Bits)
+{
+    return _mm_cmpeq_epi8(_mm_and_si128(Cells, _mm_set1_epi8((char)Bits)), _mm_setzero_si128());
+}
+
+static DEMO_TARGET("sse4.1") uint64_t
+FallRowSse41(uint8_t* Row, unsigned Pitch, int X0, int X1, uint64_t& OutSlides)
+{
+    uint8_t* Below = Row + Pitch;
+    const __m128i MaterialBits = _mm_set1_epi8((char)(KMaterialMask | KMovedBit));
+    const __m128i Sand = _mm_set1_epi8(KSand);
+    const __m128i Water = _mm_set1_epi8(KWater);
+    const __m128i Moved = _mm_set1_epi8((char)KMovedBit);
+
+    uint64_t Falls = 0;
+    int X = X0;
+    for (; X + 16 <= X1; X += 16)
+    {
+        const __m128i Cells = _mm_loadu_si128((const __m128i*)(Row + X));
+        const __m128i Under = _mm_loadu_si128((const __m128i*)(Below + X));
+        const __m128i Material = _mm_and_si128(Cells, MaterialBits);
+        const __m128i Fall =
+            _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi8(Material, Sand), TestClearSse41(Under, KSandBlockers)),
+                         _mm_and_si128(_mm_cmpeq_epi8(Material, Water), TestClearSse41(Under, KWaterBlockers)));
+        const uint32_t Mask = (uint32_t)_mm_movemask_epi8(Fall);
+        if (Mask == 0)
+            continue;
+
+        // Move() for every falling cell: the one below comes up marked, unless it's empty.
+        const __m128i Displaced = _mm_andnot_si128(TestClearSse41(Under, 0xff), _mm_or_si128(Under, Moved));
+        _mm_storeu_si128((__m128i*)(Below + X), _mm_blendv_epi8(Under, _mm_or_si128(Cells, Moved), Fall));
+        _mm_storeu_si128((__m128i*)(Row + X), _mm_blendv_epi8(Cells, Displaced, Fall));
+        Falls |= (uint64_t)Mask << (X - X0);
+    }
+    Falls |= FallCells(Row, Pitch, X0, X, X1);
+
+    uint64_t Slides = 0;
+    for (X = X0; X + 16 <= X1; X += 16)
+    {
+        const __m128i Material = _mm_and_si128(_mm_loadu_si128((const __m128i*)(Row + X)), MaterialBits);
+        const __m128i BelowLeft = _mm_loadu_si128((const __m128i*)(Below + X - 1));
+        const __m128i BelowRight = _mm_loadu_si128((const __m128i*)(Below + X + 1));
+        const __m128i Left = _mm_loadu_si128((const __m128i*)(Row + X - 1));
+        const __m128i Right = _mm_loadu_si128((const __m128i*)(Row + X + 1));
+        const __m128i SandSlide =
+            _mm_and_si128(_mm_cmpeq_epi8(Material, Sand),
+                          _mm_or_si128(TestClearSse41(BelowLeft, KSandBlockers),
+                                       TestClearSse41(BelowRight, KSandBlockers)));
+        const __m128i WaterSlide =
+            _mm_and_si128(_mm_cmpeq_epi8(Material, Water),
+                          _mm_or_si128(_mm_or_si128(TestClearSse41(BelowLeft, KWaterBlockers),
+                                                    TestClearSse41(BelowRight, KWaterBlockers)),
+                                       _mm_or_si128(TestClearSse41(Left, KWaterBlockers),
+                                                    TestClearSse41(Right, KWaterBlockers))));
+        Slides |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_or_si128(SandSlide, WaterSlide)) << (X - X0);
+    }
+    OutSlides = Slides | FindSlidingCells(Row, Pitch, X0, X, X1);
+    return Falls;
+}
+
+static inline DEMO_TARGET("avx2") __m256i
+TestClearAvx2(__m256i Cells, uint8_t Bits)
+{
+    return _mm256_cmpeq_epi8(_mm256_and_si256(Cells, _mm256_set1_epi8((char)Bits)), _mm256_setzero_si256());
+}
+
+static DEMO_TARGET("avx2") uint64_t
+FallRowAvx2(uint8_t* Row, unsigned Pitch, int X0, int X1, uint64_t& OutSlides)
+{
+    uint8_t* Below = Row + Pitch;
+    const __m256i MaterialBits = _mm256_set1_epi8((char)(KMaterialMask | KMovedBit));
+    const __m256i Sand = _mm256_set1_epi8(KSand);
+    const __m256i Water = _mm256_set1_epi8(KWater);
+    const __m256i Moved = _mm256_set1_epi8((char)KMovedBit);
+
+    uint64_t Falls = 0;
+    int X = X0;
+    for (; X + 32 <= X1; X += 32)
+    {
+        const __m256i Cells = _mm256_loadu_si256((const __m256i*)(Row + X));
+        const __m256i Under = _mm256_loadu_si256((const __m256i*)(Below + X));
+        const __m256i Material = _mm256_and_si256(Cells, MaterialBits);
+        const __m256i Fall =
+            _mm256_or_si256(_mm256_and_si256(_mm256_cmpeq_epi8(Material, Sand), TestClearAvx2(Under, KSandBlockers)),
+                            _mm256_and_si256(_mm256_cmpeq_epi8(Material, Water), TestClearAvx2(Under, KWaterBlockers)));
+        const uint32_t Mask = (uint32_t)_mm256_movemask_epi8(Fall);
+        if (Mask == 0)
+            continue;
+
+        const __m256i Displaced = _mm256_andnot_si256(TestClearAvx2(Under, 0xff), _mm256_or_si256(Under, Moved));
+        _mm256_storeu_si256((__m256i*)(Below + X), _mm256_blendv_epi8(Under, _mm256_or_si256(Cells, Moved), Fall));
+        _mm256_storeu_si256((__m256i*)(Row + X), _mm256_blendv_epi8(Cells, Displaced, Fall));
+        Falls |= (uint64_t)Mask << (X - X0);
+    }
+    Falls |= FallCells(Row, Pitch, X0, X, X1);
+
+    uint64_t Slides = 0;
+    for (X = X0; X + 32 <= X1; X += 32)
+    {
+        const __m256i Material = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(Row + X)), MaterialBits);
+        const __m256i BelowLeft = _mm256_loadu_si256((const __m256i*)(Below + X - 1));
+        const __m256i BelowRight = _mm256_loadu_si256((const __m256i*)(Below + X + 1));
+        const __m256i Left = _mm256_loadu_si256((const __m256i*)(Row + X - 1));
+        const __m256i Right = _mm256_loadu_si256((const __m256i*)(Row + X + 1));
+        const __m256i SandSlide =
+            _mm256_and_si256(_mm256_cmpeq_epi8(Material, Sand),
+                             _mm256_or_si256(TestClearAvx2(BelowLeft, KSandBlockers),
+                                             TestClearAvx2(BelowRight, KSandBlockers)));
+        const __m256i WaterSlide =
+            _mm256_and_si256(_mm256_cmpeq_epi8(Material, Water),
+                             _mm256_or_si256(_mm256_or_si256(TestClearAvx2(BelowLeft, KWaterBlockers),
+                                                             TestClearAvx2(BelowRight, KWaterBlockers)),
+                                             _mm256_or_si256(TestClearAvx2(Left, KWaterBlockers),
+                                                             TestClearAvx2(Right, KWaterBlockers))));
+        Slides |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(SandSlide, WaterSlide)) << (X - X0);
+    }
+    OutSlides = Slides | FindSlidingCells(Row, Pitch, X0, X, X1);
+    return Falls;
+}
+#endif
+
+#if defined(DEMO_NEON)
+static inline uint8x16_t
+TestClearNeon(uint8x16_t Cells, uint8_t Bits)
+{
+    return vceqq_u8(vandq_u8(Cells, vdupq_n_u8(Bits)), vdupq_n_u8(0));
+}
+
+// _mm_movemask_epi8() for lanes that are all ones or all zeros.
+static inline uint32_t
+MoveMaskNeon(uint8x16_t Lanes)
+{
+    static const uint8_t KLaneBits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t Bits = vandq_u8(Lanes, vld1q_u8(KLaneBits));
+    return (uint32_t)vaddv_u8(vget_low_u8(Bits)) | ((uint32_t)vaddv_u8(vget_high_u8(Bits)) << 8);
+}
+
+static uint64_t
+FallRowNeon(uint8_t* Row, unsigned Pitch, int X0, int X1, uint64_t& OutSlides)
+{
+    uint8_t* Below = Row + Pitch;
+    const uint8x16_t MaterialBits = vdupq_n_u8(KMaterialMask | KMovedBit);
+    const uint8x16_t Sand = vdupq_n_u8(KSand);
+    const uint8x16_t Water = vdupq_n_u8(KWater);
+    const uint8x16_t Moved = vdupq_n_u8(KMovedBit);
+
+    uint64_t Falls = 0;
+    int X = X0;
+    for (; X + 16 <= X1; X += 16)
+    {
+        const uint8x16_t Cells = vld1q_u8(Row + X);
+        const uint8x16_t Under = vld1q_u8(Below + X);
+        const uint8x16_t Material = vandq_u8(Cells, MaterialBits);
+        const uint8x16_t Fall = vorrq_u8(vandq_u8(vceqq_u8(Material, Sand), TestClearNeon(Under, KSandBlockers)),
+                                         vandq_u8(vceqq_u8(Material, Water), TestClearNeon(Under, KWaterBlockers)));
+        const uint32_t Mask = MoveMaskNeon(Fall);
+        if (Mask == 0)
+            continue;
+
+        const uint8x16_t Displaced = vbicq_u8(vorrq_u8(Under, Moved), TestClearNeon(Under, 0xff));
+        vst1q_u8(Below + X, vbslq_u8(Fall, vorrq_u8(Cells, Moved), Under));
+        vst1q_u8(Row + X, vbslq_u8(Fall, Displaced, Cells));
+        Falls |= (uint64_t)Mask << (X - X0);
+    }
+    Falls |= FallCells(Row, Pitch, X0, X, X1);
+
+    uint64_t Slides = 0;
+    for (X = X0; X + 16 <= X1; X += 16)
+    {
+        const uint8x16_t Material = vandq_u8(vld1q_u8(Row + X), MaterialBits);
+        const uint8x16_t BelowLeft = vld1q_u8(Below + X - 1);
+        const uint8x16_t BelowRight = vld1q_u8(Below + X + 1);
+        const uint8x16_t Left = vld1q_u8(Row + X - 1);
+        const uint8x16_t Right = vld1q_u8(Row + X + 1);
+        const uint8x16_t SandSlide =
+            vandq_u8(vceqq_u8(Material, Sand),
+                     vorrq_u8(TestClearNeon(BelowLeft, KSandBlockers), TestClearNeon(BelowRight, KSandBlockers)));
+        const uint8x16_t WaterSlide =
+            vandq_u8(vceqq_u8(Material, Water),
+                     vorrq_u8(vorrq_u8(TestClearNeon(BelowLeft, KWaterBlockers),
+                                       TestClearNeon(BelowRight, KWaterBlockers)),
+                              vorrq_u8(TestClearNeon(Left, KWaterBlockers), TestClearNeon(Right, KWaterBlockers))));
+        Slides |= (uint64_t)MoveMaskNeon(vorrq_u8(SandSlide, WaterSlide)) << (X - X0);
+    }
+    OutSlides = Slides | FindSlidingCells(Row, Pitch, X0, X, X1);
+    return Falls;
+}
+#endif
+
+// Indexed by EKernel; nullptr for the scalar kernel and the ones the build doesn't have.
+static const TFallRowFunc KFallRowFuncs[KKernelCount] =
+{
+    nullptr,
+#if defined(DEMO_SSE2)
+    FallRowSse41,
+    FallRowAvx2,
+#else
+    nullptr,
+    nullptr,
+#endif
+#if defined(DEMO_NEON)
+    FallRowNeon,
+#else
+    nullptr,
+#endif
+};
+
+// Rows bottom to top, so a cell that falls lands in a row that was already updated. OutChanged gets
+// the cells the moves changed.
+static unsigned
+UpdateChunk(TCanvas& Canvas, unsigned ChunkX, unsigned ChunkY, bool LeftToRight, TRect& OutChanged)
+{
+    const int X0 = (int)(ChunkX * KChunkSize);
+    const int X1 = (int)std::min((ChunkX + 1) * KChunkSize, Canvas.Width);
+    const unsigned Y0 = ChunkY * KChunkSize;
+    const unsigned Y1 = std::min((ChunkY + 1) * KChunkSize, Canvas.Height);
+    const uint32_t Seed = (uint32_t)Canvas.StepCount;
+
+    const TFallRowFunc FallRowFunc = KFallRowFuncs[Canvas.Kernel];
+
+    unsigned MoveCount = 0;
+    OutChanged = {};
+    for (unsigned Y = Y1; Y-- > Y0;)
+    {
+        uint8_t* Row = GetRow(Canvas, Y);
+        unsigned MovedBlocks = 0;
+        if (FallRowFunc)
+        {
+            uint64_t Slides;
+            uint64_t Moved = FallRowFunc(Row, Canvas.Pitch, X0, X1, Slides);
+            if ((Moved | Slides) == 0)
+                continue;
+            MoveCount += CountBits(Moved);
+            MoveCount += SlideCells(Row, Canvas.Pitch, X0, X1, Slides, Y, Seed, LeftToRight, Moved);
+            MovedBlocks = GetBlocks(Moved);
+        }
+        else
+        {
+            const unsigned Blocks = GetMovableBlocks(Row, Canvas.Pitch, X0, X1);
+            if (Blocks == 0)
+                continue;
+
+            // Falls change only the cells of movable blocks, which can make their neighbours movable.
+            const unsigned BlockMask = (1u << ((X1 - X0 + 7) / 8)) - 1;
+            MoveCount += FallRow(Row, Canvas.Pitch, X0, X1, Blocks, MovedBlocks);
+            MoveCount += SlideRow(Row, Canvas.Pitch, X0, X1, (Blocks | Blocks << 1 | Blocks >> 1) & BlockMask, Y,
+                                  Seed, LeftToRight, MovedBlocks);
+        }
+        if (MovedBlocks == 0)
+            continue;
+
+        // The cells of these blocks moved at most one cell down or to the side.
+        int First = 0, Last = 7;
+        while (((MovedBlocks >> First) & 1) == 0)
+            First++;
+        while (((MovedBlocks >> Last) & 1) == 0)
+            Last--;
+        const TRect Changed = { X0 + 8 * First - 1, (int)Y, std::min(X0 + 8 * Last + 8, X1) + 1, (int)Y + 2 };
+        OutChanged = Union(OutChanged, Changed);
+    }
+    return MoveCount;
+}
+
+// True when a cell the chunk's update reads changed in the last step or since, before the chunk's turn
+// in this one. Changes made earlier in the last step count too: the cells they marked may have kept
+// the chunk from moving anything then. The last two updates of the chunks around it cover all of that.
+static bool
+NeedsUpdate(const TCanvas& Canvas, unsigned ChunkX, unsigned ChunkY)
+{
+    const TRect ReadRect = GetReadRect(Canvas, ChunkX, ChunkY);
+    for (unsigned Y = ChunkY > 0 ? ChunkY - 1 : 0; Y <= std::min(ChunkY + 1, Canvas.ChunkCountY - 1); ++Y)
+    {
+        for (unsigned X = ChunkX > 0 ? ChunkX - 1 : 0; X <= std::min(ChunkX + 1, Canvas.ChunkCountX - 1); ++X)
+        {
+            const TChunk& Chunk = Canvas.Chunks[Y * Canvas.ChunkCountX + X];
+            if (!IsEmpty(Intersect(Chunk.Changed, ReadRect)) || !IsEmpty(Intersect(Chunk.PreviousChanged, ReadRect)))
+                return true;
+        }
+    }
+    return false;
+}
+
+// Checkerboard phase of a step: the chunks (PhaseX + 2 I, PhaseY + 2 J). A chunk update touches its
+// own cells and the cells next to it, so chunks two apart never touch the same cell (or the same
+// 8-byte word); the chunks of a phase run in parallel and the result doesn't depend on their order.
+// A chunk reads the state of the chunks around it, which are in other phases.
+struct TPhase
+{
+    TCanvas* Canvas;
+    unsigned PhaseX;
+    unsigned PhaseY;
+    unsigned CountX; // chunks of the phase in a row
+    bool LeftToRight;
+};
+
+static void
+UpdatePhaseChunks(void* Context, unsigned Begin, unsigned End)
+{
+    const TPhase& Phase = *(const TPhase*)Context;
+    TCanvas& Canvas = *Phase.Canvas;
+
+    for (unsigned Index = Begin; Index < End; ++Index)
+    {
+        const unsigned ChunkX = Phase.PhaseX + 2 * (Index % Phase.CountX);
+        const unsigned ChunkY = Phase.PhaseY + 2 * (Index / Phase.CountX);
+        TChunk& Chunk = Canvas.Chunks[ChunkY * Canvas.ChunkCountX + ChunkX];
+
+        // A sleeping chunk would move nothing, like in its last update.
+        Chunk.Active = Chunk.Woken || NeedsUpdate(Canvas, ChunkX, ChunkY);
+        Chunk.Woken = false;
+        Chunk.PreviousChanged = Chunk.Changed;
+        if (Chunk.Active)
+        {
+            Chunk.MoveCount = UpdateChunk(Canvas, ChunkX, ChunkY, Phase.LeftToRight, Chunk.Changed);
+        }
+        else
+        {
+            Chunk.MoveCount = 0;
+            Chunk.Changed = {};
+        }
+    }
+}
+
+// Marks are only in the cells the step changed, which are at most one cell away from the chunk whose
+// update changed them. Each chunk clears the marks in its own cells and adds the changed ones to its
+// dirty rectangle.
+static void
+FinishChunks(void* Context, unsigned Begin, unsigned End)
+{
+    TCanvas& Canvas = *(TCanvas*)Context;
+
+    for (unsigned Index = Begin; Index < End; ++Index)
+    {
+        const unsigned ChunkX = Index % Canvas.ChunkCountX;
+        const unsigned ChunkY = Index / Canvas.ChunkCountX;
+        const TRect ChunkRect = GetChunkRect(Canvas, ChunkX, ChunkY);
+
+        TRect Changed = {};
+        for (unsigned Y = ChunkY > 0 ? ChunkY - 1 : 0; Y <= ChunkY; ++Y)
+        {
+            for (unsigned X = ChunkX > 0 ? ChunkX - 1 : 0; X <= std::min(ChunkX + 1, Canvas.ChunkCountX - 1); ++X)
+                Changed = Union(Changed, Canvas.Chunks[Y * Canvas.ChunkCountX + X].Changed);
+        }
+        Changed = Intersect(Changed, ChunkRect);
+        if (IsEmpty(Changed))
+            continue;
+
+        TChunk& Chunk = Canvas.Chunks[Index];
+        Chunk.Dirty = Union(Chunk.Dirty, Changed);
+
+        // Whole words from the start of the chunk; the last chunk of a row may clear into the border,
+        // which has no marks.
+        const int X0 = Changed.X0 - (Changed.X0 - ChunkRect.X0) % 8;
+        for (int Y = Changed.Y0; Y < Changed.Y1; ++Y)
+        {
+            uint8_t* Row = GetRow(Canvas, (unsigned)Y);
+            for (int X = X0; X < Changed.X1; X += 8)
+                Store8(Row + X, Load8(Row + X) & ~(KBytes01 * KMovedBit));
+        }
+    }
+}
+
+static inline uint32_t
+ScaleColor(uint32_t Color, unsigned Scale)
+{
+    uint32_t Result = Color & 0xff000000;
+    for (unsigned Shift = 0; Shift < 24; Shift += 8)
+        Result |= std::min((((Color >> Shift) & 0xff) * Scale) >> 8, 255u) << Shift;
+    return Result;
+}
+
+// Water colours of the gather table: one per shimmer phase for each shade.
+static const unsigned KWaterColorCount = ((KShadeMask >> KShadeShift) + 1) * KShimmerPhaseCount;
+
+// Cells to colours of X, Y and the following cells of the row, as the pixel shader does it.
+static void
+ConvertRow(const uint8_t* Cells, unsigned Count, unsigned X, unsigned Y, uint32_t Frame,
+           const uint32_t* Palette, uint32_t* Pixels)
+{
+    for (unsigned Index = 0; Index < Count; ++Index)
+    {
+        const uint8_t Cell = Cells[Index];
+        Pixels[Index] = Palette[Cell & ~KMovedBit];
+        if ((Cell & KMaterialMask) == KWater)
+            Pixels[Index] = ScaleColor(Pixels[Index], GetShimmerScale(GetShimmerPhase(X + Index, Y, Frame)));
+    }
+}
+
+#if defined(DEMO_SSE2)
+// ConvertRow() with 8 gathers at a time from the palette and the water colours of each phase after it.
+static DEMO_TARGET("avx2") void
+ConvertRowAvx2(const uint8_t* Cells, unsigned Count, unsigned X, unsigned Y, uint32_t Frame,
+               const uint32_t* Table, uint32_t* Pixels)
+{
+    const __m256i PhaseSteps = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    unsigned Index = 0;
+    for (; Index + 8 <= Count; Index += 8)
+    {
+        const __m256i Cell = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(Cells + Index)));
+        const __m256i IsWater = _mm256_cmpeq_epi32(_mm256_and_si256(Cell, _mm256_set1_epi32(KMaterialMask)),
+                                                   _mm256_set1_epi32(KWater));
+        // GetShimmerPhase() of the 8 cells.
+        const __m256i Phase = _mm256_and_si256(
+            _mm256_add_epi32(_mm256_set1_epi32((int)((X + Index) * 3 + Y * 5 + Frame * 2)), PhaseSteps),
+            _mm256_set1_epi32(KShimmerPhaseCount - 1));
+        // Water: KPaletteSize + shade * KShimmerPhaseCount + phase.
+        const __m256i Shade = _mm256_srli_epi32(_mm256_and_si256(Cell, _mm256_set1_epi32(KShadeMask)), KShadeShift);
+        const __m256i ShadeBase = _mm256_mullo_epi32(Shade, _mm256_set1_epi32(KShimmerPhaseCount));
+        const __m256i WaterIndex = _mm256_add_epi32(_mm256_add_epi32(ShadeBase, Phase),
+                                                    _mm256_set1_epi32(KPaletteSize));
+        const __m256i PaletteIndex = _mm256_and_si256(Cell, _mm256_set1_epi32(KPaletteSize - 1));
+        const __m256i TableIndex = _mm256_blendv_epi8(PaletteIndex, WaterIndex, IsWater);
+        _mm256_storeu_si256((__m256i*)(Pixels + Index), _mm256_i32gather_epi32((const int*)Table, TableIndex, 4));
+    }
+    ConvertRow(Cells + Index, Count - Index, X + Index, Y, Frame, Table, Pixels + Index);
+}
+#endif
+
+static void
+KeepAsset(Load::TAsset& Asset)
+{
+    assert(!Asset.Failed);
+    *(Load::TAsset*)Asset.Context = Asset;
+    Asset.Data = nullptr;
+}
+
+} // namespace Priv
+
+static bool
+IsKernelSupported(EKernel Kernel)
+{
+    static const uint32_t KRequiredFeatures[KKernelCount] = { 0, Lib::KCpuSse41, Lib::KCpuAvx2, Lib::KCpuNeon };
+    if (Kernel != KKernelScalar && !Priv::KFallRowFuncs[Kernel])
+        return false;
+    return (Lib::GetCpuFeatures() & KRequiredFeatures[Kernel]) == KRequiredFeatures[Kernel];
+}
+
+static EKernel
+GetBestKernel()
+{
+    static const EKernel KBestKernel = IsKernelSupported(KKernelAvx2) ? KKernelAvx2
+                                       : IsKernelSupported(KKernelSse41) ? KKernelSse41
+                                       : IsKernelSupported(KKernelNeon) ? KKernelNeon
+                                       : KKernelScalar;
+    return KBestKernel;
+}
+
+static const char*
+GetKernelName(EKernel Kernel)
+{
+    static const char* KNames[KKernelCount] = { "scalar", "sse41", "avx2", "neon" };
+    return KNames[Kernel];
+}
+
+static void
+CreateCanvas(TCanvas& Canvas, unsigned Width, unsigned Height)
+{
+    assert(Width > 0 && Height > 0);
+
+    Canvas.Width = Width;
+    Canvas.Height = Height;
+    Canvas.Pitch = (Width + 2 * KBorder + 63) & ~63u;
+    Canvas.ChunkCountX = (Width + KChunkSize - 1) / KChunkSize;
+    Canvas.ChunkCountY = (Height + KChunkSize - 1) / KChunkSize;
+    Canvas.Chunks.assign(Canvas.ChunkCountX * Canvas.ChunkCountY, TChunk{});
+    Canvas.StepCount = 0;
+    Canvas.StepTime = 0.0;
+    Canvas.Kernel = GetBestKernel();
+
+    for (unsigned ChunkY = 0; ChunkY < Canvas.ChunkCountY; ++ChunkY)
+    {
+        for (unsigned ChunkX = 0; ChunkX < Canvas.ChunkCountX; ++ChunkX)
+        {
+            TChunk& Chunk = Canvas.Chunks[ChunkY * Canvas.ChunkCountX + ChunkX];
+            Chunk.Woken = true;
+            Chunk.Dirty = Priv::GetChunkRect(Canvas, ChunkX, ChunkY);
+        }
+    }
+
+    // Everything outside the canvas is stone, which neither moves nor lets anything in.
+    Canvas.Storage.assign((size_t)Canvas.Pitch * (Height + 1), KStone);
+    for (unsigned Y = 0; Y < Height; ++Y)
+        memset(GetRow(Canvas, Y), 0, Width);
+}
+
+static void
+WakeChunks(TCanvas& Canvas, const TRect& CellRect)
+{
+    const TRect Rect = Priv::Intersect(CellRect, { 0, 0, (int)Canvas.Width, (int)Canvas.Height });
+    if (Priv::IsEmpty(Rect))
+        return;
+
+    // The update of a chunk reads one cell past its sides and bottom, so the chunks left of, right of
+    // and above the rectangle may need it too.
+    const int KSize = (int)KChunkSize;
+    const unsigned MinX = (unsigned)std::max((Rect.X0 - 1) / KSize, 0);
+    const unsigned MinY = (unsigned)std::max((Rect.Y0 - 1) / KSize, 0);
+    const unsigned MaxX = std::min((unsigned)Rect.X1 / KChunkSize, Canvas.ChunkCountX - 1);
+    const unsigned MaxY = std::min((unsigned)(Rect.Y1 - 1) / KChunkSize, Canvas.ChunkCountY - 1);
+    for (unsigned ChunkY = MinY; ChunkY <= MaxY; ++ChunkY)
+    {
+        for (unsigned ChunkX = MinX; ChunkX <= MaxX; ++ChunkX)
+        {
+            TChunk& Chunk = Canvas.Chunks[ChunkY * Canvas.ChunkCountX + ChunkX];
+            const TRect ChunkRect = Priv::GetChunkRect(Canvas, ChunkX, ChunkY);
+            if (!Priv::IsEmpty(Priv::Intersect(Rect, Priv::GetReadRect(Canvas, ChunkX, ChunkY))))
+                Chunk.Woken = true;
+            Chunk.Dirty = Priv::Union(Chunk.Dirty, Priv::Intersect(Rect, ChunkRect));
+        }
+    }
+}
+
+static void
+Paint(TCanvas& Canvas, float X0, float Y0, float X1, float Y1, float Radius, EMaterial Material)
+{
+    const int MinX = std::max((int)floorf(std::min(X0, X1) - Radius), 0);
+    const int MinY = std::max((int)floorf(std::min(Y0, Y1) - Radius), 0);
+    const int MaxX = std::min((int)ceilf(std::max(X0, X1) + Radius), (int)Canvas.Width - 1);
+    const int MaxY = std::min((int)ceilf(std::max(Y0, Y1) + Radius), (int)Canvas.Height - 1);
+
+    const float DirectionX = X1 - X0;
+    const float DirectionY = Y1 - Y0;
+    const float LengthSquared = DirectionX * DirectionX + DirectionY * DirectionY;
+
+    TRect Changed = {};
+    for (int Y = MinY; Y <= MaxY; ++Y)
+    {
+        uint8_t* Row = GetRow(Canvas, (unsigned)Y);
+        for (int X = MinX; X <= MaxX; ++X)
+        {
+            // Distance from the cell centre to the closest point of the segment.
+            const float PointX = X + 0.5f - X0;
+            const float PointY = Y + 0.5f - Y0;
+            float T = LengthSquared > 0.0f ? (PointX * DirectionX + PointY * DirectionY) / LengthSquared : 0.0f;
+            T = std::min(std::max(T, 0.0f), 1.0f);
+            const float DistanceX = PointX - T * DirectionX;
+            const float DistanceY = PointY - T * DirectionY;
+            if (DistanceX * DistanceX + DistanceY * DistanceY > Radius * Radius)
+                continue;
+
+            const uint8_t Cell = Priv::MakeCell((unsigned)X, (unsigned)Y, Material);
+            if (Row[X] != Cell)
+            {
+                Row[X] = Cell;
+                Changed = Priv::Union(Changed, { X, Y, X + 1, Y + 1 });
+            }
+        }
+    }
+    WakeChunks(Canvas, Changed);
+}
+
+static void
+Step(TCanvas& Canvas)
+{
+    PROF_ZONE("Sand::Step");
+
+    // The order of the phases is part of the result; the order of the chunks in a phase isn't.
+    static const unsigned KPhases[4][2] = { { 0, 1 }, { 1, 1 }, { 0, 0 }, { 1, 0 } };
+    for (const unsigned* PhaseXY : KPhases)
+    {
+        Priv::TPhase Phase;
+        Phase.Canvas = &Canvas;
+        Phase.PhaseX = PhaseXY[0];
+        Phase.PhaseY = PhaseXY[1];
+        Phase.CountX = (Canvas.ChunkCountX - Phase.PhaseX + 1) / 2;
+        Phase.LeftToRight = (Canvas.StepCount & 1) == 0;
+        const unsigned CountY = (Canvas.ChunkCountY - Phase.PhaseY + 1) / 2;
+        Jobs::ParallelFor(Phase.CountX * CountY, 1, Priv::UpdatePhaseChunks, &Phase);
+    }
+
+    Jobs::ParallelFor((unsigned)Canvas.Chunks.size(), 8, Priv::FinishChunks, &Canvas);
+    Canvas.StepCount++;
+}
+
+static unsigned
+Update(TCanvas& Canvas, double DeltaTime)
+{
+    Canvas.StepTime += DeltaTime;
+
+    unsigned StepCount = 0;
+    while (Canvas.StepTime >= KStepTime && StepCount < KMaxStepsPerUpdate)
+    {
+        Step(Canvas);
+        Canvas.StepTime -= KStepTime;
+        StepCount++;
+    }
+
+    // Behind by more than KMaxStepsPerUpdate steps: slow down instead of trying to catch up.
+    Canvas.StepTime = std::min(Canvas.StepTime, KStepTime);
+    return StepCount;
+}
+
+static uint64_t
+GetMoveCount(const TCanvas& Canvas)
+{
+    uint64_t MoveCount = 0;
+    for (const TChunk& Chunk : Canvas.Chunks)
+        MoveCount += Chunk.MoveCount;
+    return MoveCount;
+}
+
+static unsigned
+GetActiveChunkCount(const TCanvas& Canvas)
+{
+    unsigned Count = 0;
+    for (const TChunk& Chunk : Canvas.Chunks)
+        Count += Chunk.Active;
+    return Count;
+}
+
+static uint64_t
+GetHash(const TCanvas& Canvas)
+{
+    uint64_t Hash = 0xcbf29ce484222325ull;
+    for (unsigned Y = 0; Y < Canvas.Height; ++Y)
+    {
+        const uint8_t* Row = GetRow(Canvas, Y);
+        unsigned X = 0;
+        for (; X + 8 <= Canvas.Width; X += 8)
+            Hash = (Hash ^ Priv::Load8(Row + X)) * 0x100000001b3ull;
+        for (; X < Canvas.Width; ++X)
+            Hash = (Hash ^ Row[X]) * 0x100000001b3ull;
+    }
+    return Hash ^ Canvas.StepCount;
+}
+
+static void
+CountMaterials(const TCanvas& Canvas, uint64_t OutCounts[KMaterialCount])
+{
+    memset(OutCounts, 0, KMaterialCount * sizeof(OutCounts[0]));
+    for (unsigned Y = 0; Y < Canvas.Height; ++Y)
+    {
+        const uint8_t* Row = GetRow(Canvas, Y);
+        for (unsigned X = 0; X < Canvas.Width; ++X)
+            OutCounts[Row[X] & KMaterialMask]++;
+    }
+}
+
+static void
+MakePalette(uint32_t OutPalette[KPaletteSize])
+{
+    for (unsigned Cell = 0; Cell < KPaletteSize; ++Cell)
+    {
+        const unsigned Material = Cell & KMaterialMask;
+        const uint32_t Color = Material < KMaterialCount ? Priv::KMaterialColors[Material] : 0xffff00ff;
+        OutPalette[Cell] = Priv::ScaleColor(Color, 215 + 5 * ((Cell & KShadeMask) >> KShadeShift));
+    }
+}
+
+static void
+ConvertToRgba(const TCanvas& Canvas, unsigned X, unsigned Y, unsigned Width, unsigned Height, void* Destination,
+              unsigned DestinationPitch, uint32_t Frame, EKernel Kernel)
+{
+    static_assert(KPaletteSize == KMovedBit, "cells index the palette without KMovedBit");
+    assert(X + Width <= Canvas.Width && Y + Height <= Canvas.Height);
+
+    // The gather table is the palette followed by the water colours of every shade and shimmer phase.
+    uint32_t Table[KPaletteSize + Priv::KWaterColorCount];
+    MakePalette(Table);
+
+#if defined(DEMO_SSE2)
+    if (Kernel == KKernelAvx2 && IsKernelSupported(KKernelAvx2))
+    {
+        for (unsigned Shade = 0; Shade < (KShadeMask >> KShadeShift) + 1; ++Shade)
+        {
+            for (unsigned Phase = 0; Phase < KShimmerPhaseCount; ++Phase)
+            {
+                Table[KPaletteSize + Shade * KShimmerPhaseCount + Phase] =
+                    Priv::ScaleColor(Table[KWater | (Shade << KShadeShift)], GetShimmerScale(Phase));
+            }
+        }
+        for (unsigned Row = 0; Row < Height; ++Row)
+        {
+            Priv::ConvertRowAvx2(GetRow(Canvas, Y + Row) + X, Width, X, Y + Row, Frame, Table,
+                                 (uint32_t*)((uint8_t*)Destination + (size_t)Row * DestinationPitch));
+        }
+        return;
+    }
+#endif
+    (void)Kernel;
+
+    for (unsigned Row = 0; Row < Height; ++Row)
+    {
+        Priv::ConvertRow(GetRow(Canvas, Y + Row) + X, Width, X, Y + Row, Frame, Table,
+                         (uint32_t*)((uint8_t*)Destination + (size_t)Row * DestinationPitch));
+    }
+}
+
+static void
+RequestAssets()
+{
+#if !defined(DEMO_HEADLESS)
+    Load::Request("Data/Shaders/DisplayCanvas.vs.cso", nullptr, Priv::KeepAsset, &Priv::GCsoVs);
+    Load::Request("Data/Shaders/DisplayCanvas.ps.cso", nullptr, Priv::KeepAsset, &Priv::GCsoPs);
+#endif
+    Priv::GAssetsRequested = true;
+}
+
+static void
+Initialize(unsigned Width, unsigned Height)
+{
+    if (!Priv::GAssetsRequested)
+        RequestAssets();
+    Load::Flush();
+    Priv::GAssetsRequested = false;
+
+    Priv::GTextureSize[0] = Width;
+    Priv::GTextureSize[1] = Height;
+    Dx::AllocateDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 2, Priv::GTextureDescriptors);
+    D3D12_CPU_DESCRIPTOR_HANDLE PaletteDescriptor = Priv::GTextureDescriptors;
+    PaletteDescriptor.ptr += Dx::GDescriptorSize;
+
+#if !defined(DEMO_HEADLESS)
+    // Render() overwrites the whole texture of the cells before the first draw.
+    const auto TextureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8_UINT, (UINT64)Width, Height, 1, 1);
+    VHR(Dx::GDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE,
+                                             &TextureDesc, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, nullptr,
+                                             IID_PPV_ARGS(&Priv::GTexture)));
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC SrvDesc = {};
+    SrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    SrvDesc.Format = DXGI_FORMAT_R8_UINT;
+    SrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    SrvDesc.Texture2D.MipLevels = 1;
+
+    Dx::GDevice->CreateShaderResourceView(Priv::GTexture, &SrvDesc, Priv::GTextureDescriptors);
+
+    const auto PaletteDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, KPaletteSize, 1, 1, 1);
+    VHR(Dx::GDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE,
+                                             &PaletteDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+                                             IID_PPV_ARGS(&Priv::GPaletteTexture)));
+
+    ID3D12Resource* IntermediateBuffer = nullptr;
+    {
+        uint64_t BufferSize;
+        Dx::GDevice->GetCopyableFootprints(&PaletteDesc, 0, 1, 0, nullptr, nullptr, nullptr, &BufferSize);
+
+        const auto BufferDesc = CD3DX12_RESOURCE_DESC::Buffer(BufferSize);
+        VHR(Dx::GDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE,
+                                                 &BufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+                                                 IID_PPV_ARGS(&IntermediateBuffer)));
+
+        Dx::GIntermediateResources.push_back(IntermediateBuffer);
+    }
+
+    uint32_t Palette[KPaletteSize];
+    MakePalette(Palette);
+    D3D12_SUBRESOURCE_DATA PaletteData = { Palette, (LONG_PTR)sizeof(Palette) };
+    UpdateSubresources<1>(Dx::GCmdList.Native, Priv::GPaletteTexture, IntermediateBuffer, 0, 0, 1, &PaletteData);
+
+    Cmd::ResourceBarrier(Dx::GCmdList, Priv::GPaletteTexture, D3D12_RESOURCE_STATE_COPY_DEST,
+                         D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    SrvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+    Dx::GDevice->CreateShaderResourceView(Priv::GPaletteTexture, &SrvDesc, PaletteDescriptor);
+#endif
+
+    Priv::GTextureIndex = Dx::AllocateBindlessDescriptor(Priv::GTextureDescriptors);
+    Priv::GPaletteTextureIndex = Dx::AllocateBindlessDescriptor(PaletteDescriptor);
+
+#if !defined(DEMO_HEADLESS)
+    const Load::TAsset& CsoVs = Priv::GCsoVs;
+    const Load::TAsset& CsoPs = Priv::GCsoPs;
+    assert(CsoVs.Data && CsoPs.Data);
+
+    // Full screen triangle generated from SV_VertexID, no vertex input.
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC PsoDesc = {};
+    PsoDesc.VS = { CsoVs.Data, CsoVs.Size };
+    PsoDesc.PS = { CsoPs.Data, CsoPs.Size };
+    PsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
+    PsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+    PsoDesc.BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+    PsoDesc.SampleMask = UINT_MAX;
+    PsoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    PsoDesc.NumRenderTargets = 1;
+    PsoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+    PsoDesc.SampleDesc.Count = 1;
+
+    VHR(Dx::GDevice->CreateGraphicsPipelineState(&PsoDesc, IID_PPV_ARGS(&Priv::GPipelineState)));
+    VHR(Dx::GDevice->CreateRootSignature(0, CsoVs.Data, CsoVs.Size, IID_PPV_ARGS(&Priv::GRootSignature)));
+
+    if (!Priv::GCsoVs.Mapped)
+        free(Priv::GCsoVs.Data);
+    if (!Priv::GCsoPs.Mapped)
+        free(Priv::GCsoPs.Data);
+    Priv::GCsoVs = {};
+    Priv::GCsoPs = {};
+#endif
+}
+
+static void
+Shutdown()
+{
+    Dx::FreeBindlessDescriptor(Priv::GPaletteTextureIndex);
+    Dx::FreeBindlessDescriptor(Priv::GTextureIndex);
+    Dx::FreeDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, Priv::GTextureDescriptors, 2);
+#if !defined(DEMO_HEADLESS)
+    SAFE_RELEASE(Priv::GPaletteTexture);
+    SAFE_RELEASE(Priv::GTexture);
+    SAFE_RELEASE(Priv::GPipelineState);
+    SAFE_RELEASE(Priv::GRootSignature);
+#endif
+}
+
+static void
+Render(TCanvas& Canvas)
+{
+    PROF_ZONE("Sand::Render");
+    assert(Canvas.Width == Priv::GTextureSize[0] && Canvas.Height == Priv::GTextureSize[1]);
+    Cmd::TCommandList& CmdList = Dx::GCmdList;
+    Priv::GUploadStats = {};
+
+    // One copy per run of dirty chunks in a row of chunks, which keeps each upload allocation small next
+    // to the ring. Texture rows in the upload buffer are 256-byte aligned, and the image 512-byte
+    // aligned, while the ring only aligns allocations to 256 bytes.
+    for (unsigned ChunkY = 0; ChunkY < Canvas.ChunkCountY; ++ChunkY)
+    {
+        TChunk* Chunks = &Canvas.Chunks[ChunkY * Canvas.ChunkCountX];
+        for (unsigned ChunkX = 0; ChunkX < Canvas.ChunkCountX; ++ChunkX)
+        {
+            if (Priv::IsEmpty(Chunks[ChunkX].Dirty))
+                continue;
+
+            TRect Rect = {};
+            for (; ChunkX < Canvas.ChunkCountX && !Priv::IsEmpty(Chunks[ChunkX].Dirty); ++ChunkX)
+            {
+                Rect = Priv::Union(Rect, Chunks[ChunkX].Dirty);
+                Chunks[ChunkX].Dirty = {};
+            }
+
+            if (Priv::GUploadStats.CopyCount == 0)
+            {
+                Cmd::ResourceBarrier(CmdList, Priv::GTexture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+                                     D3D12_RESOURCE_STATE_COPY_DEST);
+            }
+
+            const unsigned Width = (unsigned)(Rect.X1 - Rect.X0);
+            const unsigned Height = (unsigned)(Rect.Y1 - Rect.Y0);
+            const unsigned RowPitch = (Width + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) &
+                                      ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
+            D3D12_GPU_VIRTUAL_ADDRESS GpuAddress;
+            uint8_t* CpuAddress = (uint8_t*)Dx::AllocateGpuUploadMemory(
+                RowPitch * Height + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, GpuAddress);
+            const unsigned Padding = (unsigned)(0 - GpuAddress) & (D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+            // The cells go up as they are; the pass colours them.
+            for (unsigned Row = 0; Row < Height; ++Row)
+            {
+                Lib::StreamCopy(CpuAddress + Padding + (size_t)Row * RowPitch,
+                                GetRow(Canvas, (unsigned)Rect.Y0 + Row) + Rect.X0, Width);
+            }
+
+            D3D12_PLACED_SUBRESOURCE_FOOTPRINT Footprint = {};
+            ID3D12Resource* UploadBuffer = Dx::GetUploadBuffer(GpuAddress + Padding, Footprint.Offset);
+            Footprint.Footprint.Format = DXGI_FORMAT_R8_UINT;
+            Footprint.Footprint.Width = Width;
+            Footprint.Footprint.Height = Height;
+            Footprint.Footprint.Depth = 1;
+            Footprint.Footprint.RowPitch = RowPitch;
+            Cmd::CopyTextureRegion(CmdList, Priv::GTexture, (unsigned)Rect.X0, (unsigned)Rect.Y0, UploadBuffer,
+                                   Footprint);
+
+            Priv::GUploadStats.CopyCount++;
+            Priv::GUploadStats.ByteCount += Width * Height;
+        }
+    }
+    if (Priv::GUploadStats.CopyCount > 0)
+    {
+        Cmd::ResourceBarrier(CmdList, Priv::GTexture, D3D12_RESOURCE_STATE_COPY_DEST,
+                             D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    }
+
+    const D3D12_VIEWPORT Viewport = { 0.0f, 0.0f, (float)Dx::GResolution[0], (float)Dx::GResolution[1], 0.0f, 1.0f };
+    const D3D12_RECT ScissorRect = { 0, 0, (LONG)Dx::GResolution[0], (LONG)Dx::GResolution[1] };
+    Cmd::RSSetViewports(CmdList, Viewport);
+    Cmd::RSSetScissorRects(CmdList, ScissorRect);
+
+    Cmd::IASetPrimitiveTopology(CmdList, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    Cmd::SetPipelineState(CmdList, Priv::GPipelineState);
+    Cmd::SetGraphicsRootSignature(CmdList, Priv::GRootSignature);
+    Cmd::SetGraphicsRootDescriptorTable(CmdList, 0, Dx::GetBindlessTable());
+    Cmd::SetGraphicsRoot32BitConstant(CmdList, 1, Priv::GTextureIndex, 0);
+    Cmd::SetGraphicsRoot32BitConstant(CmdList, 1, Priv::GPaletteTextureIndex, 1);
+    Cmd::SetGraphicsRoot32BitConstant(CmdList, 1, (uint32_t)(Lib::GetTime() * KShimmerFrameRate), 2);
+    Cmd::DrawInstanced(CmdList, 3, 1, 0, 0);
+}
+
+static const TUploadStats&
+GetUploadStats()
+{
+    return Priv::GUploadStats;
+}
+
+} // namespace Sand
+// vim: set ts=4 sw=4 expandtab:
@@ -32,6 +32,12 @@ if not exist External.pch (cl %CFLAGS% /c /YcExternal.h External.cpp)
 cl %CFLAGS% /YuExternal.h %NAME%.cpp /link %LFLAGS% External.obj kernel32.lib user32.lib gdi32.lib
 if ERRORLEVEL 1 (set ERROR=1)
 if exist %NAME%.obj del %NAME%.obj
+
+cl %CFLAGS% /YuExternal.h PackTool.cpp /Fedemo_pack.exe /link %LFLAGS% External.obj kernel32.lib user32.lib gdi32.lib
+if ERRORLEVEL 1 (set ERROR=1 & goto :end)
+if exist PackTool.obj del PackTool.obj
+demo_pack.exe Data Data.pak
+if ERRORLEVEL 1 (set ERROR=1)
 if "%1" == "run" if exist %NAME%.exe %NAME%.exe
 
 :end